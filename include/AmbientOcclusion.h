@@ -0,0 +1,61 @@
+#ifndef AMBIENT_OCCLUSION_H
+#define AMBIENT_OCCLUSION_H
+
+#include <memory>
+#include "Backend.h"
+#include "RenderTargets.h"
+
+struct AmbientOcclusionPushConstants
+{
+	float radius;
+	float denoiseSharpness;
+	uint32_t sliceCount;
+	uint32_t stepCount;
+	uint32_t renderWidth;
+	uint32_t renderHeight;
+};
+
+// Half resolution GTAO from the depth and normal G-buffer, followed by a depth aware
+// denoise. The lighting pass upsamples the result bilaterally into the ambient term.
+class AmbientOcclusion
+{
+public:
+	std::shared_ptr<vpp::Backend> backend;
+
+	bool enabled = true;
+	float radius = 150.0f;
+	float denoiseSharpness = 0.05f;
+	int sliceCount = 2;
+	int stepCount = 4;
+
+	uint32_t width;
+	uint32_t height;
+
+	// r: visibility, g: linear view depth
+	std::shared_ptr<vpp::Image> rawImage;
+	std::shared_ptr<vpp::ImageView> rawImageView;
+	std::shared_ptr<vpp::Image> outputImage;
+	std::shared_ptr<vpp::ImageView> outputImageView;
+	std::shared_ptr<vpp::Sampler> sampler;
+
+	AmbientOcclusion(std::shared_ptr<vpp::Backend> backend, std::shared_ptr<vpp::SuperDescriptorSetLayout> perFrameDescriptorSetLayout, std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> normalImageView, uint32_t fullWidth, uint32_t fullHeight);
+	~AmbientOcclusion();
+
+	// Full resolution size, the AO images are half of it. The old targets are retired.
+	void resize(vpp::RenderTargets& renderTargets, std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> normalImageView, uint32_t fullWidth, uint32_t fullHeight);
+
+	// renderExtent is the part of the full resolution G-buffer written this frame
+	void record(VkCommandBuffer commandBuffer, VkDescriptorSet perFrameDescriptorSet, const std::vector<uint32_t>& perFrameOffsets, VkExtent2D renderExtent);
+
+private:
+	std::shared_ptr<vpp::SuperDescriptorSetLayout> descriptorSetLayout;
+	std::shared_ptr<vpp::SuperDescriptorSet> descriptorSet;
+
+	std::shared_ptr<vpp::ComputePipeline> gtaoPipeline;
+	std::shared_ptr<vpp::ComputePipeline> denoisePipeline;
+
+	void shaderBarrier(VkCommandBuffer commandBuffer);
+	void createTargets(std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> normalImageView, uint32_t fullWidth, uint32_t fullHeight);
+};
+
+#endif // !AMBIENT_OCCLUSION_H
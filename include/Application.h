@@ -11,6 +11,10 @@
 #include <stb_image.h>
 #include "Camera.h"
 #include "Backend.h"
+#include "FrameContext.h"
+#include "UniformAllocator.h"
+#include "RenderTargets.h"
+#include "FramePacer.h"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -26,12 +30,27 @@
 
 namespace vpp
 {
+    // Renders a fixed number of frames without GLFW or a surface, e.g. on CI hosts with lavapipe
+    struct HeadlessSettings
+    {
+        bool enabled = false;
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        uint64_t frameCount = 300;
+        double fixedDeltaTime = 1.0 / 60.0;     // s, keeps runs reproducible
+        uint32_t dumpInterval = 0;              // write every Nth frame as PNG, 0 disables
+        std::string dumpDirectory = "frames";
+    };
+
     class Application
     {
     public:
-        Application(std::string app_name, uint32_t apiVersion, std::vector<VkValidationFeatureEnableEXT> validation_features);
+        Application(std::string app_name, uint32_t apiVersion, std::vector<VkValidationFeatureEnableEXT> validation_features, HeadlessSettings headless = {});
         void run();
 
+        // Present mode and image count changes recreate the swapchain at the next present
+        void setFramePacing(FramePacingSettings settings);
+
         // Imgui
         ImGuiIO * io;
         ImGui_ImplVulkanH_Window g_MainWindowData;
@@ -41,9 +60,16 @@ namespace vpp
         uint32_t WIDTH = 1920;
         uint32_t HEIGHT = 1080;
         std::string APP_NAME;
-        const int MAX_FRAMES_IN_FLIGHT = 2;
+        // Per-frame resources are created for the maximum, the frame contexts decide how many are in use
+        static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+        static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+        static constexpr VkDeviceSize UNIFORM_ALLOCATOR_REGION_SIZE = 256 * 1024;
         uint32_t currentFrame = 0;
         bool framebufferResized = false;
+        int windowedRect[4] = {};     // x, y, width, height to restore when leaving fullscreen
+        bool quitRequested = false;
+        int exitCode = EXIT_SUCCESS;
+        HeadlessSettings headless;
 
         double currentFrameTime = 0.0;
         double lastFrameTime = 0.0;
@@ -67,11 +93,22 @@ namespace vpp
             "VK_LAYER_KHRONOS_validation"
         };
 
-        const std::vector<const char*> deviceExtensions = {
+        std::vector<const char*> deviceExtensions = {
             VK_KHR_SWAPCHAIN_EXTENSION_NAME
         };
 
         std::shared_ptr<vpp::Backend> backend;
+        std::shared_ptr<vpp::FrameContexts> frameContexts;
+        std::shared_ptr<vpp::UniformAllocator> uniformAllocator;
+        std::shared_ptr<vpp::RenderTargets> renderTargets;
+        std::shared_ptr<vpp::FramePacer> framePacer;
+
+        // What the surface offers and what the swapchain was created with
+        std::vector<VkPresentModeKHR> availablePresentModes;
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+        // Stages that wait on the acquired swapchain image, compute writes to it need to be included
+        VkPipelineStageFlags imageAvailableWaitStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
 
 #ifdef NDEBUG
@@ -84,12 +121,18 @@ namespace vpp
 
         virtual void main_loop_extended(uint32_t currentFrame, uint32_t imageIndex) = 0;
 
+        void newImGuiFrame();
+
+        void sampleInput();
+
         void cleanup();
 
         virtual void cleanup_extended() = 0;
 
         void init_window();
 
+        void toggleFullscreen();
+
         void create_instance(uint32_t apiVersion, std::vector<VkValidationFeatureEnableEXT> validation_features);
 
         bool checkValidationLayerSupport();
@@ -122,6 +165,10 @@ namespace vpp
 
         void createSwapChain();
 
+        void createOffscreenImages();
+
+        void dumpFrame(uint32_t imageIndex, const std::string& path);
+
         void createImageViews();
 
         std::vector<char> readFile(const std::string& filename);
@@ -136,8 +183,12 @@ namespace vpp
 
         void createSyncObjects();
 
+        void createRenderTargets();
+
         void recreateSwapChain();
 
+        virtual void recreateSwapChain_extended() = 0;
+
         void cleanupSwapChain();
 
         void createSwapChainFramebuffers();
@@ -0,0 +1,48 @@
+#ifndef ASYNC_COMPUTE_H
+#define ASYNC_COMPUTE_H
+
+#include <array>
+#include <memory>
+#include <vector>
+#include "Backend.h"
+#include "FrameContext.h"
+
+namespace vpp
+{
+	enum QueueType
+	{
+		GRAPHICS_QUEUE,
+		COMPUTE_QUEUE
+	};
+
+	// Splits a frame into batches on the graphics and async compute queues. Every batch signals the next
+	// value of its queue's timeline semaphore, batches on the other queue wait on the values they depend on.
+	class AsyncCompute
+	{
+	public:
+		static constexpr uint32_t MAX_BATCHES = 2;	// command buffers per queue and frame
+
+		std::shared_ptr<Backend> backend;
+		std::array<VkSemaphore, 2> timelineSemaphores{};
+
+		AsyncCompute(std::shared_ptr<Backend> backend, uint32_t maxFramesInFlight);
+		~AsyncCompute();
+
+		static bool isSupported(const std::shared_ptr<Backend>& backend) { return backend->computeQueue != VK_NULL_HANDLE; }
+
+		// Resets and begins a batch's command buffer, its frame context must have been waited on
+		VkCommandBuffer begin(QueueType queue, uint32_t frameIndex, uint32_t batch);
+
+		// Ends and submits the command buffer, returns the timeline value it signals
+		uint64_t submit(QueueType queue, VkCommandBuffer commandBuffer, const std::vector<SemaphoreWait>& waits);
+
+		SemaphoreWait waitFor(QueueType queue, uint64_t value, VkPipelineStageFlags stage) const { return { timelineSemaphores[queue], value, stage }; }
+		uint64_t getSubmittedValue(QueueType queue) const { return submittedValues[queue]; }
+
+	private:
+		std::array<std::vector<VkCommandBuffer>, 2> commandBuffers;	// frameIndex * MAX_BATCHES + batch
+		std::array<uint64_t, 2> submittedValues{};
+	};
+}
+
+#endif // !ASYNC_COMPUTE_H
@@ -18,6 +18,7 @@
 #include <iostream>
 #include <fstream>
 #include "util.h"
+#include "MemoryTracker.h"
 
 
 namespace vpp
@@ -34,10 +35,10 @@ namespace vpp
 	class Backend : public std::enable_shared_from_this<Backend>
 	{
 	public:
-		GLFWwindow* window;
+		GLFWwindow* window = nullptr;
 		VkInstance instance;
 		VkDebugUtilsMessengerEXT debugMessenger;
-		VkSurfaceKHR surface;
+		VkSurfaceKHR surface = VK_NULL_HANDLE;
 		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 		VkDevice device;
 
@@ -45,7 +46,7 @@ namespace vpp
 		VkDescriptorPool descriptorPool;
 
 		uint32_t imageCount;
-		VkSwapchainKHR swapChain;
+		VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 		std::vector<VkImage> swapChainImages;
 		VkFormat swapChainImageFormat;
 		std::vector<std::shared_ptr<ImageView>> swapChainImageViews;
@@ -53,26 +54,50 @@ namespace vpp
 		VkRenderPass swapChainRenderPass;
 		std::vector<VkFramebuffer> swapChainFramebuffers;
 
+		// Headless mode renders into these instead of swapchain images and leaves them ready to copy
+		bool headless = false;
+		std::vector<std::shared_ptr<Image>> offscreenImages;
+		VkImageLayout swapChainFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
 		std::vector<VkCommandBuffer> commandBuffers;
 		VkQueue graphicsQueue;
 		VkQueue presentQueue;
+		uint32_t graphicsQueueFamily = 0;
+
+		// Stays VK_NULL_HANDLE when the device has no second queue for async compute
+		VkQueue computeQueue = VK_NULL_HANDLE;
+		uint32_t computeQueueFamily = 0;
+		VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> computeCommandBuffers;
+
+		// Images and buffers are shared by these families, so the queues need no ownership transfers
+		std::vector<uint32_t> sharedQueueFamilies;
 
-		std::vector<VkSemaphore> imageAvailableSemaphores;
-		std::vector<VkSemaphore> renderFinishedSemaphores;
-		std::vector<VkFence> inFlightFences;
 
 		std::shared_ptr<Image> depthImage;
 		std::shared_ptr<ImageView> depthImageView;
 
+		bool shaderFloat16Supported = false;
+		bool swapChainStorageSupported = false;
+		bool textureCompressionBCSupported = false;
+
+		// Created with the device, sees every allocation made through allocateMemory
+		std::shared_ptr<MemoryTracker> memoryTracker;
+
 		VkCommandBuffer beginSingleTimeCommands();
 		void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		bool hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		VkResult allocateMemory(const VkMemoryAllocateInfo& allocInfo, VkDeviceMemory& memory, MemoryCategory category, const std::string& name);
+		void freeMemory(VkDeviceMemory memory);
 		TextureImageCreationResults createTextureImage(stbi_uc*, uint32_t size, uint32_t* mipLevels);
 		TextureImageCreationResults createTextureImage(std::string path, uint32_t* mipLevels);
 		void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 		void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 		void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 		VkShaderModule createShaderModule(const std::vector<char>& code);
+		void setSharingMode(VkSharingMode& sharingMode, uint32_t& queueFamilyIndexCount, const uint32_t*& queueFamilyIndices);
+		VkPipelineStageFlags supportedStages(VkCommandBuffer commandBuffer, VkPipelineStageFlags stages);
 
 		inline void setNameOfObject(VkObjectType type, uint64_t objectHandle, std::string name)
 		{
@@ -115,6 +140,7 @@ namespace vpp
 		VkDeviceMemory bufferMemory;
 		VkDeviceSize size;
 		void* mappedPtr;
+		VkMemoryPropertyFlags memoryProperties = 0;
 		std::shared_ptr<Backend> backend;
 
 		BufferType type;
@@ -139,6 +165,9 @@ namespace vpp
 		VkImageType imageType;
 
 		Image(std::shared_ptr<Backend> backend, uint32_t width, uint32_t height, uint32_t depth, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, std::string name);
+
+		// Without memory, the owner binds it, e.g. aliased with other images
+		Image(std::shared_ptr<Backend> backend, uint32_t width, uint32_t height, uint32_t depth, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, std::string name);
 		~Image();
 
 		void generateMipMaps();
@@ -152,7 +181,7 @@ namespace vpp
 		std::shared_ptr<Backend> backend;
 		VkImageView imageView;
 
-		ImageView(std::shared_ptr<Backend> backend, std::shared_ptr<Image> image, uint32_t baseMipLevel, uint32_t mipLevels, VkImageAspectFlagBits aspectFlags, std::string name);
+		ImageView(std::shared_ptr<Backend> backend, std::shared_ptr<Image> image, uint32_t baseMipLevel, uint32_t mipLevels, VkImageAspectFlagBits aspectFlags, std::string name, VkComponentMapping components = {});
 		ImageView(std::shared_ptr<Backend> backend, VkImage image, uint32_t baseMipLevel, uint32_t mipLevels, VkImageAspectFlagBits aspectFlags, VkFormat format, VkImageViewType viewType, std::string name);
 		~ImageView();
 	};
@@ -164,6 +193,7 @@ namespace vpp
 		VkSampler sampler;
 
 		Sampler(std::shared_ptr<Backend> backend, uint32_t mipLevels, std::string name);
+		Sampler(std::shared_ptr<Backend> backend, VkSamplerCreateInfo samplerInfo, std::string name);
 		~Sampler();
 	};
 
@@ -173,12 +203,14 @@ namespace vpp
 		std::shared_ptr<Backend> backend;
 		VkDescriptorSetLayout descriptorSetLayout;
 		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		std::vector<VkDescriptorBindingFlags> bindingFlags;
 		std::string name;
 
 		SuperDescriptorSetLayout(std::shared_ptr<Backend> backend, std::string name);
 		~SuperDescriptorSetLayout();
 
-		void addBinding(VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t descriptorCount);
+		// Update after bind flags make the layout need a pool created with VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT
+		void addBinding(VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t descriptorCount, VkDescriptorBindingFlags flags = 0);
 		void createLayout();
 
 		inline VkDescriptorSetLayout getTextureDescriptorSetLayout() { return descriptorSetLayout; }
@@ -200,7 +232,7 @@ namespace vpp
 		~SuperDescriptorSet();
 
 		void addImagesToBinding(std::vector<std::shared_ptr<ImageView>> imageViews, std::vector<std::shared_ptr<Sampler>> samplers, std::vector<VkImageLayout> imageLayouts);
-		void addBuffersToBinding(std::vector<std::shared_ptr<Buffer>> buffers);
+		void addBuffersToBinding(std::vector<std::shared_ptr<Buffer>> buffers, VkDeviceSize range = VK_WHOLE_SIZE);
 		void createDescriptorSet();
 
 	private:
@@ -241,6 +273,7 @@ namespace vpp
 		~GraphicsPipeline();
 
 		void addShaderStage(VkShaderStageFlagBits stage, std::string path);
+		void addShaderStage(VkShaderStageFlagBits stage, std::string path, const VkSpecializationInfo* specializationInfo);
 		void createPipeline();
 
 		VkPipelineDepthStencilStateCreateInfo depthStencil{};
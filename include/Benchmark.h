@@ -0,0 +1,99 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include "Camera.h"
+
+struct BenchmarkSettings
+{
+	bool enabled = false;
+	std::string cameraPath;			// recorded path, empty uses the built in spline
+	uint32_t warmupFrames = 60;
+	uint32_t frameCount = 0;		// 0 plays the whole path once
+	double fixedStep = 1.0 / 60.0;	// s of simulated time per frame
+	std::string reportPath = "benchmark.json";
+	std::string baselinePath;		// compare against this report when set
+	float regressionThreshold = 0.05f;
+};
+
+// Camera keyframes at a fixed interval, played back with a Catmull-Rom spline
+class CameraPath
+{
+public:
+	struct Keyframe
+	{
+		glm::vec3 position;
+		glm::vec3 front;
+	};
+
+	float keyframeInterval = 1.0f;	// s
+	std::vector<Keyframe> keyframes;
+
+	static CameraPath createDefault(const vpp::AABB& bounds);
+
+	void load(const std::string& path);
+	void save(const std::string& path) const;
+
+	float duration() const;
+	Keyframe evaluate(float time) const;
+};
+
+// Replays a camera path at fixed steps and reports CPU, GPU and per-pass frame time statistics
+class Benchmark
+{
+public:
+	BenchmarkSettings settings;
+	CameraPath path;
+
+	std::string deviceName;
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	Benchmark(BenchmarkSettings settings = {});
+
+	// Loads the camera path, the default one is fitted to the scene bounds
+	void start(const vpp::AABB& sceneBounds);
+
+	// Poses the camera for the current frame, call before the frame's matrices are built
+	void update(vpp::Camera& camera);
+
+	// GPU times lag behind by the frames in flight, the warmup frames absorb that
+	void recordFrame(float gpuFrameTime, const std::vector<std::pair<std::string, float>>& passTimes);
+
+	bool isFinished() const;
+
+	void writeReport() const;
+
+	// Prints every metric against the baseline report, returns the number of regressions
+	uint32_t compareWithBaseline() const;
+
+private:
+	uint32_t frameIndex = 0;
+	uint32_t totalFrames = 0;
+	std::chrono::steady_clock::time_point lastFrameStart;
+
+	std::vector<float> cpuFrameTimes;
+	std::vector<float> gpuFrameTimes;
+	std::map<std::string, std::vector<float>> passFrameTimes;
+};
+
+// Records the camera every keyframe interval while active, for replay by the benchmark
+class CameraPathRecorder
+{
+public:
+	bool recording = false;
+
+	void start();
+	void update(const vpp::Camera& camera, double deltaTime);
+	void stop(const std::string& path);
+
+private:
+	CameraPath path;
+	double timeSinceKeyframe = 0.0;
+};
+
+#endif // !BENCHMARK_H
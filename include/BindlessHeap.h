@@ -0,0 +1,92 @@
+#ifndef BINDLESS_HEAP_H
+#define BINDLESS_HEAP_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Backend.h"
+
+namespace vpp
+{
+	typedef uint32_t BindlessSlot;
+
+	// One descriptor set holding every sampled texture and storage buffer, indexed from shaders by slot.
+	// The bindings are partially bound and update-after-bind, so a slot can be written while frames that
+	// don't use it are in flight, and adding a texture is a descriptor write instead of a new layout and
+	// pipelines. The texture binding has a variable count, the layout only bounds it by the device limit
+	// and the set is allocated with the capacity asked for.
+	//
+	// A descriptor a pending frame may read must not change, so freed slots are handed out again only
+	// once the frame timeline has passed the last frame that used them.
+	class BindlessHeap
+	{
+	public:
+		static constexpr uint32_t BUFFER_BINDING = 0;
+		static constexpr uint32_t TEXTURE_BINDING = 1;
+		static constexpr BindlessSlot INVALID_SLOT = ~0u;
+
+		std::shared_ptr<Backend> backend;
+		std::shared_ptr<SuperDescriptorSetLayout> layout;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+		BindlessHeap(std::shared_ptr<Backend> backend, uint32_t textureCapacity, uint32_t bufferCapacity);
+		~BindlessHeap();
+
+		// Safe to call from loader threads, the heap keeps the resources alive until the slot is recycled
+		BindlessSlot addTexture(std::shared_ptr<ImageView> imageView, std::shared_ptr<Sampler> sampler, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		BindlessSlot addBuffer(std::shared_ptr<Buffer> buffer);
+
+		// lastUsedFrame is the last frame number whose commands may read the slot
+		void freeTexture(BindlessSlot slot, uint64_t lastUsedFrame);
+		void freeBuffer(BindlessSlot slot, uint64_t lastUsedFrame);
+
+		// Recycles the slots of every frame up to completedFrame, called once per frame
+		void collect(uint64_t completedFrame);
+
+		uint32_t getTextureCount() const { return textures.used; }
+		uint32_t getTextureCapacity() const { return textures.capacity; }
+		uint32_t getBufferCount() const { return buffers.used; }
+		uint32_t getBufferCapacity() const { return buffers.capacity; }
+
+	private:
+		struct RetiredSlot
+		{
+			BindlessSlot slot;
+			uint64_t frame;
+		};
+
+		enum SlotState : uint8_t
+		{
+			SLOT_FREE,
+			SLOT_ALLOCATED,
+			SLOT_RETIRED
+		};
+
+		struct SlotAllocator
+		{
+			uint32_t capacity = 0;
+			uint32_t used = 0;
+			uint32_t highWaterMark = 0;
+			std::vector<BindlessSlot> freeSlots;
+			std::vector<RetiredSlot> retiredSlots;
+			std::vector<SlotState> states;		// up to the high-water mark
+
+			BindlessSlot allocate();
+			void retire(BindlessSlot slot, uint64_t frame);
+
+			// Returns the slots that became free so their resources can be released
+			std::vector<BindlessSlot> collect(uint64_t completedFrame);
+		};
+
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		std::mutex mutex;
+
+		SlotAllocator textures;
+		SlotAllocator buffers;
+		std::vector<std::shared_ptr<ImageView>> textureViews;
+		std::vector<std::shared_ptr<Sampler>> textureSamplers;
+		std::vector<std::shared_ptr<Buffer>> bufferResources;
+	};
+}
+
+#endif // !BINDLESS_HEAP_H
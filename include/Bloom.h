@@ -0,0 +1,63 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <memory>
+#include <vector>
+#include "Backend.h"
+#include "RenderTargets.h"
+
+struct BloomPushConstants
+{
+	float threshold;
+	float knee;
+	float outputScale;
+	uint32_t firstPass;
+};
+
+// Compute downsample/upsample chain over a half resolution mip pyramid of the HDR image.
+// The result in mip 0 is sampled by the tone mapping pass. The pyramid is owned by the render graph,
+// the barriers between its own mips are recorded here.
+class Bloom
+{
+public:
+	static const uint32_t MAX_MIP_COUNT = 6;
+	static const uint32_t MIN_MIP_SIZE = 8;
+
+	std::shared_ptr<vpp::Backend> backend;
+
+	bool enabled = true;
+	float threshold = 0.0f;
+	float knee = 0.5f;
+
+	uint32_t mipCount;
+	std::shared_ptr<vpp::Image> image;
+	std::vector<std::shared_ptr<vpp::ImageView>> mipViews;
+	std::shared_ptr<vpp::ImageView> outputImageView;
+	std::shared_ptr<vpp::Sampler> sampler;
+
+	static VkExtent2D getBaseExtent(uint32_t width, uint32_t height);
+	static uint32_t getMipCount(VkExtent2D baseExtent);
+
+	Bloom(std::shared_ptr<vpp::Backend> backend, std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::Image> image);
+	~Bloom();
+
+	// The image is sized with getBaseExtent and getMipCount, the old targets are retired
+	void resize(vpp::RenderTargets& renderTargets, std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::Image> image);
+
+	void recordDownsample(VkCommandBuffer commandBuffer);
+	void recordUpsample(VkCommandBuffer commandBuffer);
+
+private:
+	std::shared_ptr<vpp::SuperDescriptorSetLayout> descriptorSetLayout;
+	std::vector<std::shared_ptr<vpp::SuperDescriptorSet>> downsampleDescriptorSets;
+	std::vector<std::shared_ptr<vpp::SuperDescriptorSet>> upsampleDescriptorSets;
+
+	std::shared_ptr<vpp::ComputePipeline> downsamplePipeline;
+	std::shared_ptr<vpp::ComputePipeline> upsamplePipeline;
+
+	void createTargets(std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::Image> image);
+	void createPipelines();
+	void shaderBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask);
+};
+
+#endif // !BLOOM_H
@@ -8,6 +8,7 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <array>
 #include "util.h"
 
 namespace vpp
@@ -24,6 +25,13 @@ namespace vpp
 		float moveSpeed = 1000.0;
 		float deltaTime;
 
+		float fov = 45.0f;
+		float nearPlane = 20.0f;
+		float farPlane = 100000.0f;
+
+		// Sub-pixel projection offset in pixels, for temporal anti-aliasing
+		glm::vec2 jitter = glm::vec2(0.0f);
+
 		bool movingForward = false;
 		bool movingBackward = false;
 		bool movingLeft = false;
@@ -35,7 +43,9 @@ namespace vpp
 		Camera(glm::vec3 position, glm::vec3 target);
 
 		ViewProjectionMatrices getMVPMatrices(float width, float height);
+		std::array<glm::vec3, 8> getFrustumCorners(float aspect, float sliceNear, float sliceFar) const;
 
+		void setFront(glm::vec3 front);
 		void move();
 		void mouse_callback(double xpos, double ypos);
 	};
@@ -0,0 +1,88 @@
+#ifndef CASCADED_SHADOW_MAP_H
+#define CASCADED_SHADOW_MAP_H
+
+#include <array>
+#include <memory>
+#include <vector>
+#include "Camera.h"
+#include "Backend.h"
+#include "util.h"
+
+struct ShadowPushConstants
+{
+	glm::mat4 lightModelViewProj;
+};
+
+// One indexed draw that can cast a shadow, with its world space bounds for per-cascade culling
+struct ShadowCaster
+{
+	glm::mat4 transform;
+	vpp::AABB bounds;
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+};
+
+// Sun shadows in a depth atlas with one tile per cascade. Near cascades are refit and
+// rendered every frame; far cascades are fit with some slack and only re-rendered when
+// the camera leaves that slack, the light moves or a caster moves.
+class CascadedShadowMap
+{
+public:
+	static const uint32_t CASCADE_RESOLUTION = 2048;
+
+	std::shared_ptr<vpp::Backend> backend;
+
+	bool enabled = true;
+	bool cacheFarCascades = true;
+	uint32_t firstCachedCascade = 2;
+	float shadowDistance = 8000.0f;
+	float splitLambda = 0.75f;
+	float cacheMargin = 1.5f;
+	float normalOffset = 1.5f;
+	int pcfRadius = 1;
+
+	uint32_t renderedCascadeCount = 0;
+	uint32_t drawnCasterCount = 0;
+
+	std::shared_ptr<vpp::Image> atlasImage;
+	std::shared_ptr<vpp::ImageView> atlasImageView;
+	std::shared_ptr<vpp::Sampler> comparisonSampler;
+
+	CascadedShadowMap(std::shared_ptr<vpp::Backend> backend);
+	~CascadedShadowMap();
+
+	void update(const vpp::Camera& camera, float aspect, glm::vec3 lightDirection, const std::vector<ShadowCaster>& casters);
+	void record(VkCommandBuffer commandBuffer, const std::vector<ShadowCaster>& casters);
+
+	// False when everything is cached, the pass can be skipped
+	bool hasDirtyCascades() const;
+	vpp::ShadowData getShadowData();
+	void invalidate();
+
+private:
+	struct Cascade
+	{
+		glm::mat4 viewProj = glm::mat4(1.0f);
+		glm::vec3 center = glm::vec3(0.0f);
+		float radius = 0.0f;
+		float splitFar = 0.0f;
+		bool valid = false;
+		bool dirty = true;
+	};
+
+	std::array<Cascade, vpp::SHADOW_CASCADE_COUNT> cascades;
+	glm::vec3 lastLightDirection = glm::vec3(0.0f);
+	std::vector<glm::mat4> lastCasterTransforms;
+
+	VkRenderPass renderPass;
+	VkFramebuffer framebuffer;
+	std::shared_ptr<vpp::GraphicsPipeline> pipeline;
+
+	void createRenderPass();
+	void createFramebuffer();
+	void createPipeline();
+	void fitCascade(Cascade& cascade, glm::vec3 center, float radius, glm::vec3 lightDirection, const vpp::AABB& sceneBounds);
+};
+
+#endif // !CASCADED_SHADOW_MAP_H
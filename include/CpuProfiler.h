@@ -0,0 +1,85 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+// Build with VPP_CPU_PROFILER defined to record scopes; otherwise every macro below expands to nothing.
+#ifdef VPP_CPU_PROFILER
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vpp
+{
+	struct CpuProfileEvent
+	{
+		const char* name;	// must outlive the profiler, string literals or __func__
+		uint64_t begin;		// ns
+		uint64_t end;		// ns
+	};
+
+	// Scoped CPU markers written to a ring per thread. Recording only touches the calling thread's ring,
+	// the registry mutex is taken once per thread and on export. Old events are overwritten when a ring wraps.
+	class CpuProfiler
+	{
+	public:
+		static const uint32_t EVENTS_PER_THREAD = 1 << 16;
+
+		static CpuProfiler& get();
+		static uint64_t now();
+
+		void record(const char* name, uint64_t begin, uint64_t end);
+		void setThreadName(const std::string& name);
+
+		// Chrome trace event JSON, open in chrome://tracing or Perfetto
+		void exportTrace(const std::string& path);
+
+	private:
+		struct ThreadBuffer
+		{
+			uint32_t threadId;
+			std::string name;
+			std::atomic<uint64_t> writeIndex = 0;
+			std::array<CpuProfileEvent, EVENTS_PER_THREAD> events;
+		};
+
+		CpuProfiler();
+		ThreadBuffer& threadBuffer();
+
+		uint64_t startTime;
+		std::mutex registryMutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+	};
+
+	class CpuProfileScope
+	{
+	public:
+		explicit CpuProfileScope(const char* name) : name(name), begin(CpuProfiler::now()) {}
+		~CpuProfileScope() { CpuProfiler::get().record(name, begin, CpuProfiler::now()); }
+
+	private:
+		const char* name;
+		uint64_t begin;
+	};
+}
+
+#define VPP_PROFILE_CONCAT_INNER(a, b) a##b
+#define VPP_PROFILE_CONCAT(a, b) VPP_PROFILE_CONCAT_INNER(a, b)
+#define VPP_PROFILE_SCOPE(name) vpp::CpuProfileScope VPP_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#define VPP_PROFILE_FUNCTION() VPP_PROFILE_SCOPE(__func__)
+#define VPP_PROFILE_THREAD(name) vpp::CpuProfiler::get().setThreadName(name)
+#define VPP_PROFILE_EXPORT(path) vpp::CpuProfiler::get().exportTrace(path)
+
+#else
+
+#define VPP_PROFILE_SCOPE(name) ((void)0)
+#define VPP_PROFILE_FUNCTION() ((void)0)
+#define VPP_PROFILE_THREAD(name) ((void)0)
+#define VPP_PROFILE_EXPORT(path) ((void)0)
+
+#endif // VPP_CPU_PROFILER
+
+#endif // !CPU_PROFILER_H
@@ -0,0 +1,28 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <cstdint>
+
+// Picks the render scale that holds a target GPU frame time. Render targets stay at the
+// output size and only the rendered sub-rectangle changes, so nothing is reallocated.
+class DynamicResolution
+{
+public:
+	static const uint32_t ADJUST_INTERVAL = 8;
+
+	bool enabled = false;
+	float targetFrameTime = 16.0f;	// ms
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+
+	float scale = 1.0f;
+	float smoothedFrameTime = 0.0f;
+
+	// Feeds one measured GPU frame time in ms and returns the scale for the next frame
+	float update(float gpuFrameTime);
+
+private:
+	uint32_t framesSinceChange = 0;
+};
+
+#endif // !DYNAMIC_RESOLUTION_H
@@ -0,0 +1,69 @@
+#ifndef FRAME_CONTEXT_H
+#define FRAME_CONTEXT_H
+
+#include <memory>
+#include <vector>
+#include "Backend.h"
+
+namespace vpp
+{
+	struct SemaphoreWait
+	{
+		VkSemaphore semaphore;
+		uint64_t value;				// ignored for binary semaphores
+		VkPipelineStageFlags stage;
+	};
+
+	struct FrameContext
+	{
+		uint32_t index;
+		VkCommandBuffer commandBuffer;
+		VkSemaphore imageAvailableSemaphore;
+		VkSemaphore renderFinishedSemaphore;
+		uint64_t frameNumber = 0;	// last frame submitted with this context, 0 if none
+	};
+
+	// Frames are numbered from 1 and every submit signals its number on one timeline semaphore,
+	// so any subsystem can ask whether the GPU has finished frame N without owning a fence.
+	class FrameContexts
+	{
+	public:
+		std::shared_ptr<Backend> backend;
+		VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+
+		FrameContexts(std::shared_ptr<Backend> backend, uint32_t maxFramesInFlight, uint32_t framesInFlight);
+		~FrameContexts();
+
+		// Waits until the context's previous frame has finished on the GPU, so everything it owns can be reused
+		FrameContext& beginFrame();
+
+		// Signals the frame's timeline value, and the render finished semaphore when the frame is presented
+		void submit(VkQueue queue, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage, bool signalRenderFinished);
+
+		// Extra waits for the next submit, e.g. on work another queue did for this frame
+		void addWait(SemaphoreWait wait) { pendingWaits.push_back(wait); }
+
+		uint64_t getCurrentFrameNumber() const { return frameNumber; }
+		uint64_t getSubmittedFrameNumber() const { return submittedFrameNumber; }
+		uint64_t getCompletedFrameNumber() const;
+		bool isFrameComplete(uint64_t frame) const;
+		void waitForFrame(uint64_t frame) const;
+
+		uint32_t getFramesInFlight() const { return framesInFlight; }
+		uint32_t getMaxFramesInFlight() const { return static_cast<uint32_t>(contexts.size()); }
+
+		// Applied by the next beginFrame once the submitted frames have drained
+		void setFramesInFlight(uint32_t count);
+
+	private:
+		std::vector<FrameContext> contexts;
+		std::vector<SemaphoreWait> pendingWaits;
+		uint32_t framesInFlight;
+		uint32_t requestedFramesInFlight;
+		uint32_t currentIndex = 0;
+		uint64_t frameNumber = 0;
+		uint64_t submittedFrameNumber = 0;
+	};
+}
+
+#endif // !FRAME_CONTEXT_H
@@ -0,0 +1,74 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include "Backend.h"
+#include "FrameContext.h"
+
+namespace vpp
+{
+	const char* presentModeName(VkPresentModeKHR mode);
+
+	struct FramePacingSettings
+	{
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;	// FIFO when the surface doesn't support it
+		uint32_t swapChainImageCount = 0;							// 0 is one more than the surface minimum
+		bool lowLatency = false;									// sample input only once the previous frame is done
+	};
+
+	// Decides when the main loop samples input and measures how long that input takes to reach the screen.
+	// In low latency mode the loop waits for the GPU to finish frame N-1 before it polls input for frame N,
+	// so the CPU never queues a frame behind another and the input it records is as fresh as it can be.
+	//
+	// The latency is an estimate: the CPU sees a frame complete on the timeline no earlier than the GPU
+	// finished it, and the wait for the presentation engine is taken as the configured present delay.
+	class FramePacer
+	{
+	public:
+		FramePacingSettings settings;
+
+		FramePacer(std::shared_ptr<FrameContexts> frameContexts);
+
+		// Called before input is sampled, waits for the last submitted frame in low latency mode
+		void waitForPreviousFrame();
+
+		// Timestamps the input the current frame is built from
+		void sampleInput();
+
+		void frameSubmitted(uint64_t frame);
+
+		// Resolves the latency of every submitted frame the GPU has finished
+		void update();
+
+		// ms between the GPU finishing a frame and the presentation engine showing it
+		void setPresentDelay(double delay) { presentDelay = delay; }
+
+		double getLatency() const { return latency; }					// ms, input to present
+		double getSmoothedLatency() const { return smoothedLatency; }
+		double getInputToSubmit() const { return inputToSubmit; }		// ms on the CPU
+		double getInputToGpu() const { return inputToGpu; }				// ms, input to the GPU finishing the frame
+		double getPresentDelay() const { return presentDelay; }
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct PendingFrame
+		{
+			uint64_t frame;
+			Clock::time_point inputTime;
+		};
+
+		std::shared_ptr<FrameContexts> frameContexts;
+		std::deque<PendingFrame> pendingFrames;
+		Clock::time_point inputTime;
+		double presentDelay = 0.0;
+		double latency = 0.0;
+		double smoothedLatency = 0.0;
+		double inputToSubmit = 0.0;
+		double inputToGpu = 0.0;
+	};
+}
+
+#endif // !FRAME_PACER_H
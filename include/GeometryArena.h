@@ -0,0 +1,120 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Backend.h"
+#include "util.h"
+
+namespace vpp
+{
+	typedef uint32_t GeometryHandle;
+
+	// Where a piece of geometry currently lives, in vertices and indices of the arena's buffers
+	struct GeometryRange
+	{
+		uint32_t firstVertex = 0;
+		uint32_t vertexCount = 0;
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+	};
+
+	// One vertex and one index buffer for all geometry, with a range allocator for each. Models are
+	// added and removed at runtime without touching anything else in the buffers, and a removed range is
+	// reused only once the frame timeline has passed the last frame that drew from it.
+	//
+	// Compaction runs a little every frame: the highest allocations are copied on the GPU into the lowest
+	// hole below them that fits. Indices are relative to a mesh's first vertex, so a move only changes the
+	// handle's range. Meshes and scenes keep offsets relative to it and never need fixing up.
+	class GeometryArena
+	{
+	public:
+		static constexpr GeometryHandle INVALID_GEOMETRY = ~0u;
+
+		std::shared_ptr<Backend> backend;
+		std::shared_ptr<Buffer> vertexBuffer;
+		std::shared_ptr<Buffer> indexBuffer;
+
+		bool compaction = true;
+		VkDeviceSize compactionBudget = 4 * 1024 * 1024;	// bytes moved per frame
+
+		GeometryArena(std::shared_ptr<Backend> backend, uint32_t vertexCapacity, uint32_t indexCapacity);
+
+		// Safe to call from loader threads, the data goes to staging memory and the next record uploads it
+		GeometryHandle add(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+		// lastUsedFrame is the last frame number whose commands may read the geometry
+		void remove(GeometryHandle handle, uint64_t lastUsedFrame);
+
+		// A range resolved while recording stays readable until the frame finishes, even if it moves
+		GeometryRange getRange(GeometryHandle handle) const;
+
+		// Records the pending uploads and this frame's compaction moves, before anything draws
+		void record(VkCommandBuffer commandBuffer, uint64_t frame);
+
+		// Frees the ranges of removed and moved geometry up to completedFrame, called once per frame
+		void collect(uint64_t completedFrame);
+
+		uint32_t getVertexCount() const { return vertices.used; }
+		uint32_t getVertexCapacity() const { return vertices.capacity; }
+		uint32_t getIndexCount() const { return indices.used; }
+		uint32_t getIndexCapacity() const { return indices.capacity; }
+		size_t getFreeBlockCount() const { return vertices.freeRanges.size() + indices.freeRanges.size(); }
+		VkDeviceSize getMovedBytes() const { return movedBytes; }
+
+	private:
+		struct RetiredRange
+		{
+			uint32_t offset;
+			uint32_t count;
+			uint64_t frame;
+		};
+
+		struct RangeAllocator
+		{
+			uint32_t capacity = 0;
+			uint32_t used = 0;
+			std::map<uint32_t, uint32_t> freeRanges;	// offset to count, adjacent ranges are merged
+			std::vector<RetiredRange> retiredRanges;
+
+			// First fit that ends at or below limit, so allocations settle towards the start
+			bool allocate(uint32_t count, uint32_t limit, uint32_t& offset);
+			void free(uint32_t offset, uint32_t count);
+			void retire(uint32_t offset, uint32_t count, uint64_t frame);
+			void collect(uint64_t completedFrame);
+		};
+
+		struct Upload
+		{
+			GeometryHandle handle;
+			std::shared_ptr<Buffer> stagingBuffer;
+		};
+
+		struct RetiredStagingBuffer
+		{
+			std::shared_ptr<Buffer> stagingBuffer;
+			uint64_t frame;
+		};
+
+		void compact(VkCommandBuffer commandBuffer, uint64_t frame);
+
+		mutable std::mutex mutex;
+
+		RangeAllocator vertices;
+		RangeAllocator indices;
+		// Indexed by handle, a deque so adding from a loader thread never moves existing entries
+		std::deque<GeometryRange> ranges;
+		std::deque<bool> live;			// handed out and not removed yet
+		std::deque<bool> resident;		// uploaded, so compaction may move it
+		std::vector<GeometryHandle> freeHandles;
+
+		std::vector<Upload> pendingUploads;
+		std::vector<RetiredStagingBuffer> retiredStagingBuffers;
+		VkDeviceSize movedBytes = 0;
+	};
+}
+
+#endif // !GEOMETRY_ARENA_H
@@ -0,0 +1,107 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include "Backend.h"
+
+namespace vpp
+{
+	struct GpuProfileFrame
+	{
+		uint64_t frameNumber;
+		float cpuTime;		// ms, whole frame on the CPU
+		std::vector<std::pair<std::string, float>> scopes;	// ms, in recording order
+	};
+
+	// Named timestamp scopes per frame in flight, in one query pool split into a slot per frame.
+	// Results are read once the slot's previous frame has finished on the GPU, so reading never stalls.
+	// Each scope is also a debug utils label, so captures in RenderDoc and friends show the same names.
+	class GpuProfiler
+	{
+	public:
+		static const uint32_t MAX_SCOPES = 64;
+		static const uint32_t HISTORY_LENGTH = 240;
+		static const uint32_t MAX_RECORDED_FRAMES = 1024;
+
+		std::shared_ptr<Backend> backend;
+		bool supported = true;
+
+		GpuProfiler(std::shared_ptr<Backend> backend, uint32_t framesInFlight);
+		~GpuProfiler();
+
+		// Call once the slot's previous frame has finished, before the slot is recorded again
+		void readResults(uint32_t frameIndex);
+
+		// Resets the slot's queries and opens the "Frame" scope
+		void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, float cpuFrameTime);
+		void endFrame(VkCommandBuffer commandBuffer);
+
+		uint32_t beginScope(VkCommandBuffer commandBuffer, const std::string& name, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		void endScope(VkCommandBuffer commandBuffer, uint32_t scope, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+		// Latest time in ms, 0 if the scope didn't run in that frame
+		float getTime(const std::string& name) const;
+
+		// Latest time of every scope seen so far, in first seen order
+		std::vector<std::pair<std::string, float>> getLatestTimes() const;
+
+		void drawImGui();
+		void exportTrace(const std::string& path) const;
+
+	private:
+		struct Scope
+		{
+			std::string name;
+			uint32_t depth;
+			uint32_t beginQuery;
+			uint32_t endQuery;
+		};
+
+		struct ScopeHistory
+		{
+			uint32_t depth = 0;
+			float latest = 0.0f;
+			std::vector<float> values = std::vector<float>(HISTORY_LENGTH, 0.0f);
+		};
+
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		float timestampPeriod = 1.0f;
+		uint32_t framesInFlight;
+
+		PFN_vkCmdBeginDebugUtilsLabelEXT beginLabel = nullptr;
+		PFN_vkCmdEndDebugUtilsLabelEXT endLabel = nullptr;
+
+		uint32_t currentSlot = 0;
+		uint32_t currentDepth = 0;
+		uint32_t frameScope = 0;
+		uint64_t frameNumber = 0;
+		std::vector<std::vector<Scope>> slotScopes;
+		std::vector<uint32_t> slotQueryCounts;
+		std::vector<float> slotCpuTimes;
+		std::vector<uint64_t> slotFrameNumbers;
+
+		std::vector<std::string> scopeOrder;
+		std::unordered_map<std::string, ScopeHistory> histories;
+		uint32_t historyOffset = 0;
+		std::deque<GpuProfileFrame> recordedFrames;
+	};
+
+	// Closes the scope when it goes out of scope
+	class GpuProfileScope
+	{
+	public:
+		GpuProfileScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const std::string& name);
+		~GpuProfileScope();
+
+	private:
+		GpuProfiler& profiler;
+		VkCommandBuffer commandBuffer;
+		uint32_t scope;
+	};
+}
+
+#endif // !GPU_PROFILER_H
@@ -0,0 +1,101 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <vulkan/vulkan.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "util.h"
+
+namespace vpp
+{
+	enum MemoryCategory
+	{
+		MEMORY_GEOMETRY,
+		MEMORY_TEXTURES,
+		MEMORY_RENDER_TARGETS,
+		MEMORY_STAGING,
+		MEMORY_UNIFORMS,
+		MEMORY_OTHER,
+		MEMORY_CATEGORY_COUNT
+	};
+
+	const char* memoryCategoryName(MemoryCategory category);
+
+	// Guessed from how the resource is used, vertex and index data is geometry, anything drawn into is a render target
+	MemoryCategory bufferMemoryCategory(VkBufferUsageFlags usage, BufferType type);
+	MemoryCategory imageMemoryCategory(VkImageUsageFlags usage);
+
+	struct MemoryUsage
+	{
+		VkDeviceSize size = 0;
+		VkDeviceSize peakSize = 0;
+		uint32_t allocationCount = 0;
+	};
+
+	// The driver's view of a heap, budget and usage include other processes and come from VK_EXT_memory_budget
+	struct MemoryHeapInfo
+	{
+		VkDeviceSize size = 0;
+		VkDeviceSize budget = 0;			// heap size without the extension
+		VkDeviceSize usage = 0;				// tracked allocations only without the extension
+		VkDeviceSize peakUsage = 0;
+		VkDeviceSize trackedSize = 0;		// allocations of this process that went through the tracker
+		bool deviceLocal = false;
+	};
+
+	// Every vkAllocateMemory of the renderer goes through Backend::allocateMemory and is recorded here by
+	// category and by debug name, with the high-water mark of each. Names are aggregated, so a thousand
+	// "Texture image" allocations are one row. Thread safe like the bindless heap.
+	class MemoryTracker
+	{
+	public:
+		MemoryTracker(VkPhysicalDevice physicalDevice, bool budgetSupported);
+
+		void allocated(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, MemoryCategory category, const std::string& name);
+		void freed(VkDeviceMemory memory);
+
+		MemoryUsage getUsage(MemoryCategory category) const;
+		MemoryUsage getTotalUsage() const;
+
+		// Queries the driver and updates the heap high-water marks, called once per frame so no peak is missed
+		std::vector<MemoryHeapInfo> queryHeaps();
+
+		// Result of the last queryHeaps
+		std::vector<MemoryHeapInfo> getHeaps() const;
+
+		bool isBudgetSupported() const { return budgetSupported; }
+
+		void drawImGui();
+		void exportJson(const std::string& path);
+
+	private:
+		struct Allocation
+		{
+			VkDeviceSize size;
+			uint32_t heapIndex;
+			MemoryCategory category;
+			std::string name;
+		};
+
+		VkPhysicalDevice physicalDevice;
+		bool budgetSupported;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+
+		mutable std::mutex mutex;
+		std::unordered_map<VkDeviceMemory, Allocation> allocations;
+		MemoryUsage categories[MEMORY_CATEGORY_COUNT];
+		MemoryUsage total;
+		std::map<std::string, MemoryUsage> names;
+		std::vector<VkDeviceSize> heapTrackedSizes;
+		std::vector<VkDeviceSize> heapPeakUsages;
+		std::vector<MemoryHeapInfo> heaps;
+
+		static void add(MemoryUsage& usage, VkDeviceSize size);
+		static void remove(MemoryUsage& usage, VkDeviceSize size);
+	};
+}
+
+#endif // !MEMORY_TRACKER_H
@@ -2,6 +2,9 @@
 #define MODEL_H
 
 #include "Backend.h"
+#include "BindlessHeap.h"
+#include "GeometryArena.h"
+#include "TexturePacking.h"
 
 #include <iostream>
 #include <assimp/Importer.hpp>      // C++ importer interface
@@ -17,6 +20,13 @@
 
 namespace vpp
 {
+	// Bindless heap slots of a material's textures, orm reads occlusion, roughness and metallic from .rgb
+	struct MaterialSlots
+	{
+		BindlessSlot albedo;
+		BindlessSlot orm;
+	};
+
 	class Model
 	{
 	public:
@@ -30,41 +40,62 @@ namespace vpp
 		std::vector<Node> nodes;
 		TextureType textureType;
 		bool hasTree;
+		GeometryHandle geometry = GeometryArena::INVALID_GEOMETRY;
 
-		glm::vec3 position;
-		glm::vec3 scale;
-		std::pair<float, glm::vec3> rotationAngleAxis;
+		static constexpr uint32_t MAX_BINDLESS_TEXTURES = 4096;
+		static constexpr uint32_t MAX_BINDLESS_BUFFERS = 1024;
+		static constexpr uint32_t GEOMETRY_ARENA_VERTICES = 4 * 1024 * 1024;
+		static constexpr uint32_t GEOMETRY_ARENA_INDICES = 16 * 1024 * 1024;
 
+		// Geometry and materials only, a Scene places instances of it. Textured models can also be
+		// loaded after finishLoadingModels, flat color ones can't since their colors are one buffer.
 		Model(std::string path, std::shared_ptr<vpp::Backend> backend, TextureType textureType);
 
-		glm::mat4 getModelMatrix();
+		// Returns the geometry to the arena once the GPU is past lastUsedFrame, destroy the entities drawing it first.
+		// The textures stay in the bindless heap.
+		void unload(uint64_t lastUsedFrame);
 
-		inline static std::shared_ptr<SuperDescriptorSetLayout> getTextureDescriptorSetLayout()
+		inline static std::shared_ptr<SuperDescriptorSetLayout> getColorDescriptorSetLayout()
 		{
 			if (!finished)
 			{
 				throw std::runtime_error("Models not loaded");
 			}
 
-			return textureDescriptorSetLayout;
+			return colorDescriptorSetLayout;
 		}
 
-		inline static std::shared_ptr<SuperDescriptorSetLayout> getColorDescriptorSetLayout()
+		// Set 1 of every pipeline that draws models
+		inline static std::shared_ptr<BindlessHeap> getBindlessHeap()
 		{
-			if (!finished)
-			{
+			if (!initialized)
 				throw std::runtime_error("Models not loaded");
-			}
 
-			return colorDescriptorSetLayout;
+			return bindlessHeap;
 		}
 
-		inline static std::shared_ptr<SuperDescriptorSet> getTextureDescriptorSet()
+		// Flat color models index past the textured materials and get the default texture
+		inline static const MaterialSlots& getMaterialSlots(uint32_t materialIndex)
 		{
-			if (!initialized)
-				throw std::runtime_error("Models not loaded");
+			if (!finished)
+				throw std::runtime_error("Models not finished loading");
 
-			return textureDescriptorSet;
+			return materialIndex < materialSlots.size() ? materialSlots[materialIndex] : defaultMaterialSlots;
+		}
+
+		// Streams a new texture into a material, the old slot is recycled once the GPU is past lastUsedFrame
+		inline static void setMaterialTexture(uint32_t materialIndex, BindlessSlot MaterialSlots::* texture, std::shared_ptr<ImageView> imageView, uint64_t lastUsedFrame)
+		{
+			if (materialIndex >= materialSlots.size())
+				throw std::runtime_error("Material has no textures");
+
+			BindlessSlot oldSlot = materialSlots[materialIndex].*texture;
+			materialSlots[materialIndex].*texture = bindlessHeap->addTexture(imageView, textureSampler);
+
+			if (oldSlot != defaultMaterialSlots.albedo && oldSlot != defaultMaterialSlots.orm)
+			{
+				bindlessHeap->freeTexture(oldSlot, lastUsedFrame);
+			}
 		}
 
 		inline static std::shared_ptr<SuperDescriptorSet> getColorDescriptorSet()
@@ -77,48 +108,25 @@ namespace vpp
 
 		inline static void finishLoadingModels(std::shared_ptr<Backend> backend)
 		{
-			if(vertices.size() == 0) throw std::runtime_error("No models loaded");
-
 			if(!initialized) throw std::runtime_error("Models not loaded");
 
 			if(finished) throw std::runtime_error("Models already Loaded");
 
-			vertexBuffer = std::make_shared<Buffer>(backend, vertices.size() * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vpp::ONE_TIME_TRANSFER, vertices.data(), "Vertex Buffer");
-			indexBuffer = std::make_shared<Buffer>(backend, indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, vpp::ONE_TIME_TRANSFER, indices.data(), "Index Buffer");
-
 			// Sampler
 			textureSampler = std::make_shared<Sampler>(backend, 10, "Texture Sampler");
 
-			// create layouts and descriptor sets
-			textureDescriptorSetLayout = std::make_shared<SuperDescriptorSetLayout>(backend, "Texture descriptor set layout");
-			textureDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, (albedoImages.size() == 0) ? 1 : albedoImages.size());
-			textureDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, (metallicImages.size() == 0) ? 1 : metallicImages.size());
-			textureDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, (roughnessImages.size() == 0) ? 1 : roughnessImages.size());
-			textureDescriptorSetLayout->createLayout();
+			// Textures go into the bindless heap, a material is the slots of its albedo and packed ORM texture
+			defaultMaterialSlots.albedo = bindlessHeap->addTexture(defaultImageView, textureSampler);
+			defaultMaterialSlots.orm = bindlessHeap->addTexture(defaultOrmImageView, textureSampler);
+			createMaterialSlots(0);
 
+			// create layouts and descriptor sets
 			colorDescriptorSetLayout = std::make_shared<SuperDescriptorSetLayout>(backend, "Color descriptor set layout");
 			colorDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1);
 			colorDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1);
 			colorDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1);
 			colorDescriptorSetLayout->createLayout();
 
-			if (albedoImages.size() > 0)
-			{
-				textureDescriptorSet = std::make_shared<SuperDescriptorSet>(backend, textureDescriptorSetLayout, "Texture descriptor set");
-				textureDescriptorSet->addImagesToBinding(albedoImageViews, std::vector<std::shared_ptr<Sampler>>(albedoImages.size(), textureSampler), std::vector<VkImageLayout>(albedoImages.size(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
-				textureDescriptorSet->addImagesToBinding(metallicImageViews, std::vector<std::shared_ptr<Sampler>>(metallicImages.size(), textureSampler), std::vector<VkImageLayout>(metallicImages.size(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
-				textureDescriptorSet->addImagesToBinding(roughnessImageViews, std::vector<std::shared_ptr<Sampler>>(roughnessImages.size(), textureSampler), std::vector<VkImageLayout>(roughnessImages.size(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
-				textureDescriptorSet->createDescriptorSet();
-			}
-			else
-			{
-				textureDescriptorSet = std::make_shared<SuperDescriptorSet>(backend, textureDescriptorSetLayout, "Texture descriptor set");
-				textureDescriptorSet->addImagesToBinding({ defaultImageView }, { textureSampler }, { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
-				textureDescriptorSet->addImagesToBinding({ defaultImageView }, { textureSampler }, { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
-				textureDescriptorSet->addImagesToBinding({ defaultImageView }, {textureSampler}, {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
-				textureDescriptorSet->createDescriptorSet();
-			}
-
 			if(flatAlbedos.size() > 0)
 			{
 				flatAlbedoBuffer = std::make_shared<Buffer>(backend, flatAlbedos.size() * sizeof(glm::vec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vpp::ONE_TIME_TRANSFER, flatAlbedos.data(), "Flat Albedo Buffer");
@@ -143,6 +151,15 @@ namespace vpp
 			finished = true;
 		}
 
+		inline static std::shared_ptr<GeometryArena> getGeometryArena()
+		{
+			if (!initialized)
+				throw std::runtime_error("Models not loaded");
+
+			return geometryArena;
+		}
+
+		// Draws take their offsets from the geometry arena's range of the model
 		inline static std::shared_ptr<Buffer> getVertexBuffer()
 		{
 			if (!initialized)
@@ -151,7 +168,7 @@ namespace vpp
 			if (!finished)
 				throw std::runtime_error("Models not finished loading");
 
-			return vertexBuffer;
+			return geometryArena->vertexBuffer;
 		}
 
 		inline static std::shared_ptr<Buffer> getIndexBuffer()
@@ -162,30 +179,34 @@ namespace vpp
 			if (!finished)
 				throw std::runtime_error("Models not finished loading");
 
-			return indexBuffer;
+			return geometryArena->indexBuffer;
 		}
 
+		// Bytes of every packed ORM texture loaded so far, and what metallic and roughness took as separate RGBA8 textures
+		inline static VkDeviceSize getOrmTextureSize() { return ormTextureSize; }
+		inline static VkDeviceSize getUnpackedOrmTextureSize() { return unpackedOrmTextureSize; }
+
 		inline static void destroyModels(std::shared_ptr<Backend> backend)
 		{
-			textureDescriptorSet.reset();
-			textureDescriptorSetLayout.reset();
+			bindlessHeap.reset();
+			materialSlots.clear();
 			colorDescriptorSet.reset();
 			colorDescriptorSetLayout.reset();
 
 			albedoImages.clear();
 			albedoImageViews.clear();
-			metallicImages.clear();
-			metallicImageViews.clear();
-			roughnessImages.clear();
-			roughnessImageViews.clear();
+			ormImages.clear();
+			ormImageViews.clear();
+			ormTextureSize = 0;
+			unpackedOrmTextureSize = 0;
 			textureSampler.reset();
-			vertexBuffer.reset();
-			indexBuffer.reset();
+			geometryArena.reset();
 			flatAlbedoBuffer.reset();
 			flatMetallicBuffer.reset();
 			flatRoughnessBuffer.reset();
 			defaultImage.reset();
 			defaultImageView.reset();
+			defaultOrmImageView.reset();
 			defaultBuffer.reset();
 
 			initialized = false;
@@ -193,27 +214,25 @@ namespace vpp
 		}
 
 		inline static std::vector<std::shared_ptr<Image>> albedoImages;
-		inline static std::vector<std::shared_ptr<Image>> metallicImages;
-		inline static std::vector<std::shared_ptr<Image>> roughnessImages;
+		inline static std::vector<std::shared_ptr<Image>> ormImages;
 		inline static std::vector<glm::vec4> flatAlbedos;
 		inline static std::vector<float> flatMetallics;
 		inline static std::vector<float> flatRoughnesses;
 
 	private:
-		inline static std::shared_ptr<SuperDescriptorSetLayout> textureDescriptorSetLayout;
 		inline static std::shared_ptr<SuperDescriptorSetLayout> colorDescriptorSetLayout;
 		inline static bool superDescriptorSetLayoutCreated = false;
 
 		inline static uint32_t globalMaterialCount = 0;
 
-		inline static std::vector<Vertex> vertices;
-		inline static std::vector<uint32_t> indices;
-
 		inline static std::vector<std::shared_ptr<ImageView>> albedoImageViews;
-		inline static std::vector<std::shared_ptr<ImageView>> metallicImageViews;
-		inline static std::vector<std::shared_ptr<ImageView>> roughnessImageViews;
+		inline static std::vector<std::shared_ptr<ImageView>> ormImageViews;
+		inline static VkDeviceSize ormTextureSize = 0;
+		inline static VkDeviceSize unpackedOrmTextureSize = 0;
 
-		inline static std::shared_ptr<SuperDescriptorSet> textureDescriptorSet;
+		inline static std::shared_ptr<BindlessHeap> bindlessHeap;
+		inline static std::vector<MaterialSlots> materialSlots;
+		inline static MaterialSlots defaultMaterialSlots;
 		inline static std::vector<uint32_t> mipLevels;
 		inline static std::shared_ptr<vpp::Sampler> textureSampler;
 
@@ -222,18 +241,33 @@ namespace vpp
 		inline static std::shared_ptr<Buffer> flatRoughnessBuffer;
 		inline static std::shared_ptr<SuperDescriptorSet> colorDescriptorSet;
 
-		inline static std::shared_ptr<Buffer> vertexBuffer;
-		inline static std::shared_ptr<Buffer> indexBuffer;
+		inline static std::shared_ptr<GeometryArena> geometryArena;
 
 		inline static bool initialized = false;
 		inline static bool finished = false;
 
 		inline static std::shared_ptr<Image> defaultImage;
 		inline static std::shared_ptr<ImageView> defaultImageView;
+		inline static std::shared_ptr<ImageView> defaultOrmImageView;
 		inline static std::shared_ptr<Buffer> defaultBuffer;
 
 		void processNode(aiNode* node, const aiScene* scene, glm::mat4 parentTransform);
 
+		// Materials without a texture share the default image's slot
+		inline static void createMaterialSlots(size_t firstMaterial)
+		{
+			auto addTexture = [](const std::vector<std::shared_ptr<ImageView>>& views, size_t index, BindlessSlot defaultSlot) {
+				return (index < views.size() && views[index] != defaultImageView && views[index] != defaultOrmImageView) ? bindlessHeap->addTexture(views[index], textureSampler) : defaultSlot;
+			};
+
+			materialSlots.resize(albedoImageViews.size(), defaultMaterialSlots);
+			for (size_t i = firstMaterial; i < albedoImageViews.size(); i++)
+			{
+				materialSlots[i].albedo = addTexture(albedoImageViews, i, defaultMaterialSlots.albedo);
+				materialSlots[i].orm = addTexture(ormImageViews, i, defaultMaterialSlots.orm);
+			}
+		}
+
 	};
 }
 
@@ -0,0 +1,145 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Backend.h"
+#include "AsyncCompute.h"
+
+namespace vpp
+{
+	typedef uint32_t RenderGraphResource;
+	typedef uint32_t RenderGraphPass;
+
+	struct RenderGraphBatch
+	{
+		VkCommandBuffer commandBuffer;
+		QueueType queue;
+	};
+
+	struct RenderGraphStats
+	{
+		uint32_t passCount = 0;
+		uint32_t culledPassCount = 0;
+		uint32_t barrierCount = 0;			// image and buffer barriers in the last frame
+		uint32_t barrierBatchCount = 0;		// vkCmdPipelineBarrier2 calls in the last frame
+		VkDeviceSize transientMemory = 0;
+		VkDeviceSize unaliasedTransientMemory = 0;
+	};
+
+	// Passes are declared every frame in the same order, with the images and buffers they read and write.
+	// Executing the graph culls passes whose results nobody reads, records one batched barrier in front
+	// of every pass from the tracked state of its resources, and lets transient images share memory when
+	// their lifetimes don't overlap.
+	//
+	// Batches on one queue must be submitted in pass order. Dependencies between the queues are the
+	// caller's semaphores, the graph only adds the layout transitions and an execution dependency on them.
+	class RenderGraph
+	{
+	public:
+		std::shared_ptr<Backend> backend;
+		RenderGraphStats stats;
+
+		RenderGraph(std::shared_ptr<Backend> backend);
+		~RenderGraph();
+
+		// Contents don't survive the frame, the memory is bound by allocate()
+		RenderGraphResource createImage(std::string name, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage);
+
+		// The image may be set later, before the first execute
+		RenderGraphResource importImage(std::string name, VkImage image, uint32_t mipLevels, VkImageAspectFlags aspect, VkImageLayout layout);
+		RenderGraphResource importBuffer(std::string name, std::shared_ptr<Buffer> buffer);
+
+		// Swaps the image behind an imported resource, its earlier uses must be ordered by a semaphore
+		void setImage(RenderGraphResource resource, VkImage image, uint32_t mipLevels, VkImageLayout layout);
+		std::shared_ptr<Image> getImage(RenderGraphResource resource) const;
+
+		void reset();
+
+		// Disabled passes are skipped, but still count for the transient lifetimes
+		RenderGraphPass addPass(std::string name, uint32_t batch, std::function<void(VkCommandBuffer)> record, bool enabled = true);
+		void read(RenderGraphPass pass, RenderGraphResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+		void write(RenderGraphPass pass, RenderGraphResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+		// The pass has effects outside the graph, like presenting or a host readback, and is never culled
+		void keep(RenderGraphPass pass);
+
+		// Binds the transient images, the declared passes must cover every path that is executed later
+		void allocate();
+
+		void execute(const std::vector<RenderGraphBatch>& batches);
+
+	private:
+		static constexpr uint32_t NO_QUEUE = ~0u;
+
+		struct ResourceState
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			uint32_t queue = NO_QUEUE;
+			VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;	// last write or layout transition
+			VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+			VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;	// reads since then
+			VkPipelineStageFlags2 visibleStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 visibleAccess = VK_ACCESS_2_NONE;
+		};
+
+		struct Resource
+		{
+			std::string name;
+			bool transient = false;
+			VkImage image = VK_NULL_HANDLE;
+			std::shared_ptr<Image> transientImage;
+			std::shared_ptr<Buffer> buffer;
+			uint32_t mipLevels = 1;
+			VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+			uint32_t memoryBlock = 0;
+			ResourceState state;
+		};
+
+		struct Access
+		{
+			RenderGraphResource resource;
+			VkPipelineStageFlags2 stages;
+			VkAccessFlags2 access;
+			VkImageLayout layout;
+			bool read;
+			bool write;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			uint32_t batch;
+			std::function<void(VkCommandBuffer)> record;
+			bool enabled;
+			bool kept = false;
+			std::vector<Access> accesses;
+		};
+
+		// Whoever used the memory last, a transient's first use each frame waits on it
+		struct MemoryBlock
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			uint32_t memoryTypeBits = ~0u;
+			std::vector<RenderGraphResource> resources;
+			RenderGraphResource owner = ~0u;
+			uint32_t queue = NO_QUEUE;
+			VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+		};
+
+		std::vector<Resource> resources;
+		std::vector<Pass> passes;
+		std::vector<MemoryBlock> memoryBlocks;
+		bool allocated = false;
+
+		void addAccess(RenderGraphPass pass, RenderGraphResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout, bool write);
+		std::vector<bool> findLivePasses() const;
+		void addBarrier(const Access& access, uint32_t queue, std::vector<VkImageMemoryBarrier2>& imageBarriers, std::vector<VkBufferMemoryBarrier2>& bufferBarriers);
+	};
+}
+
+#endif // !RENDER_GRAPH_H
@@ -0,0 +1,76 @@
+#ifndef RENDER_TARGETS_H
+#define RENDER_TARGETS_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Backend.h"
+#include "FrameContext.h"
+
+namespace vpp
+{
+	// Owns the lifetime of everything sized by the swapchain. Resize callbacks rebuild their targets in
+	// registration order when the extent changes, and whatever they replace is retired instead of
+	// destroyed: it stays alive until the frame timeline passes the last frame that may have used it,
+	// so a resize never waits for the device to go idle. Pipelines and layouts don't depend on the
+	// extent and are never part of a resize.
+	class RenderTargets
+	{
+	public:
+		std::shared_ptr<Backend> backend;
+
+		RenderTargets(std::shared_ptr<Backend> backend, std::shared_ptr<FrameContexts> frameContexts, VkExtent2D extent);
+
+		// Destroys everything still retired, the device must be idle
+		~RenderTargets();
+
+		void addResizeCallback(std::string name, std::function<void(VkExtent2D)> callback);
+
+		// Runs the callbacks when the extent differs from the current one, returns whether it did
+		bool resize(VkExtent2D extent);
+
+		// Released in reverse order once every frame begun so far has finished, so pass images before their views
+		template<typename... T>
+		void retire(std::shared_ptr<T>... resources)
+		{
+			std::vector<std::shared_ptr<void>> retired = { std::static_pointer_cast<void>(resources)... };
+			retire([retired]() mutable {
+				while (!retired.empty()) retired.pop_back();
+			});
+		}
+
+		// For raw handles, destroy runs once every frame begun so far has finished
+		void retire(std::function<void()> destroy);
+
+		// Called once per frame
+		void collect(uint64_t completedFrame);
+
+		VkExtent2D getExtent() const { return extent; }
+		uint32_t getResizeCount() const { return resizeCount; }
+		double getLastResizeTime() const { return lastResizeTime; }		// ms on the CPU, callbacks only
+		size_t getRetiredCount() const { return retired.size(); }
+
+	private:
+		struct ResizeCallback
+		{
+			std::string name;
+			std::function<void(VkExtent2D)> callback;
+		};
+
+		struct Retired
+		{
+			uint64_t frame;
+			std::function<void()> destroy;
+		};
+
+		std::shared_ptr<FrameContexts> frameContexts;
+		std::vector<ResizeCallback> callbacks;
+		std::vector<Retired> retired;
+		VkExtent2D extent;
+		uint32_t resizeCount = 0;
+		double lastResizeTime = 0.0;
+	};
+}
+
+#endif // !RENDER_TARGETS_H
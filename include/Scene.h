@@ -0,0 +1,98 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Model.h"
+#include "util.h"
+
+namespace vpp
+{
+	// Generational handle, stays invalid once its entity is destroyed even after the slot is reused
+	struct Entity
+	{
+		uint32_t index = UINT32_MAX;
+		uint32_t generation = 0;
+
+		bool operator==(const Entity& other) const = default;
+	};
+
+	// A mesh inside a model's geometry, the arena resolves where that currently is when recording
+	struct MeshRef
+	{
+		GeometryHandle geometry;
+		uint32_t indexCount;
+		uint32_t startIndex;
+		uint32_t startVertex;
+	};
+
+	// Bindless slots are looked up when recording, streaming may replace them
+	struct MaterialRef
+	{
+		uint32_t materialIndex;
+		uint32_t colorIndex;
+		TextureType textureType;
+	};
+
+	enum EntityFlags : uint32_t
+	{
+		ENTITY_CASTS_SHADOW = 1 << 0,
+		ENTITY_BACKGROUND = 1 << 1,		// surrounds the camera, never culled and not part of the scene bounds
+	};
+
+	// Entities are rows in dense component arrays, so culling, sorting and recording walk contiguous memory
+	// instead of chasing models and their nodes. Destroying an entity moves the last row into its place,
+	// which makes dense indices, and the draw lists built from them, valid only until the next destroy.
+	// Scenes share the models' geometry and materials but nothing else, any number of them can coexist.
+	class Scene
+	{
+	public:
+		Entity createEntity(const glm::mat4& transform, MeshRef mesh, MaterialRef material, const AABB& localBounds, uint32_t flags = ENTITY_CASTS_SHADOW);
+		void destroyEntity(Entity entity);
+		bool isAlive(Entity entity) const;
+
+		// One entity per node of the model, or per mesh when it has no node tree
+		std::vector<Entity> instantiate(const Model& model, const glm::mat4& transform, uint32_t flags = ENTITY_CASTS_SHADOW);
+
+		void setTransform(Entity entity, const glm::mat4& transform);
+		const glm::mat4& getTransform(Entity entity) const;
+
+		// Appends the dense index of every entity whose world bounds touch the view frustum
+		void cull(const glm::mat4& viewProj, std::vector<uint32_t>& drawList) const;
+
+		// Front to back, so the depth test rejects as much as it can
+		void sortFrontToBack(std::vector<uint32_t>& drawList, glm::vec3 viewPosition) const;
+
+		// Bounds of everything but the background
+		AABB getBounds() const;
+
+		size_t size() const { return transforms.size(); }
+
+		// Dense components, row i of each belongs to the same entity
+		const std::vector<glm::mat4>& getTransforms() const { return transforms; }
+		const std::vector<AABB>& getWorldBounds() const { return worldBounds; }
+		const std::vector<MeshRef>& getMeshes() const { return meshes; }
+		const std::vector<MaterialRef>& getMaterials() const { return materials; }
+		const std::vector<uint32_t>& getFlags() const { return flags; }
+
+	private:
+		uint32_t getDenseIndex(Entity entity) const;
+
+		std::vector<glm::mat4> transforms;
+		std::vector<AABB> localBounds;
+		std::vector<AABB> worldBounds;
+		std::vector<MeshRef> meshes;
+		std::vector<MaterialRef> materials;
+		std::vector<uint32_t> flags;
+		std::vector<uint32_t> denseToSlot;
+
+		std::vector<uint32_t> slotToDense;
+		std::vector<uint32_t> generations;
+		std::vector<uint32_t> freeSlots;
+
+		mutable std::vector<uint64_t> sortKeys;	// reused between frames
+	};
+}
+
+#endif // !SCENE_H
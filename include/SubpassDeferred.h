@@ -0,0 +1,87 @@
+#ifndef SUBPASS_DEFERRED_H
+#define SUBPASS_DEFERRED_H
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Backend.h"
+#include "RenderTargets.h"
+
+// Geometry, lighting and composition as three subpasses of one render pass. Lighting reads the
+// G-buffer and depth with subpassLoad, composition tone maps the lighting result into the swapchain,
+// so on tile-based GPUs the G-buffer never leaves tile memory. The attachments are transient and
+// lazily allocated where the device has such memory.
+//
+// Only the pixel under the fragment can be read, so AO, TAA, bloom, sharpening and a reduced
+// render scale aren't available in this path.
+class SubpassDeferred
+{
+public:
+	std::shared_ptr<vpp::Backend> backend;
+
+	bool enabled = false;
+	bool lazilyAllocated = false;
+
+	VkRenderPass renderPass;
+
+	// Per frame sets of the lighting pass are passed to record, the G-buffer inputs live here
+	SubpassDeferred(std::shared_ptr<vpp::Backend> backend, std::shared_ptr<vpp::SuperDescriptorSetLayout> perFrameLayout, std::shared_ptr<vpp::SuperDescriptorSetLayout> lightingImageLayout,
+		std::shared_ptr<vpp::SuperDescriptorSetLayout> depthImageLayout, std::shared_ptr<vpp::SuperDescriptorSetLayout> lightingDataLayout,
+		std::shared_ptr<vpp::Buffer> exposureBuffer, std::shared_ptr<vpp::Buffer> histogramBuffer);
+	~SubpassDeferred();
+
+	// Sized to the swapchain with a framebuffer per swapchain image, so rebuilt whenever it is recreated.
+	// Lazily allocated attachments make that cheap, the old targets are retired.
+	void recreateTargets(vpp::RenderTargets& renderTargets);
+
+	// Leaves the swapchain image in COLOR_ATTACHMENT_OPTIMAL and adds its pixels to the luminance histogram.
+	// lightingOffsets are the dynamic offsets of the depth image and lighting data sets together.
+	void record(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkDescriptorSet perFrameSet, const std::vector<uint32_t>& perFrameOffsets, VkDescriptorSet depthImageSet,
+		VkDescriptorSet lightingDataSet, const std::vector<uint32_t>& lightingOffsets, const std::function<void(VkCommandBuffer)>& renderObjects);
+
+	VkDeviceSize getAttachmentMemory() const;
+
+private:
+	enum Attachment
+	{
+		SWAPCHAIN_ATTACHMENT,
+		DEPTH_ATTACHMENT,
+		NORMAL_ATTACHMENT,
+		ALBEDO_ATTACHMENT,
+		METALLIC_ATTACHMENT,
+		ROUGHNESS_ATTACHMENT,
+		HDR_ATTACHMENT,
+		ATTACHMENT_COUNT
+	};
+
+	// Same formats as the compute path's G-buffer
+	std::array<VkFormat, ATTACHMENT_COUNT> formats;
+	std::array<std::shared_ptr<vpp::Image>, ATTACHMENT_COUNT> images;
+	std::array<std::shared_ptr<vpp::ImageView>, ATTACHMENT_COUNT> imageViews;
+	std::vector<VkFramebuffer> framebuffers;
+	VkExtent2D extent = { 0, 0 };
+
+	std::shared_ptr<vpp::Buffer> exposureBuffer;
+	std::shared_ptr<vpp::Buffer> histogramBuffer;
+	std::shared_ptr<vpp::Sampler> sampler;
+
+	std::shared_ptr<vpp::SuperDescriptorSetLayout> gBufferInputLayout;
+	std::shared_ptr<vpp::SuperDescriptorSetLayout> compositionLayout;
+	std::shared_ptr<vpp::SuperDescriptorSet> gBufferInputDescriptorSet;
+	std::shared_ptr<vpp::SuperDescriptorSet> compositionDescriptorSet;
+
+	std::shared_ptr<vpp::GraphicsPipeline> geometryPipeline;
+	std::shared_ptr<vpp::GraphicsPipeline> lightingPipeline;
+	std::shared_ptr<vpp::GraphicsPipeline> compositionPipeline;
+
+	void createRenderPass();
+	void createDescriptorSetLayouts();
+	void createPipelines(std::shared_ptr<vpp::SuperDescriptorSetLayout> perFrameLayout, std::shared_ptr<vpp::SuperDescriptorSetLayout> lightingImageLayout,
+		std::shared_ptr<vpp::SuperDescriptorSetLayout> depthImageLayout, std::shared_ptr<vpp::SuperDescriptorSetLayout> lightingDataLayout);
+	void createTargets();
+	void destroyTargets();
+	std::shared_ptr<vpp::Image> createAttachment(Attachment attachment, VkImageUsageFlags usage, std::string name);
+};
+
+#endif // !SUBPASS_DEFERRED_H
@@ -0,0 +1,69 @@
+#ifndef TEMPORAL_ANTI_ALIASING_H
+#define TEMPORAL_ANTI_ALIASING_H
+
+#include <array>
+#include <memory>
+#include "Backend.h"
+#include "RenderTargets.h"
+#include "util.h"
+
+struct TemporalAntiAliasingPushConstants
+{
+	glm::vec2 jitter;
+	uint32_t renderWidth;
+	uint32_t renderHeight;
+	float blendFactor;
+	uint32_t historyValid;
+	uint32_t enabled;
+	uint32_t padding;
+};
+
+// Resolves the jittered, possibly lower resolution lighting image into a full resolution
+// output using reprojected history. When disabled the pass is a plain bilinear upscale.
+class TemporalAntiAliasing
+{
+public:
+	static const uint32_t JITTER_SAMPLE_COUNT = 8;
+
+	std::shared_ptr<vpp::Backend> backend;
+
+	bool enabled = true;
+	float blendFactor = 0.1f;
+
+	uint32_t width;
+	uint32_t height;
+
+	// Written every frame, so it can be a transient render graph image. The history persists.
+	std::shared_ptr<vpp::Image> outputImage;
+	std::shared_ptr<vpp::ImageView> outputImageView;
+	std::array<std::shared_ptr<vpp::Image>, 2> historyImages;
+
+	TemporalAntiAliasing(std::shared_ptr<vpp::Backend> backend, std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> velocityImageView, std::shared_ptr<vpp::Image> outputImage);
+	~TemporalAntiAliasing();
+
+	// New targets for a new output size, the old ones are retired and the history starts over
+	void resize(vpp::RenderTargets& renderTargets, std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> velocityImageView, std::shared_ptr<vpp::Image> outputImage);
+
+	// Sub-pixel offset in render pixels for the next frame, zero when disabled
+	glm::vec2 nextJitter();
+	void resetHistory();
+
+	// jitter is the offset returned by nextJitter for this frame
+	void record(VkCommandBuffer commandBuffer, VkExtent2D renderExtent, glm::vec2 jitter);
+
+private:
+	std::array<std::shared_ptr<vpp::ImageView>, 2> historyImageViews;
+	std::shared_ptr<vpp::Sampler> sampler;
+
+	std::shared_ptr<vpp::SuperDescriptorSetLayout> descriptorSetLayout;
+	std::array<std::shared_ptr<vpp::SuperDescriptorSet>, 2> descriptorSets;
+	std::shared_ptr<vpp::ComputePipeline> resolvePipeline;
+
+	uint32_t frameIndex = 0;
+	bool historyValid = false;
+	bool wasEnabled = true;
+
+	void createTargets(std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> velocityImageView, std::shared_ptr<vpp::Image> outputImage);
+};
+
+#endif // !TEMPORAL_ANTI_ALIASING_H
@@ -0,0 +1,50 @@
+#ifndef TEXTURE_PACKING_H
+#define TEXTURE_PACKING_H
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Backend.h"
+
+namespace vpp
+{
+	enum OrmChannel
+	{
+		ORM_OCCLUSION,
+		ORM_ROUGHNESS,
+		ORM_METALLIC,
+		ORM_CHANNEL_COUNT
+	};
+
+	// One channel of an image file, an empty path leaves the channel to its default
+	struct TextureChannelSource
+	{
+		std::string path;
+		uint32_t channel = 0;
+	};
+
+	// glTF metallicRoughness maps are one file with roughness in G and metallic in B, occlusion sometimes
+	// shares it in R. Separate grayscale maps read from R.
+	typedef std::array<TextureChannelSource, ORM_CHANNEL_COUNT> OrmSources;
+
+	struct PackedTexture
+	{
+		std::shared_ptr<Image> image;
+		std::shared_ptr<ImageView> imageView;
+		uint32_t channelCount = 0;		// stored channels, 0 when there was no map at all
+		VkDeviceSize size = 0;			// every mip level
+		VkDeviceSize unpackedSize = 0;	// metallic and roughness as separate RGBA8 textures with mips, occlusion had none
+	};
+
+	// Packs occlusion, roughness and metallic into one texture that stores only the channels that have a map:
+	// BC4 or R8 for one, BC5 or RG8 for two, RGBA8 for all three. Everything is UNORM, these aren't colors.
+	// The view swizzles the stored channels back into the glTF layout, so shaders always read occlusion,
+	// roughness and metallic from .r, .g and .b with a single fetch; a missing map reads as the default.
+	PackedTexture createOrmTexture(std::shared_ptr<Backend> backend, const OrmSources& sources, std::string name);
+
+	// Occlusion 1, roughness 1 and metallic 0 for materials without any of the maps
+	std::shared_ptr<ImageView> createDefaultOrmView(std::shared_ptr<Backend> backend, std::shared_ptr<Image> image);
+}
+
+#endif // !TEXTURE_PACKING_H
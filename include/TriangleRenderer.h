@@ -4,6 +4,17 @@
 #include "Application.h"
 #include <array>
 #include "Model.h"
+#include "Scene.h"
+#include "Bloom.h"
+#include "CascadedShadowMap.h"
+#include "AmbientOcclusion.h"
+#include "TemporalAntiAliasing.h"
+#include "DynamicResolution.h"
+#include "GpuProfiler.h"
+#include "Benchmark.h"
+#include "AsyncCompute.h"
+#include "RenderGraph.h"
+#include "SubpassDeferred.h"
 #include "util.h"
 
 struct ViewportDims
@@ -12,36 +23,123 @@ struct ViewportDims
 	uint32_t height;
 };
 
+struct LuminanceAveragePushConstants
+{
+	uint32_t pixelCount;
+	float deltaTime;
+};
+
+// Render graph batches, culling and lighting go to the compute queue with async compute
+enum RenderBatch
+{
+	GEOMETRY_BATCH,
+	SHADOW_BATCH,
+	CULLING_BATCH,
+	LIGHTING_BATCH,
+	PRESENT_BATCH,
+	RENDER_BATCH_COUNT
+};
+
 class TriangleRenderer : public vpp::Application
 {
 private:
 
 	vpp::Camera camera;
-	std::vector<std::shared_ptr<vpp::Model>> models;
-	std::shared_ptr<vpp::Model> sky;
+	std::shared_ptr<vpp::Scene> scene;
+	std::vector<uint32_t> drawList;				// culled and sorted dense scene indices of this frame
+	std::vector<vpp::Entity> skyEntities;
+	std::vector<glm::mat4> skyTransforms;		// around the origin, moved to the camera every frame
 
 	std::shared_ptr<vpp::GraphicsPipeline> graphicsPipeline;
 	std::shared_ptr<vpp::GraphicsPipeline> geometryPassGraphicsPipeline;
 	std::shared_ptr<vpp::ComputePipeline> lightingPassComputePipeline;
+	std::shared_ptr<vpp::ComputePipeline> lightingPassFp16ComputePipeline;
+	std::shared_ptr<vpp::ComputePipeline> fusedLightingPassComputePipeline;
+	std::shared_ptr<vpp::ComputePipeline> fusedLightingPassFp16ComputePipeline;
+	std::shared_ptr<vpp::ComputePipeline> lightCullingComputePipeline;
+	std::shared_ptr<vpp::ComputePipeline> depthlessLightCullingComputePipeline;
 	std::shared_ptr<vpp::GraphicsPipeline> toneMappingPassGraphicsPipeline;
+	std::shared_ptr<vpp::GraphicsPipeline> ldrPresentGraphicsPipeline;
+	std::shared_ptr<vpp::ComputePipeline> luminanceHistogramComputePipeline;
+	std::shared_ptr<vpp::ComputePipeline> luminanceAverageComputePipeline;
 
 	vpp::Controls controls;
 
-	std::vector<std::shared_ptr<vpp::Buffer>> viewProjectionUniformBuffers;
-	std::vector<std::shared_ptr<vpp::Buffer>> modelUniformBuffers;
-	std::vector<std::shared_ptr<vpp::Buffer>> cameraLightInfoBuffers;
-	std::vector<std::shared_ptr<vpp::Buffer>> controlUniformBuffers;
-	std::vector<std::shared_ptr<vpp::Buffer>> viewportUniformBuffers;
+	// Dynamic offsets of this frame's constants in the uniform allocator
+	std::vector<uint32_t> perFrameOffsets;	// view projection, model, camera and light, controls
+	uint32_t viewportOffset = 0;
+	uint32_t shadowDataOffset = 0;
+
+	std::vector<vpp::Light> lights;
+	std::vector<glm::vec3> lightBasePositions;
+	int activeLightCount = 1024;
+	bool animateLights = true;
+	uint32_t tileCountX;
+	uint32_t tileCountY;
+	std::vector<std::shared_ptr<vpp::Buffer>> lightBuffers;
+	std::shared_ptr<vpp::Buffer> tileLightBuffer;
+
+	bool useFp16Lighting = false;
+	bool fusedToneMapping = false;
+
+	bool autoExposure = true;
+	std::shared_ptr<vpp::Buffer> luminanceHistogramBuffer;
+	std::shared_ptr<vpp::Buffer> exposureBuffer;
+	std::vector<std::shared_ptr<vpp::Buffer>> luminanceReadbackBuffers;
+	std::array<float, vpp::HISTOGRAM_BIN_COUNT> luminanceHistogram{};
+	vpp::ExposureData exposureData{};
+	bool lightingBenchmark = false;
+	int lightingBenchmarkIterations = 16;
+	float lightingPassTime = 0.0f;
+	float gpuFrameTime = 0.0f;
+
+	std::shared_ptr<vpp::GpuProfiler> gpuProfiler;
+	std::vector<uint32_t> lightingDispatchCounts;
+
+	// Null without a second queue, the switch lets the overlap be measured against the single queue path
+	std::shared_ptr<vpp::AsyncCompute> asyncCompute;
+	bool asyncComputeEnabled = true;
+
+	// Declared again every frame. The G-buffer, lighting, resolve and bloom images are transient
+	// and share memory where their lifetimes allow it.
+	std::shared_ptr<vpp::RenderGraph> renderGraph;
+	vpp::RenderGraphResource depthResource;
+	vpp::RenderGraphResource normalResource;
+	vpp::RenderGraphResource albedoResource;
+	vpp::RenderGraphResource metallicResource;
+	vpp::RenderGraphResource roughnessResource;
+	vpp::RenderGraphResource velocityResource;
+	vpp::RenderGraphResource lightingResource;
+	vpp::RenderGraphResource ldrResource;
+	vpp::RenderGraphResource resolveResource;
+	vpp::RenderGraphResource bloomResource;
+	vpp::RenderGraphResource shadowAtlasResource;
+	vpp::RenderGraphResource aoRawResource;
+	vpp::RenderGraphResource aoOutputResource;
+	std::array<vpp::RenderGraphResource, 2> historyResources;
+	vpp::RenderGraphResource swapChainResource;
+	vpp::RenderGraphResource tileLightResource;
+	vpp::RenderGraphResource histogramResource;
+	vpp::RenderGraphResource exposureResource;
 
 	std::shared_ptr<vpp::SuperDescriptorSetLayout> perFrameDescriptorSetLayout;
 	std::shared_ptr<vpp::SuperDescriptorSetLayout> gBufferDescriptorSetLayout;
 	std::shared_ptr<vpp::SuperDescriptorSetLayout> lightingImageDescriptorSetLayout;
 	std::shared_ptr<vpp::SuperDescriptorSetLayout> depthImageDescriptorSetLayout;
+	std::shared_ptr<vpp::SuperDescriptorSetLayout> lightingDataDescriptorSetLayout;
+	std::shared_ptr<vpp::SuperDescriptorSetLayout> toneMappingInputDescriptorSetLayout;
+	std::shared_ptr<vpp::SuperDescriptorSetLayout> luminanceDescriptorSetLayout;
 
-	std::vector< std::shared_ptr<vpp::SuperDescriptorSet>> perFrameDescriptorSets;
+	std::shared_ptr<vpp::SuperDescriptorSet> perFrameDescriptorSet;
 	std::shared_ptr<vpp::SuperDescriptorSet> gBufferDescriptorSet;
 	std::shared_ptr<vpp::SuperDescriptorSet> lightingImageDescriptorSet;
 	std::shared_ptr<vpp::SuperDescriptorSet> depthImageDescriptorSet;
+	std::vector<std::shared_ptr<vpp::SuperDescriptorSet>> lightingDataDescriptorSets;
+	std::shared_ptr<vpp::SuperDescriptorSet> hdrInputDescriptorSet;
+	std::shared_ptr<vpp::SuperDescriptorSet> ldrImageDescriptorSet;
+	std::shared_ptr<vpp::SuperDescriptorSet> ldrInputDescriptorSet;
+	std::vector<std::shared_ptr<vpp::SuperDescriptorSet>> swapChainImageDescriptorSets;
+	std::shared_ptr<vpp::SuperDescriptorSet> luminanceDescriptorSet;
 
 	std::shared_ptr<vpp::Image> positionImage;
 	std::shared_ptr<vpp::ImageView> positionImageView;
@@ -58,35 +156,95 @@ private:
 	std::shared_ptr<vpp::Image> roughnessImage;
 	std::shared_ptr<vpp::ImageView> roughnessImageView;
 
+	std::shared_ptr<vpp::Image> velocityImage;
+	std::shared_ptr<vpp::ImageView> velocityImageView;
+
 	std::shared_ptr<vpp::Image> lightingImage;
 	std::shared_ptr<vpp::ImageView> lightingImageView;
 
-	VkFramebuffer geometryPassFrameBuffer;
+	// Fused tone mapping target when the swapchain can't be written from compute
+	std::shared_ptr<vpp::Image> ldrImage;
+	std::shared_ptr<vpp::ImageView> ldrImageView;
+
+	std::shared_ptr<Bloom> bloom;
+
+	// Replaces the geometry, lighting and tone mapping passes when enabled, with culling moved ahead of it
+	std::shared_ptr<SubpassDeferred> subpassDeferred;
+
+	glm::vec3 sunDirection = glm::vec3(-1.0f, 1.0f, -1.0f);
+	std::shared_ptr<CascadedShadowMap> shadowMap;
+	std::vector<ShadowCaster> shadowCasters;
+
+	std::shared_ptr<AmbientOcclusion> ambientOcclusion;
+	float aoStrength = 1.0f;
+
+	// The G-buffer and lighting run in the top left part of their images, the temporal
+	// resolve reconstructs the full swapchain resolution from it
+	std::shared_ptr<TemporalAntiAliasing> temporalAntiAliasing;
+	float renderScale = 1.0f;
+	glm::mat4 previousViewProj = glm::mat4(1.0f);
+	bool previousViewProjValid = false;
+	DynamicResolution dynamicResolution;
+
+	Benchmark benchmark;
+	CameraPathRecorder cameraPathRecorder;
+
+	VkFramebuffer geometryPassFrameBuffer = VK_NULL_HANDLE;
 	VkRenderPass geometryPassRenderPass;
+	VkRenderPass fusedOverlayRenderPass;
 	std::shared_ptr<vpp::Sampler> sampler;
 
 public:
-	TriangleRenderer(std::string app_name, uint32_t apiVersion, std::vector<VkValidationFeatureEnableEXT> validation_features);
+	TriangleRenderer(std::string app_name, uint32_t apiVersion, std::vector<VkValidationFeatureEnableEXT> validation_features, vpp::HeadlessSettings headless = {}, BenchmarkSettings benchmarkSettings = {});
 
 	void main_loop_extended(uint32_t currentFrame, uint32_t imageIndex) override;
 	void cleanup_extended() override;
 	void createGraphicsPipeline();
 	void createLightingPassPipeline();
+	std::shared_ptr<vpp::ComputePipeline> createLightingPassVariant(std::string name, std::string path, bool fused);
+	std::shared_ptr<vpp::ComputePipeline> getLightingPassPipeline();
+	void createFusedOverlayRenderPass();
+	void createAutoExposureBuffers();
+	void createAutoExposurePipelines();
+	void clearLuminanceHistogram(VkCommandBuffer commandBuffer);
+	void recordLuminanceHistogram(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+	void recordAutoExposure(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+	void recordLuminanceReadback(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+	void readLuminanceHistogram(uint32_t currentFrame);
+	void createSwapChainImageDescriptorSets();
+	void recreateSwapChain_extended() override;
+	void createLightCullingPipeline();
+	void recordLightCulling(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+	void recordLightingPass(VkCommandBuffer commandBuffer, uint32_t currentFrame, uint32_t imageIndex);
+	void recordBloom(VkCommandBuffer commandBuffer);
+	void recordTemporalResolve(VkCommandBuffer commandBuffer);
+	bool useAsyncCompute();
+	bool fusedIntoSwapChain();
+	bool presentLoadsSwapChain();
+	void setAsyncCompute(bool enabled) { asyncComputeEnabled = enabled; }
+	VkExtent2D getRenderExtent();
+	void createLights();
+	void createTileLightBuffer();
+	vpp::AABB getSceneBounds();
+	void gatherShadowCasters();
+	void updateLights(uint32_t currentFrame);
 	void createGeometryPassPipeline();
 	void createToneMappingPassPipeline();
 	void createGeometryPassFrameBuffer();
 	void createGeometryPassImages();
+	void declareRenderGraph(uint32_t currentFrame, uint32_t imageIndex, bool allPaths = false);
 	void createGeometryPassRenderPass();
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 	void recordCommandBuffer(uint32_t currentFrame, uint32_t imageIndex) override;
-	void renderObjects();
+	void renderObjects(VkCommandBuffer commandBuffer);
 	void beginRenderPass(uint32_t currentFrame, uint32_t imageIndex);
-	void beginGeometryPass(uint32_t currentFrame, uint32_t imageIndex);
-	void setDynamicState();
-	void createUniformBuffers();
+	void beginGeometryPass(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+	void setDynamicState(VkCommandBuffer commandBuffer, VkExtent2D extent);
 	void initialize();
 	void updateUniformBuffers(uint32_t currentFrame);
 	void createDescriptorSets();
+	void createRenderTargetDescriptorSets();
+	void resizeRenderTargets();
 	void key_callback_extended(GLFWwindow* window, int key, int scancode, int action, int mods, double deltaTime) override;
 	void mouse_callback_extended(GLFWwindow* window, int button, int action, int mods, double deltaTime) override;
 	void cursor_position_callback_extended(GLFWwindow* window, double xpos, double ypos) override;
@@ -0,0 +1,61 @@
+#ifndef UNIFORM_ALLOCATOR_H
+#define UNIFORM_ALLOCATOR_H
+
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "Backend.h"
+#include "FrameContext.h"
+
+namespace vpp
+{
+	struct UniformAllocation
+	{
+		void* data;
+		uint32_t offset;	// dynamic offset into the allocator's buffer
+	};
+
+	// Transient constants are bump allocated from one persistently mapped buffer with a region per frame
+	// context, and bound through dynamic uniform buffer descriptors that all point at the same buffer.
+	// The buffer lives in host visible VRAM when the device has it (resizable BAR or the 256 MB window),
+	// so shaders don't read it across the bus.
+	//
+	// beginFrame resets a region once the frame timeline has retired the last frame that allocated from it.
+	class UniformAllocator
+	{
+	public:
+		std::shared_ptr<Backend> backend;
+		std::shared_ptr<Buffer> buffer;
+
+		UniformAllocator(std::shared_ptr<Backend> backend, std::shared_ptr<FrameContexts> frameContexts, VkDeviceSize regionSize);
+
+		void beginFrame(uint32_t frameContextIndex, uint64_t frameNumber);
+
+		// Aligned for dynamic uniform and storage buffer offsets, valid until the frame retires
+		UniformAllocation allocate(VkDeviceSize size);
+
+		template<typename T>
+		uint32_t push(const T& value)
+		{
+			UniformAllocation allocation = allocate(sizeof(T));
+			memcpy(allocation.data, &value, sizeof(T));
+			return allocation.offset;
+		}
+
+		bool isDeviceLocal() const { return (buffer->memoryProperties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0; }
+		VkDeviceSize getRegionSize() const { return regionSize; }
+		VkDeviceSize getUsedSize() const { return head - regionStart; }
+		VkDeviceSize getPeakUsedSize() const { return peakUsedSize; }
+
+	private:
+		std::shared_ptr<FrameContexts> frameContexts;
+		VkDeviceSize regionSize;
+		VkDeviceSize alignment;
+		std::vector<uint64_t> regionFrames;
+		VkDeviceSize regionStart = 0;
+		VkDeviceSize head = 0;
+		VkDeviceSize peakUsedSize = 0;
+	};
+}
+
+#endif // !UNIFORM_ALLOCATOR_H
@@ -7,6 +7,7 @@
 #include <optional>
 #include <vector>
 #include <memory>
+#include <limits>
 
 namespace vpp
 {
@@ -18,6 +19,10 @@ namespace vpp
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
 
+        // Async compute, either a family without graphics or a second queue of the graphics family
+        std::optional<uint32_t> computeFamily;
+        uint32_t computeQueueIndex = 0;
+
         bool isComplete()
         {
             return graphicsFamily.has_value() && presentFamily.has_value();
@@ -35,7 +40,8 @@ namespace vpp
     {
         CONTINOUS_TRANSFER,
         ONE_TIME_TRANSFER,
-        GPU_ONLY
+        GPU_ONLY,
+        MAPPED_DEVICE_LOCAL     // persistently mapped like CONTINOUS_TRANSFER, in VRAM when it is host visible
     };
 
     struct TextureImageCreationResults
@@ -47,6 +53,11 @@ namespace vpp
     struct ViewProjectionMatrices {
         glm::mat4 view;
         glm::mat4 proj;
+        glm::mat4 inverseViewProj;
+        glm::mat4 inverseProj;
+        glm::mat4 unjitteredViewProj;
+        glm::mat4 previousViewProj;		// unjittered, for motion vectors
+        glm::vec4 jitter;				// xy: sub-pixel offset in UV units
     };
 
 	struct Vertex {
@@ -87,14 +98,49 @@ namespace vpp
 		}
 	};
 
+	struct AABB
+	{
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+		void expand(const glm::vec3& point)
+		{
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+
+		void expand(const AABB& other)
+		{
+			min = glm::min(min, other.min);
+			max = glm::max(max, other.max);
+		}
+
+		bool isValid() const
+		{
+			return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+		}
+
+		AABB transform(const glm::mat4& matrix) const
+		{
+			AABB result;
+			for (uint32_t i = 0; i < 8; i++)
+			{
+				glm::vec3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+				result.expand(glm::vec3(matrix * glm::vec4(corner, 1.0f)));
+			}
+			return result;
+		}
+	};
+
 	struct Mesh
 	{
 		uint32_t materialIndex;
 		uint32_t colorIndex;
 		uint32_t vertexCount;
 		uint32_t indexCount;
-		uint32_t startIndex;
+		uint32_t startIndex;		// relative to the model's geometry range, indices to the mesh's first vertex
 		uint32_t startVertex;
+		AABB bounds;
 	};
 
 	struct Node
@@ -114,7 +160,8 @@ namespace vpp
 	{
 		glm::mat4 submeshTransform;
 		glm::mat4 modelTransform;
-		uint32_t materialIndex;
+		uint32_t albedoIndex;		// bindless heap slots
+		uint32_t ormIndex;
 		uint32_t colorIndex;
 		uint32_t textureType;
 	};
@@ -125,10 +172,78 @@ namespace vpp
 		glm::vec4 lightDir;
 	};
 
+	// Must match the defines in toneMapping.glsl
+	enum ToneMappingOperator
+	{
+		TONE_MAPPING_ACES,
+		TONE_MAPPING_REINHARD,
+		TONE_MAPPING_AGX
+	};
+
 	struct Controls
 	{
 		float sunlightIntensity;
 		float ambientFactor;
+		float exposure;				// EV, applied as exp2(exposure), added on top of auto exposure
+		uint32_t toneMappingOperator;
+		float minLogLuminance;
+		float logLuminanceRange;
+		float adaptationRate;
+		uint32_t autoExposure;
+		float bloomIntensity;		// 0 when bloom is disabled
+		float aoStrength;			// 0 when ambient occlusion is disabled
+		float sharpness;			// 0 disables sharpening in the tone mapping pass
+	};
+
+	// Must match luminanceHistogram.glsl and luminanceAverage.comp
+	const uint32_t HISTOGRAM_BIN_COUNT = 256;
+
+	struct ExposureData
+	{
+		float adaptedLuminance;
+		float exposure;
+	};
+
+	// Must match lightingPass.glsl, cascades are laid out in a SHADOW_ATLAS_TILES x SHADOW_ATLAS_TILES atlas
+	const uint32_t SHADOW_CASCADE_COUNT = 4;
+	const uint32_t SHADOW_ATLAS_TILES = 2;
+
+	struct ShadowData
+	{
+		glm::mat4 cascadeViewProj[SHADOW_CASCADE_COUNT];
+		glm::vec4 cascadeSplits;		// far view distance of each cascade
+		glm::vec4 cascadeTexelSizes;	// world size of a shadow map texel in each cascade
+		float normalOffset;				// in texels
+		uint32_t pcfRadius;
+		uint32_t enabled;
+		float atlasTexelSize;
+	};
+
+	// Must match the tile size and list capacity in lightCulling.comp and lightingPass.comp
+	const uint32_t LIGHT_TILE_SIZE = 16;
+	const uint32_t MAX_LIGHTS = 4096;
+	const uint32_t MAX_LIGHTS_PER_TILE = 255;
+
+	enum LightType
+	{
+		POINT_LIGHT,
+		SPOT_LIGHT
+	};
+
+	struct Light
+	{
+		glm::vec4 positionRadius;	// xyz world position, w range
+		glm::vec4 colorIntensity;	// rgb color, a intensity
+		glm::vec4 directionType;	// xyz spot direction, w LightType
+		glm::vec4 spotAngles;		// x cos(inner angle), y cos(outer angle)
+	};
+
+	struct LightBufferHeader
+	{
+		uint32_t lightCount;
+		uint32_t tileCountX;
+		uint32_t tileCountY;
+		uint32_t padding;
 	};
 }
 
@@ -0,0 +1,108 @@
+#include "AmbientOcclusion.h"
+
+AmbientOcclusion::AmbientOcclusion(std::shared_ptr<vpp::Backend> backend, std::shared_ptr<vpp::SuperDescriptorSetLayout> perFrameDescriptorSetLayout, std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> normalImageView, uint32_t fullWidth, uint32_t fullHeight) :
+    backend(backend)
+{
+    // Only ever read with texelFetch
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+    sampler = std::make_shared<vpp::Sampler>(backend, samplerInfo, "Ambient occlusion sampler");
+
+    descriptorSetLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "Ambient occlusion descriptor set layout");
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1); // depth
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1); // normals
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1); // raw output
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1); // raw input
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1); // denoised output
+    descriptorSetLayout->createLayout();
+
+    createTargets(depthImageView, normalImageView, fullWidth, fullHeight);
+
+    gtaoPipeline = std::make_shared<vpp::ComputePipeline>(backend, "AmbientOcclusion::GTAO Pipeline", "shaders/gtao.comp.spv");
+    gtaoPipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
+    gtaoPipeline->addDescriptorSetLayout(descriptorSetLayout);
+    gtaoPipeline->addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(AmbientOcclusionPushConstants));
+    gtaoPipeline->createPipeline();
+
+    denoisePipeline = std::make_shared<vpp::ComputePipeline>(backend, "AmbientOcclusion::Denoise Pipeline", "shaders/aoDenoise.comp.spv");
+    denoisePipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
+    denoisePipeline->addDescriptorSetLayout(descriptorSetLayout);
+    denoisePipeline->addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(AmbientOcclusionPushConstants));
+    denoisePipeline->createPipeline();
+}
+
+AmbientOcclusion::~AmbientOcclusion()
+{
+    gtaoPipeline.reset();
+    denoisePipeline.reset();
+    descriptorSet.reset();
+    descriptorSetLayout.reset();
+    sampler.reset();
+    rawImageView.reset();
+    rawImage.reset();
+    outputImageView.reset();
+    outputImage.reset();
+}
+
+void AmbientOcclusion::resize(vpp::RenderTargets& renderTargets, std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> normalImageView, uint32_t fullWidth, uint32_t fullHeight)
+{
+    renderTargets.retire(rawImage, outputImage, rawImageView, outputImageView, descriptorSet);
+    createTargets(depthImageView, normalImageView, fullWidth, fullHeight);
+}
+
+// Both images start out undefined, the render graph transitions them on first use
+void AmbientOcclusion::createTargets(std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> normalImageView, uint32_t fullWidth, uint32_t fullHeight)
+{
+    width = (fullWidth + 1) / 2;
+    height = (fullHeight + 1) / 2;
+
+    rawImage = std::make_shared<vpp::Image>(backend, width, height, 1, 1, VK_FORMAT_R16G16_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Ambient occlusion::Raw Image");
+    rawImageView = std::make_shared<vpp::ImageView>(backend, rawImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Ambient occlusion raw Image View");
+
+    outputImage = std::make_shared<vpp::Image>(backend, width, height, 1, 1, VK_FORMAT_R16G16_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Ambient occlusion::Output Image");
+    outputImageView = std::make_shared<vpp::ImageView>(backend, outputImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Ambient occlusion output Image View");
+
+    descriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, descriptorSetLayout, "Ambient occlusion descriptor set");
+    descriptorSet->addImagesToBinding({ depthImageView }, { sampler }, { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL });
+    descriptorSet->addImagesToBinding({ normalImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+    descriptorSet->addImagesToBinding({ rawImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+    descriptorSet->addImagesToBinding({ rawImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+    descriptorSet->addImagesToBinding({ outputImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+    descriptorSet->createDescriptorSet();
+}
+
+void AmbientOcclusion::shaderBarrier(VkCommandBuffer commandBuffer)
+{
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void AmbientOcclusion::record(VkCommandBuffer commandBuffer, VkDescriptorSet perFrameDescriptorSet, const std::vector<uint32_t>& perFrameOffsets, VkExtent2D renderExtent)
+{
+    AmbientOcclusionPushConstants pushConstants{ radius, denoiseSharpness, static_cast<uint32_t>(sliceCount), static_cast<uint32_t>(stepCount), renderExtent.width, renderExtent.height };
+    uint32_t groupCountX = ((renderExtent.width + 1) / 2 + 7) / 8;
+    uint32_t groupCountY = ((renderExtent.height + 1) / 2 + 7) / 8;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gtaoPipeline->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gtaoPipeline->pipelineLayout, 0, 1, &perFrameDescriptorSet, static_cast<uint32_t>(perFrameOffsets.size()), perFrameOffsets.data());
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gtaoPipeline->pipelineLayout, 1, 1, &descriptorSet->descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, gtaoPipeline->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(AmbientOcclusionPushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+
+    shaderBarrier(commandBuffer);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, denoisePipeline->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, denoisePipeline->pipelineLayout, 0, 1, &perFrameDescriptorSet, static_cast<uint32_t>(perFrameOffsets.size()), perFrameOffsets.data());
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, denoisePipeline->pipelineLayout, 1, 1, &descriptorSet->descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, denoisePipeline->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(AmbientOcclusionPushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+}
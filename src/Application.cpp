@@ -1,13 +1,19 @@
 #include "Application.h"
+#include "CpuProfiler.h"
 
 #include <set>
+#include <map>
 #include <cstdint> // Necessary for uint32_t
 #include <limits> // Necessary for std::numeric_limits
 #include <algorithm> // Necessary for std::clamp
 #include <fstream>
+#include <cstring>
+#include <filesystem>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
 
 #include <array>
 
@@ -37,16 +43,31 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
     }
 }
 
-vpp::Application::Application(std::string app_name, uint32_t apiVersion, std::vector<VkValidationFeatureEnableEXT> validation_features) :
-    APP_NAME(app_name)
+vpp::Application::Application(std::string app_name, uint32_t apiVersion, std::vector<VkValidationFeatureEnableEXT> validation_features, HeadlessSettings headless) :
+    APP_NAME(app_name), headless(headless)
 {
     backend = std::make_shared<vpp::Backend>();
+    backend->headless = headless.enabled;
 
-    init_window();
+    if (headless.enabled)
+    {
+        WIDTH = headless.width;
+        HEIGHT = headless.height;
+        backend->swapChainFinalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+        std::erase_if(deviceExtensions, [](const char* extension) { return strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0; });
+    }
+    else
+    {
+        init_window();
+    }
 
     create_instance(apiVersion, validation_features);
     setupDebugMessenger();
-    createSurface();
+    if (!headless.enabled)
+    {
+        createSurface();
+    }
     pickPhysicalDevice();
     createLogicalDevice();
     createCommandPool();
@@ -58,6 +79,7 @@ vpp::Application::Application(std::string app_name, uint32_t apiVersion, std::ve
     createSwapChainRenderPass();
     createDepthResources();
     createSwapChainFramebuffers();
+    createRenderTargets();
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -66,7 +88,10 @@ vpp::Application::Application(std::string app_name, uint32_t apiVersion, std::ve
     ImGui::StyleColorsDark();
     
     // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForVulkan(backend->window, true);
+    if (!headless.enabled)
+    {
+        ImGui_ImplGlfw_InitForVulkan(backend->window, true);
+    }
     ImGui_ImplVulkan_InitInfo init_info = {};
     init_info.Instance = backend->instance;
     init_info.PhysicalDevice = backend->physicalDevice;
@@ -132,52 +157,92 @@ void vpp::Application::init_window()
 
 }
 
+// Borderless on the primary monitor at its current mode, the framebuffer callback then recreates the swapchain
+void vpp::Application::toggleFullscreen()
+{
+    if (glfwGetWindowMonitor(backend->window) != nullptr)
+    {
+        glfwSetWindowMonitor(backend->window, nullptr, windowedRect[0], windowedRect[1], windowedRect[2], windowedRect[3], GLFW_DONT_CARE);
+        return;
+    }
+
+    glfwGetWindowPos(backend->window, &windowedRect[0], &windowedRect[1]);
+    glfwGetWindowSize(backend->window, &windowedRect[2], &windowedRect[3]);
+
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+    glfwSetWindowMonitor(backend->window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
+}
+
 void vpp::Application::main_loop()
 {
-    while (!glfwWindowShouldClose(backend->window))
+    VPP_PROFILE_THREAD("Main");
+
+    while (!quitRequested && (headless.enabled ? frameContexts->getCurrentFrameNumber() < headless.frameCount : !glfwWindowShouldClose(backend->window)))
     {
-        currentFrameTime = glfwGetTime();
-        deltaTime = currentFrameTime - lastFrameTime;
-        lastFrameTime = currentFrameTime;
+        VPP_PROFILE_SCOPE("Frame");
 
-        glfwPollEvents();
+        // In low latency mode input is sampled only once nothing left can block, otherwise first
+        bool lowLatency = framePacer->settings.lowLatency;
+        framePacer->waitForPreviousFrame();
+        if (!lowLatency)
+        {
+            sampleInput();
+        }
 
-        vkWaitForFences(backend->device, 1, &backend->inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        FrameContext* frame;
+        {
+            VPP_PROFILE_SCOPE("Wait for frame context");
+            frame = &frameContexts->beginFrame();
+        }
+        currentFrame = frame->index;
+        renderTargets->collect(frameContexts->getCompletedFrameNumber());
+        framePacer->update();
+
+        // Offscreen images are owned one per frame context, so the wait above already guards them
+        uint32_t imageIndex = currentFrame;
+        VkResult result = VK_SUCCESS;
+        if (!headless.enabled)
+        {
+            VPP_PROFILE_SCOPE("vkAcquireNextImageKHR");
+            result = vkAcquireNextImageKHR(backend->device, backend->swapChain, UINT64_MAX, frame->imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+        }
 
-        uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(backend->device, backend->swapChain, UINT64_MAX, backend->imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        if (lowLatency)
+        {
+            sampleInput();
+        }
 
+        // The frame was begun but is never submitted, the next one takes its place on the timeline
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             recreateSwapChain();
-            return;
+            continue;
         }
         else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
             throw std::runtime_error("failed to acquire swap chain image!");
         }
 
-        // Only reset the fence if we are submitting work
-        vkResetFences(backend->device, 1, &backend->inFlightFences[currentFrame]);
+        vkResetCommandBuffer(frame->commandBuffer, 0);
+        uniformAllocator->beginFrame(currentFrame, frameContexts->getCurrentFrameNumber());
 
-        vkResetCommandBuffer(backend->commandBuffers[currentFrame], 0);
-
-        main_loop_extended(currentFrame, imageIndex);
+        {
+            VPP_PROFILE_SCOPE("main_loop_extended");
+            main_loop_extended(currentFrame, imageIndex);
+        }
 
-        VkSemaphore signalSemaphores[] = { backend->renderFinishedSemaphores[currentFrame]};
-        VkSemaphore waitSemaphores[] = { backend->imageAvailableSemaphores[currentFrame]};
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+        VPP_PROFILE_SCOPE("Submit and present");
 
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &backend->commandBuffers[currentFrame];
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;    
+        frameContexts->submit(backend->graphicsQueue, headless.enabled ? VK_NULL_HANDLE : frame->imageAvailableSemaphore, imageAvailableWaitStages, !headless.enabled);
+        framePacer->frameSubmitted(frameContexts->getCurrentFrameNumber());
 
-        if (vkQueueSubmit(backend->graphicsQueue, 1, &submitInfo, backend->inFlightFences[currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
+        if (headless.enabled)
+        {
+            uint64_t frameNumber = frameContexts->getCurrentFrameNumber();
+            if (headless.dumpInterval > 0 && frameNumber % headless.dumpInterval == 0)
+            {
+                dumpFrame(imageIndex, headless.dumpDirectory + "/frame_" + std::to_string(frameNumber) + ".png");
+            }
+            continue;
         }
 
         VkSwapchainKHR swapChains[] = { backend->swapChain };
@@ -185,7 +250,7 @@ void vpp::Application::main_loop()
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores; 
+        presentInfo.pWaitSemaphores = &frame->renderFinishedSemaphore;
         presentInfo.swapchainCount = 1;
         presentInfo.pSwapchains = swapChains;
         presentInfo.pImageIndices = &imageIndex;
@@ -200,32 +265,67 @@ void vpp::Application::main_loop()
         else if (result != VK_SUCCESS) {
             throw std::runtime_error("failed to present swap chain image!");
         }
-
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
     }
 
     vkDeviceWaitIdle(backend->device);
 }
 
+void vpp::Application::sampleInput()
+{
+    if (headless.enabled)
+    {
+        deltaTime = headless.fixedDeltaTime;
+    }
+    else
+    {
+        currentFrameTime = glfwGetTime();
+        deltaTime = currentFrameTime - lastFrameTime;
+        lastFrameTime = currentFrameTime;
+
+        VPP_PROFILE_SCOPE("glfwPollEvents");
+        glfwPollEvents();
+    }
+
+    framePacer->sampleInput();
+}
+
+void vpp::Application::setFramePacing(FramePacingSettings settings)
+{
+    bool swapChainChanged = settings.presentMode != framePacer->settings.presentMode || settings.swapChainImageCount != framePacer->settings.swapChainImageCount;
+    framePacer->settings = settings;
+
+    if (swapChainChanged)
+    {
+        framebufferResized = true;
+    }
+}
+
 void vpp::Application::cleanup()
 {
     vkDeviceWaitIdle(backend->device);
 
+    renderTargets.reset();
+
     cleanup_extended();
 
     cleanupSwapChain();
 
     ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if (!headless.enabled)
+    {
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui::DestroyContext();
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(backend->device, backend->renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(backend->device, backend->imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(backend->device, backend->inFlightFences[i], nullptr);
-    }
+    uniformAllocator.reset();
+    framePacer.reset();
+    frameContexts.reset();
 
     vkDestroyCommandPool(backend->device, backend->commandPool, nullptr);
+    if (backend->computeCommandPool != VK_NULL_HANDLE)
+    {
+        vkDestroyCommandPool(backend->device, backend->computeCommandPool, nullptr);
+    }
 
     vkDestroyDescriptorPool(backend->device, backend->descriptorPool, nullptr);
 
@@ -235,6 +335,12 @@ void vpp::Application::cleanup()
         DestroyDebugUtilsMessengerEXT(backend->instance, backend->debugMessenger, nullptr);
     }
 
+    if (headless.enabled)
+    {
+        vkDestroyInstance(backend->instance, nullptr);
+        return;
+    }
+
     vkDestroySurfaceKHR(backend->instance, backend->surface, nullptr);
 
     vkDestroyInstance(backend->instance, nullptr);
@@ -342,12 +448,17 @@ bool vpp::Application::checkValidationLayerSupport() {
 
 std::vector<const char*> vpp::Application::getRequiredExtensions() 
 {
+    std::vector<const char*> extensions;
+
     // Get required GLFW extensions
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    if (!headless.enabled)
+    {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -389,9 +500,20 @@ void vpp::Application::pickPhysicalDevice()
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(backend->instance, &deviceCount, devices.data());
 
+    // Prefer a discrete GPU, otherwise take the first suitable device, e.g. lavapipe on CI
     for (const auto& device : devices) {
-        if (isDeviceSuitable(device)) {
+        if (!isDeviceSuitable(device)) {
+            continue;
+        }
+
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+        if (backend->physicalDevice == VK_NULL_HANDLE || deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
             backend->physicalDevice = device;
+        }
+
+        if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
             break;
         }
     }
@@ -411,13 +533,36 @@ bool vpp::Application::isDeviceSuitable(VkPhysicalDevice device)
     QueueFamilyIndices indices = findQueueFamilies(device);
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    bool swapChainAdequate = headless.enabled;
+    if (extensionsSupported && !headless.enabled) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
 
-    return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && indices.isComplete() && extensionsSupported && swapChainAdequate;
+    // The luminance histogram merges atomics with subgroup ballots
+    VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+    subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 deviceProperties2{};
+    deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    deviceProperties2.pNext = &subgroupProperties;
+    vkGetPhysicalDeviceProperties2(device, &deviceProperties2);
+
+    bool subgroupBallotSupported = (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) && (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_BALLOT_BIT);
+
+    // The bindless heap is partially bound and written while frames are in flight
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+
+    bool bindlessSupported = vulkan12Features.runtimeDescriptorArray && vulkan12Features.descriptorBindingPartiallyBound && vulkan12Features.descriptorBindingVariableDescriptorCount &&
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind && vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind && vulkan12Features.descriptorBindingUpdateUnusedWhilePending;
+
+    return indices.isComplete() && extensionsSupported && swapChainAdequate && deviceFeatures.shaderStorageImageWriteWithoutFormat && subgroupBallotSupported && bindlessSupported;
 }
 
 vpp::QueueFamilyIndices vpp::Application::findQueueFamilies(VkPhysicalDevice device) 
@@ -434,7 +579,9 @@ vpp::QueueFamilyIndices vpp::Application::findQueueFamilies(VkPhysicalDevice dev
     for (const auto& queueFamily : queueFamilies) 
     {
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, backend->surface, &presentSupport);
+        if (!headless.enabled) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, backend->surface, &presentSupport);
+        }
         if (presentSupport) {
             indices.presentFamily = i;
         }
@@ -442,6 +589,11 @@ vpp::QueueFamilyIndices vpp::Application::findQueueFamilies(VkPhysicalDevice dev
         if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) 
         {
             indices.graphicsFamily = i;
+
+            // Nothing is presented, the graphics queue stands in for the present queue
+            if (headless.enabled) {
+                indices.presentFamily = i;
+            }
         }
 
         if (indices.isComplete()) 
@@ -452,41 +604,105 @@ vpp::QueueFamilyIndices vpp::Application::findQueueFamilies(VkPhysicalDevice dev
         i++;
     }
 
+    // Families without graphics are the dedicated async compute queues, timestamps are needed for the profiler
+    for (uint32_t j = 0; j < queueFamilyCount; j++)
+    {
+        if ((queueFamilies[j].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamilies[j].queueFlags & VK_QUEUE_GRAPHICS_BIT) && queueFamilies[j].timestampValidBits > 0)
+        {
+            indices.computeFamily = j;
+            indices.computeQueueIndex = 0;
+            break;
+        }
+    }
+
+    if (!indices.computeFamily.has_value() && indices.graphicsFamily.has_value() && queueFamilies[indices.graphicsFamily.value()].queueCount > 1)
+    {
+        indices.computeFamily = indices.graphicsFamily;
+        indices.computeQueueIndex = 1;
+    }
+
     return indices;
 }
 
 void vpp::Application::createLogicalDevice()
 {
     QueueFamilyIndices indices = findQueueFamilies(backend->physicalDevice);
-    float queuePriority = 1.0f;
+    float queuePriorities[] = { 1.0f, 1.0f };
 
-    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    // Family -> number of queues, the async compute queue can be the graphics family's second one
+    std::map<uint32_t, uint32_t> queueCounts = { { indices.graphicsFamily.value(), 1 } };
+    queueCounts[indices.presentFamily.value()] = std::max(queueCounts[indices.presentFamily.value()], 1u);
+    if (indices.computeFamily.has_value())
+    {
+        queueCounts[indices.computeFamily.value()] = std::max(queueCounts[indices.computeFamily.value()], indices.computeQueueIndex + 1);
+    }
 
-    for (uint32_t queueFamily : uniqueQueueFamilies) {
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    for (auto [queueFamily, queueCount] : queueCounts) {
         VkDeviceQueueCreateInfo queueCreateInfo{};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = queueFamily;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfo.queueCount = queueCount;
+        queueCreateInfo.pQueuePriorities = queuePriorities;
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceVulkan12Features supportedVulkan12Features{};
+    supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 supportedFeatures{};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &supportedVulkan12Features;
+    vkGetPhysicalDeviceFeatures2(backend->physicalDevice, &supportedFeatures);
+
+    backend->shaderFloat16Supported = supportedVulkan12Features.shaderFloat16 == VK_TRUE;
+    backend->textureCompressionBCSupported = supportedFeatures.features.textureCompressionBC == VK_TRUE;
+
     VkPhysicalDeviceVulkan12Features vulkan12Features{};
     vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
     vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+    vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+    vulkan12Features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+    vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+    vulkan12Features.shaderFloat16 = supportedVulkan12Features.shaderFloat16;
+
+    // The render graph records its barriers with vkCmdPipelineBarrier2
+    VkPhysicalDeviceVulkan13Features vulkan13Features{};
+    vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    vulkan13Features.synchronization2 = VK_TRUE;
+    vulkan12Features.pNext = &vulkan13Features;
 
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
+    deviceFeatures.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+    deviceFeatures.textureCompressionBC = supportedFeatures.features.textureCompressionBC;
+
+    // Optional, the memory tracker falls back to its own allocations for heap usage
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(backend->physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(backend->physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+    bool memoryBudgetSupported = std::any_of(availableExtensions.begin(), availableExtensions.end(),
+        [](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0; });
+
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+    if (memoryBudgetSupported)
+    {
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
     createInfo.pNext = &vulkan12Features;
 
     if (enableValidationLayers) {
@@ -501,8 +717,22 @@ void vpp::Application::createLogicalDevice()
         throw std::runtime_error("failed to create logical device!");
     }
 
+    backend->memoryTracker = std::make_shared<vpp::MemoryTracker>(backend->physicalDevice, memoryBudgetSupported);
+
     vkGetDeviceQueue(backend->device, indices.graphicsFamily.value(), 0, &backend->graphicsQueue);
     vkGetDeviceQueue(backend->device, indices.presentFamily.value(), 0, &backend->presentQueue);
+    backend->graphicsQueueFamily = indices.graphicsFamily.value();
+
+    if (indices.computeFamily.has_value())
+    {
+        vkGetDeviceQueue(backend->device, indices.computeFamily.value(), indices.computeQueueIndex, &backend->computeQueue);
+        backend->computeQueueFamily = indices.computeFamily.value();
+
+        if (backend->computeQueueFamily != backend->graphicsQueueFamily)
+        {
+            backend->sharedQueueFamilies = { backend->graphicsQueueFamily, backend->computeQueueFamily };
+        }
+    }
 }
 
 void vpp::Application::createSurface()
@@ -565,8 +795,9 @@ VkSurfaceFormatKHR vpp::Application::chooseSwapSurfaceFormat(const std::vector<V
 
 VkPresentModeKHR vpp::Application::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) 
 {
+    // FIFO is the only mode every surface has to support
     for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+        if (availablePresentMode == framePacer->settings.presentMode) {
             return availablePresentMode;
         }
     }
@@ -597,13 +828,28 @@ VkExtent2D vpp::Application::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& ca
 
 void vpp::Application::createSwapChain() 
 {
+    if (headless.enabled)
+    {
+        createOffscreenImages();
+        return;
+    }
+
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(backend->physicalDevice);
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+    availablePresentModes = swapChainSupport.presentModes;
+    presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
     VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-    backend->imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    // A finished frame waits on average half a refresh for the vblank, unless presents don't wait for it at all
+    GLFWmonitor* monitor = glfwGetWindowMonitor(backend->window) ? glfwGetWindowMonitor(backend->window) : glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+    bool vsync = presentMode != VK_PRESENT_MODE_IMMEDIATE_KHR && presentMode != VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    framePacer->setPresentDelay(vsync && mode && mode->refreshRate > 0 ? 500.0 / mode->refreshRate : 0.0);
+
+    // More images let the CPU queue further ahead, which is throughput bought with latency
+    uint32_t requestedImageCount = framePacer->settings.swapChainImageCount;
+    backend->imageCount = requestedImageCount > 0 ? std::max(requestedImageCount, swapChainSupport.capabilities.minImageCount) : swapChainSupport.capabilities.minImageCount + 1;
 
     if (swapChainSupport.capabilities.maxImageCount > 0 && backend->imageCount > swapChainSupport.capabilities.maxImageCount) // 0 means no maximum
     {
@@ -620,6 +866,32 @@ void vpp::Application::createSwapChain()
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+    // A storage capable UNORM swapchain lets compute passes write the final image directly
+    backend->swapChainStorageSupported = false;
+    if (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT)
+    {
+        for (const auto& availableFormat : swapChainSupport.formats)
+        {
+            if ((availableFormat.format != VK_FORMAT_B8G8R8A8_UNORM && availableFormat.format != VK_FORMAT_R8G8B8A8_UNORM) || availableFormat.colorSpace != VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+            {
+                continue;
+            }
+
+            VkFormatProperties formatProperties;
+            vkGetPhysicalDeviceFormatProperties(backend->physicalDevice, availableFormat.format, &formatProperties);
+
+            if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)
+            {
+                surfaceFormat = availableFormat;
+                createInfo.imageFormat = surfaceFormat.format;
+                createInfo.imageColorSpace = surfaceFormat.colorSpace;
+                createInfo.imageUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+                backend->swapChainStorageSupported = true;
+                break;
+            }
+        }
+    }
+
     QueueFamilyIndices indices = findQueueFamilies(backend->physicalDevice);
     uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
@@ -638,12 +910,22 @@ void vpp::Application::createSwapChain()
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // Handing the old swapchain over lets the presentation engine reuse its resources, frames in flight still present from it
+    VkSwapchainKHR oldSwapChain = backend->swapChain;
+    createInfo.oldSwapchain = oldSwapChain;
 
     if (vkCreateSwapchainKHR(backend->device, &createInfo, nullptr, &backend->swapChain) != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain!");
     }
 
+    if (oldSwapChain != VK_NULL_HANDLE)
+    {
+        VkDevice device = backend->device;
+        renderTargets->retire([device, oldSwapChain]() {
+            vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+        });
+    }
+
     vkGetSwapchainImagesKHR(backend->device, backend->swapChain, &backend->imageCount, nullptr);
     backend->swapChainImages.resize(backend->imageCount);
     vkGetSwapchainImagesKHR(backend->device, backend->swapChain, &backend->imageCount, backend->swapChainImages.data());
@@ -679,6 +961,15 @@ void vpp::Application::createCommandPool()
     if (vkCreateCommandPool(backend->device, &poolInfo, nullptr, &backend->commandPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
     }
+
+    if (backend->computeQueue != VK_NULL_HANDLE)
+    {
+        poolInfo.queueFamilyIndex = backend->computeQueueFamily;
+
+        if (vkCreateCommandPool(backend->device, &poolInfo, nullptr, &backend->computeCommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute command pool!");
+        }
+    }
 }
 
 void vpp::Application::createCommandBuffers()
@@ -710,43 +1001,54 @@ void vpp::Application::beginCommandBuffer()
 
 void vpp::Application::createSyncObjects()
 {
-    backend->imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    backend->renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    backend->inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-
-    VkSemaphoreCreateInfo semaphoreInfo{};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateSemaphore(backend->device, &semaphoreInfo, nullptr, &backend->imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(backend->device, &semaphoreInfo, nullptr, &backend->renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(backend->device, &fenceInfo, nullptr, &backend->inFlightFences[i]) != VK_SUCCESS) {
+    frameContexts = std::make_shared<FrameContexts>(backend, MAX_FRAMES_IN_FLIGHT, DEFAULT_FRAMES_IN_FLIGHT);
+    uniformAllocator = std::make_shared<UniformAllocator>(backend, frameContexts, UNIFORM_ALLOCATOR_REGION_SIZE);
+    framePacer = std::make_shared<FramePacer>(frameContexts);
+}
 
-            throw std::runtime_error("failed to create synchronization objects for a frame!");
-        }
-    }
+void vpp::Application::createRenderTargets()
+{
+    renderTargets = std::make_shared<RenderTargets>(backend, frameContexts, backend->swapChainExtent);
+    renderTargets->addResizeCallback("Depth image", [this](VkExtent2D extent) {
+        renderTargets->retire(backend->depthImage, backend->depthImageView);
+        createDepthResources();
+    });
 }
 
+// Nothing waits for the device, whatever frames in flight still use is retired and destroyed once they finish
 void vpp::Application::recreateSwapChain() {
+    VPP_PROFILE_FUNCTION();
 
+    // A minimized window has nothing to present to
     int width = 0, height = 0;
+    glfwGetFramebufferSize(backend->window, &width, &height);
     while (width == 0 || height == 0) {
-        glfwGetFramebufferSize(backend->window, &width, &height);
         glfwWaitEvents();
+        glfwGetFramebufferSize(backend->window, &width, &height);
     }
 
-    vkDeviceWaitIdle(backend->device);
-
-    cleanupSwapChain();
+    for (size_t i = 0; i < backend->swapChainImageViews.size(); i++)
+    {
+        renderTargets->retire(backend->swapChainImageViews[i]);
+    }
+    std::vector<VkFramebuffer> framebuffers = backend->swapChainFramebuffers;
+    VkDevice device = backend->device;
+    renderTargets->retire([device, framebuffers]() {
+        for (VkFramebuffer framebuffer : framebuffers)
+        {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+    });
 
     createSwapChain();
     createImageViews();
-    createDepthResources();
+
+    // Only the targets sized by the window, a swapchain recreated at the same size keeps them
+    renderTargets->resize(backend->swapChainExtent);
+
     createSwapChainFramebuffers();
+
+    recreateSwapChain_extended();
 }
 
 void vpp::Application::cleanupSwapChain()
@@ -762,7 +1064,13 @@ void vpp::Application::cleanupSwapChain()
         backend->swapChainImageViews[i].reset();
     }
 
-    vkDestroySwapchainKHR(backend->device, backend->swapChain, nullptr);
+    backend->offscreenImages.clear();
+
+    if (backend->swapChain != VK_NULL_HANDLE)
+    {
+        vkDestroySwapchainKHR(backend->device, backend->swapChain, nullptr);
+        backend->swapChain = VK_NULL_HANDLE;
+    }
 }
 
 void vpp::Application::createSwapChainFramebuffers()
@@ -800,7 +1108,7 @@ void vpp::Application::createSwapChainRenderPass()
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.finalLayout = backend->swapChainFinalLayout;
 
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format = VK_FORMAT_D32_SFLOAT;
@@ -851,11 +1159,19 @@ void vpp::Application::createSwapChainRenderPass()
 
 void vpp::Application::createDescriptorPool()
 {
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    std::array<VkDescriptorPoolSize, 6> poolSizes{};
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     poolSizes[0].descriptorCount = static_cast<uint32_t>(1000);
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[1].descriptorCount = static_cast<uint32_t>(1000);
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[2].descriptorCount = static_cast<uint32_t>(1000);
+    poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[3].descriptorCount = static_cast<uint32_t>(1000);
+    poolSizes[4].type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    poolSizes[4].descriptorCount = static_cast<uint32_t>(100);
+    poolSizes[5].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[5].descriptorCount = static_cast<uint32_t>(100);
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -873,4 +1189,112 @@ void vpp::Application::createDepthResources()
 {
     backend->depthImage = std::make_shared<vpp::Image>(backend, backend->swapChainExtent.width, backend->swapChainExtent.height, 1, 1, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Swapchain depth image");
     backend->depthImageView = std::make_shared<ImageView>(backend, backend->depthImage, 0, 1, VK_IMAGE_ASPECT_DEPTH_BIT, "Swapchain depth image view");
-}
\ No newline at end of file
+}
+
+// Stands in for the swapchain: one image per frame in flight at the requested size
+void vpp::Application::createOffscreenImages()
+{
+    VkExtent2D extent = { WIDTH, HEIGHT };
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+    // Same rule as the swapchain path, a storage capable UNORM image lets compute write the final image
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(backend->physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+    backend->swapChainStorageSupported = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+    if (backend->swapChainStorageSupported)
+    {
+        format = VK_FORMAT_R8G8B8A8_UNORM;
+        usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    }
+
+    backend->imageCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    backend->offscreenImages.clear();
+    backend->swapChainImages.clear();
+
+    for (uint32_t i = 0; i < backend->imageCount; i++)
+    {
+        std::shared_ptr<Image> image = std::make_shared<Image>(backend, extent.width, extent.height, 1, 1, format, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Offscreen Image " + std::to_string(i));
+        backend->offscreenImages.push_back(image);
+        backend->swapChainImages.push_back(image->image);
+    }
+
+    backend->swapChainImageFormat = format;
+    backend->swapChainExtent = extent;
+}
+
+// Blocks until the copy is done, only meant for occasional captures
+void vpp::Application::dumpFrame(uint32_t imageIndex, const std::string& path)
+{
+    VPP_PROFILE_FUNCTION();
+
+    uint32_t width = backend->swapChainExtent.width;
+    uint32_t height = backend->swapChainExtent.height;
+
+    Buffer readbackBuffer(backend, static_cast<VkDeviceSize>(width) * height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT, CONTINOUS_TRANSFER, nullptr, "Frame dump readback buffer");
+
+    VkCommandBuffer commandBuffer = backend->beginSingleTimeCommands();
+
+    // The frame was submitted earlier on the same queue, make its final writes visible to the copy
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = backend->swapChainImages[imageIndex];
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { width, height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, backend->swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer.buffer, 1, &region);
+
+    backend->endSingleTimeCommands(commandBuffer);
+
+    // Offscreen images are RGBA, the alpha written by the passes isn't meaningful
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+    memcpy(pixels.data(), readbackBuffer.mappedPtr, pixels.size());
+    for (size_t i = 3; i < pixels.size(); i += 4)
+    {
+        pixels[i] = 255;
+    }
+
+    std::filesystem::path outputPath(path);
+    if (outputPath.has_parent_path())
+    {
+        std::filesystem::create_directories(outputPath.parent_path());
+    }
+
+    if (!stbi_write_png(path.c_str(), static_cast<int>(width), static_cast<int>(height), 4, pixels.data(), static_cast<int>(width) * 4))
+    {
+        throw std::runtime_error("failed to write frame dump " + path + "!");
+    }
+}
+
+void vpp::Application::newImGuiFrame()
+{
+    ImGui_ImplVulkan_NewFrame();
+
+    if (headless.enabled)
+    {
+        io->DisplaySize = ImVec2(static_cast<float>(backend->swapChainExtent.width), static_cast<float>(backend->swapChainExtent.height));
+        io->DeltaTime = static_cast<float>(deltaTime);
+    }
+    else
+    {
+        ImGui_ImplGlfw_NewFrame();
+    }
+
+    ImGui::NewFrame();
+}
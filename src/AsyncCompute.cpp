@@ -0,0 +1,119 @@
+#include "AsyncCompute.h"
+
+#include <stdexcept>
+
+vpp::AsyncCompute::AsyncCompute(std::shared_ptr<Backend> backend, uint32_t maxFramesInFlight) :
+    backend(backend)
+{
+    if (!isSupported(backend))
+    {
+        throw std::runtime_error("async compute needs a compute queue!");
+    }
+
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+
+    const char* names[] = { "Async compute::Graphics timeline", "Async compute::Compute timeline" };
+    VkCommandPool pools[] = { backend->commandPool, backend->computeCommandPool };
+
+    for (uint32_t queue = 0; queue < 2; queue++)
+    {
+        if (vkCreateSemaphore(backend->device, &semaphoreInfo, nullptr, &timelineSemaphores[queue]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create async compute timeline semaphore!");
+        }
+        backend->setNameOfObject(VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)timelineSemaphores[queue], names[queue]);
+
+        commandBuffers[queue].resize(maxFramesInFlight * MAX_BATCHES);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = pools[queue];
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers[queue].size());
+
+        if (vkAllocateCommandBuffers(backend->device, &allocInfo, commandBuffers[queue].data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate async compute command buffers!");
+        }
+    }
+
+    backend->computeCommandBuffers = commandBuffers[COMPUTE_QUEUE];
+}
+
+vpp::AsyncCompute::~AsyncCompute()
+{
+    vkFreeCommandBuffers(backend->device, backend->commandPool, static_cast<uint32_t>(commandBuffers[GRAPHICS_QUEUE].size()), commandBuffers[GRAPHICS_QUEUE].data());
+    vkFreeCommandBuffers(backend->device, backend->computeCommandPool, static_cast<uint32_t>(commandBuffers[COMPUTE_QUEUE].size()), commandBuffers[COMPUTE_QUEUE].data());
+    backend->computeCommandBuffers.clear();
+
+    for (VkSemaphore semaphore : timelineSemaphores)
+    {
+        vkDestroySemaphore(backend->device, semaphore, nullptr);
+    }
+}
+
+VkCommandBuffer vpp::AsyncCompute::begin(QueueType queue, uint32_t frameIndex, uint32_t batch)
+{
+    VkCommandBuffer commandBuffer = commandBuffers[queue][frameIndex * MAX_BATCHES + batch];
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording async compute command buffer!");
+    }
+
+    return commandBuffer;
+}
+
+uint64_t vpp::AsyncCompute::submit(QueueType queue, VkCommandBuffer commandBuffer, const std::vector<SemaphoreWait>& waits)
+{
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record async compute command buffer!");
+    }
+
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStages;
+    for (const SemaphoreWait& wait : waits)
+    {
+        waitSemaphores.push_back(wait.semaphore);
+        waitValues.push_back(wait.value);
+        waitStages.push_back(wait.stage);
+    }
+
+    uint64_t signalValue = submittedValues[queue] + 1;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timelineSemaphores[queue];
+
+    VkQueue vkQueue = queue == COMPUTE_QUEUE ? backend->computeQueue : backend->graphicsQueue;
+    if (vkQueueSubmit(vkQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit async compute batch!");
+    }
+
+    submittedValues[queue] = signalValue;
+    return signalValue;
+}
@@ -2,6 +2,7 @@
 #include <stdexcept>
 #include <cmath>
 #include <iostream>
+#include <algorithm>
 
 VkCommandBuffer vpp::Backend::beginSingleTimeCommands()
 {
@@ -52,6 +53,45 @@ uint32_t vpp::Backend::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags
     throw std::runtime_error("failed to find suitable memory type!");
 }
 
+VkResult vpp::Backend::allocateMemory(const VkMemoryAllocateInfo& allocInfo, VkDeviceMemory& memory, MemoryCategory category, const std::string& name)
+{
+    VkResult result = vkAllocateMemory(device, &allocInfo, nullptr, &memory);
+    if (result == VK_SUCCESS && memoryTracker)
+    {
+        memoryTracker->allocated(memory, allocInfo.allocationSize, allocInfo.memoryTypeIndex, category, name);
+    }
+
+    return result;
+}
+
+void vpp::Backend::freeMemory(VkDeviceMemory memory)
+{
+    if (memory == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    if (memoryTracker)
+    {
+        memoryTracker->freed(memory);
+    }
+    vkFreeMemory(device, memory, nullptr);
+}
+
+bool vpp::Backend::hasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 VkShaderModule vpp::Backend::createShaderModule(const std::vector<char>& code)
 {
     VkShaderModuleCreateInfo createInfo{};
@@ -67,6 +107,34 @@ VkShaderModule vpp::Backend::createShaderModule(const std::vector<char>& code)
     return shaderModule;
 }
 
+void vpp::Backend::setSharingMode(VkSharingMode& sharingMode, uint32_t& queueFamilyIndexCount, const uint32_t*& queueFamilyIndices)
+{
+    if (sharedQueueFamilies.empty())
+    {
+        sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        return;
+    }
+
+    sharingMode = VK_SHARING_MODE_CONCURRENT;
+    queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+    queueFamilyIndices = sharedQueueFamilies.data();
+}
+
+// Barriers recorded for the compute queue can't name graphics stages. Work on the graphics queue is
+// ordered by semaphores anyway, so only the compute side of the dependency is kept.
+VkPipelineStageFlags vpp::Backend::supportedStages(VkCommandBuffer commandBuffer, VkPipelineStageFlags stages)
+{
+    if (std::find(computeCommandBuffers.begin(), computeCommandBuffers.end(), commandBuffer) == computeCommandBuffers.end())
+    {
+        return stages;
+    }
+
+    VkPipelineStageFlags computeStages = stages & (VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+    return computeStages != 0 ? computeStages : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+}
+
 vpp::TextureImageCreationResults vpp::Backend::createTextureImage(std::string path, uint32_t* mipLevels)
 {
     int texWidth, texHeight, texChannels;
@@ -169,7 +237,7 @@ vpp::Buffer::Buffer(std::shared_ptr<vpp::Backend> backend, VkDeviceSize size, Vk
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
         bufferInfo.usage = usage;
-        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        backend->setSharingMode(bufferInfo.sharingMode, bufferInfo.queueFamilyIndexCount, bufferInfo.pQueueFamilyIndices);
 
         if (vkCreateBuffer(backend->device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to create buffer!");
@@ -184,21 +252,21 @@ vpp::Buffer::Buffer(std::shared_ptr<vpp::Backend> backend, VkDeviceSize size, Vk
 
         allocInfo.memoryTypeIndex = backend->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-        if (vkAllocateMemory(backend->device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+        if (backend->allocateMemory(allocInfo, bufferMemory, bufferMemoryCategory(usage, type), name) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate buffer memory!");
         }
 
         vkBindBufferMemory(backend->device, buffer, bufferMemory, 0);
     }
 
-    else if (type == CONTINOUS_TRANSFER)
+    else if (type == CONTINOUS_TRANSFER || type == MAPPED_DEVICE_LOCAL)
     {
         
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
         bufferInfo.usage = usage;
-        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        backend->setSharingMode(bufferInfo.sharingMode, bufferInfo.queueFamilyIndexCount, bufferInfo.pQueueFamilyIndices);
 
         if (vkCreateBuffer(backend->device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to create buffer!");
@@ -211,9 +279,14 @@ vpp::Buffer::Buffer(std::shared_ptr<vpp::Backend> backend, VkDeviceSize size, Vk
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = memRequirements.size;
 
-        allocInfo.memoryTypeIndex = backend->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if (type == MAPPED_DEVICE_LOCAL && backend->hasMemoryType(memRequirements.memoryTypeBits, memoryProperties | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+        {
+            memoryProperties |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        }
+        allocInfo.memoryTypeIndex = backend->findMemoryType(memRequirements.memoryTypeBits, memoryProperties);
 
-        if (vkAllocateMemory(backend->device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+        if (backend->allocateMemory(allocInfo, bufferMemory, bufferMemoryCategory(usage, type), name) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate buffer memory!");
         }
 
@@ -231,7 +304,7 @@ vpp::Buffer::Buffer(std::shared_ptr<vpp::Backend> backend, VkDeviceSize size, Vk
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
         bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        backend->setSharingMode(bufferInfo.sharingMode, bufferInfo.queueFamilyIndexCount, bufferInfo.pQueueFamilyIndices);
 
         if (vkCreateBuffer(backend->device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to create buffer!");
@@ -246,7 +319,7 @@ vpp::Buffer::Buffer(std::shared_ptr<vpp::Backend> backend, VkDeviceSize size, Vk
 
         allocInfo.memoryTypeIndex = backend->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-        if (vkAllocateMemory(backend->device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+        if (backend->allocateMemory(allocInfo, bufferMemory, bufferMemoryCategory(usage, type), name) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate buffer memory!");
         }
 
@@ -258,6 +331,21 @@ vpp::Buffer::Buffer(std::shared_ptr<vpp::Backend> backend, VkDeviceSize size, Vk
     backend->setNameOfObject(VK_OBJECT_TYPE_BUFFER, (uint64_t)buffer, name);
 }
 
+static VkImageAspectFlags getAspectMask(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
 void vpp::Backend::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
@@ -269,7 +357,7 @@ void vpp::Backend::transitionImageLayout(VkImage image, VkFormat format, VkImage
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.image = image;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.aspectMask = getAspectMask(format);
 	barrier.subresourceRange.baseMipLevel = 0;
 	barrier.subresourceRange.levelCount = mipLevels;
 	barrier.subresourceRange.baseArrayLayer = 0;
@@ -299,7 +387,7 @@ void vpp::Backend::transitionImageLayout(VkCommandBuffer commandBuffer, VkImage
     barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.aspectMask = getAspectMask(format);
     barrier.subresourceRange.baseMipLevel = 0;
     barrier.subresourceRange.levelCount = mipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
@@ -320,17 +408,35 @@ void vpp::Backend::transitionImageLayout(VkCommandBuffer commandBuffer, VkImage
 
 vpp::Buffer::~Buffer()
 {
-    if (type == CONTINOUS_TRANSFER)
+    if (type == CONTINOUS_TRANSFER || type == MAPPED_DEVICE_LOCAL)
     {
 		vkUnmapMemory(backend->device, bufferMemory);
 	}
 
 	vkDestroyBuffer(backend->device, buffer, nullptr);
-	vkFreeMemory(backend->device, bufferMemory, nullptr);
+	backend->freeMemory(bufferMemory);
 }
 
 vpp::Image::Image(std::shared_ptr<Backend> backend, uint32_t width, uint32_t height, uint32_t depth, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, std::string name):
-    backend(backend), width(width), height(height), depth(depth), mipLevels(mipLevels), format(format), imageType(depth == 1 ? VK_IMAGE_TYPE_2D : VK_IMAGE_TYPE_3D)
+    Image(backend, width, height, depth, mipLevels, format, usage, name)
+{
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(backend->device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = backend->findMemoryType(memRequirements.memoryTypeBits, properties);
+
+    if (backend->allocateMemory(allocInfo, imageMemory, imageMemoryCategory(usage), name) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate image memory!");
+    }
+
+    vkBindImageMemory(backend->device, image, imageMemory, 0);
+}
+
+vpp::Image::Image(std::shared_ptr<Backend> backend, uint32_t width, uint32_t height, uint32_t depth, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, std::string name):
+    backend(backend), imageMemory(VK_NULL_HANDLE), width(width), height(height), depth(depth), mipLevels(mipLevels), format(format), imageType(depth == 1 ? VK_IMAGE_TYPE_2D : VK_IMAGE_TYPE_3D)
 {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -345,33 +451,19 @@ vpp::Image::Image(std::shared_ptr<Backend> backend, uint32_t width, uint32_t hei
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = usage;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    backend->setSharingMode(imageInfo.sharingMode, imageInfo.queueFamilyIndexCount, imageInfo.pQueueFamilyIndices);
 
     if (vkCreateImage(backend->device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
         throw std::runtime_error("failed to create image!");
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(backend->device, image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = backend->findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(backend->device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
-
-    vkBindImageMemory(backend->device, image, imageMemory, 0);
-
     backend->setNameOfObject(VK_OBJECT_TYPE_IMAGE, (uint64_t)image, name);
 }
 
 vpp::Image::~Image()
 {
 	vkDestroyImage(backend->device, image, nullptr);
-	vkFreeMemory(backend->device, imageMemory, nullptr);
+	backend->freeMemory(imageMemory);
 }
 
 void vpp::Image::generateMipMaps()
@@ -449,7 +541,7 @@ void vpp::Image::transitionLayout(VkCommandBuffer commandBuffer, VkImageLayout o
 	backend->transitionImageLayout(commandBuffer, image, format, oldLayout, newLayout, mipLevels);
 }
 
-vpp::ImageView::ImageView(std::shared_ptr<Backend> backend, std::shared_ptr<Image> image, uint32_t baseMipLevel, uint32_t mipLevels, VkImageAspectFlagBits aspectFlags, std::string name)
+vpp::ImageView::ImageView(std::shared_ptr<Backend> backend, std::shared_ptr<Image> image, uint32_t baseMipLevel, uint32_t mipLevels, VkImageAspectFlagBits aspectFlags, std::string name, VkComponentMapping components)
     : backend(backend)
 {
     VkImageViewCreateInfo viewInfo{};
@@ -457,6 +549,7 @@ vpp::ImageView::ImageView(std::shared_ptr<Backend> backend, std::shared_ptr<Imag
     viewInfo.image = image->image;
     viewInfo.viewType = image->imageType == VK_IMAGE_TYPE_3D ? VK_IMAGE_VIEW_TYPE_3D : VK_IMAGE_VIEW_TYPE_2D;
     viewInfo.format = image->format;
+    viewInfo.components = components;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
     viewInfo.subresourceRange.levelCount = mipLevels;
@@ -527,6 +620,18 @@ vpp::Sampler::Sampler(std::shared_ptr<Backend> backend, uint32_t mipLevels, std:
     backend->setNameOfObject(VK_OBJECT_TYPE_SAMPLER, (uint64_t)sampler, name);
 }
 
+vpp::Sampler::Sampler(std::shared_ptr<Backend> backend, VkSamplerCreateInfo samplerInfo, std::string name):
+    backend(backend)
+{
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+
+    if (vkCreateSampler(backend->device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create sampler!");
+    }
+
+    backend->setNameOfObject(VK_OBJECT_TYPE_SAMPLER, (uint64_t)sampler, name);
+}
+
 vpp::Sampler::~Sampler()
 {
 	vkDestroySampler(backend->device, sampler, nullptr);
@@ -542,7 +647,7 @@ vpp::SuperDescriptorSetLayout::~SuperDescriptorSetLayout()
     vkDestroyDescriptorSetLayout(backend->device, descriptorSetLayout, nullptr);
 }
 
-void vpp::SuperDescriptorSetLayout::addBinding(VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t descriptorCount)
+void vpp::SuperDescriptorSetLayout::addBinding(VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t descriptorCount, VkDescriptorBindingFlags flags)
 {
     if (layoutCreated) throw std::runtime_error("Cannot add binding after layout creation.");
 
@@ -554,6 +659,7 @@ void vpp::SuperDescriptorSetLayout::addBinding(VkDescriptorType type, VkShaderSt
     layoutBinding.pImmutableSamplers = nullptr;
 
     bindings.push_back(layoutBinding);
+    bindingFlags.push_back(flags);
 }
 
 void vpp::SuperDescriptorSetLayout::createLayout()
@@ -565,6 +671,25 @@ void vpp::SuperDescriptorSetLayout::createLayout()
     layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
     layoutInfo.pBindings = bindings.data();
 
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+    bool anyBindingFlags = false;
+    for (VkDescriptorBindingFlags flags : bindingFlags)
+    {
+        anyBindingFlags |= flags != 0;
+        if (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT)
+        {
+            layoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        }
+    }
+    if (anyBindingFlags)
+    {
+        layoutInfo.pNext = &bindingFlagsInfo;
+    }
+
     if (vkCreateDescriptorSetLayout(backend->device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
@@ -597,9 +722,10 @@ void vpp::SuperDescriptorSet::addImagesToBinding(std::vector<std::shared_ptr<Ima
 		throw std::runtime_error("Binding's image view count, sampler count and image layout count must match layout's descriptor count.");
     }
 
-    if ((textureDescriptorSetLayout->bindings[currentBinding].descriptorType != VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER && textureDescriptorSetLayout->bindings[currentBinding].descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_IMAGE))
+    VkDescriptorType descriptorType = textureDescriptorSetLayout->bindings[currentBinding].descriptorType;
+    if (descriptorType != VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER && descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_IMAGE && descriptorType != VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT)
     {
-		throw std::runtime_error("Binding's descriptor type must be VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER or VK_DESCRIPTOR_TYPE_STORAGE_IMAGE.");
+		throw std::runtime_error("Binding's descriptor type must be VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE or VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT.");
     }
 
     std::vector<VkDescriptorImageInfo> imageInfoVector(textureDescriptorSetLayout->bindings[currentBinding].descriptorCount);
@@ -613,7 +739,7 @@ void vpp::SuperDescriptorSet::addImagesToBinding(std::vector<std::shared_ptr<Ima
     currentBinding++;
 }
 
-void vpp::SuperDescriptorSet::addBuffersToBinding(std::vector<std::shared_ptr<Buffer>> buffers)
+void vpp::SuperDescriptorSet::addBuffersToBinding(std::vector<std::shared_ptr<Buffer>> buffers, VkDeviceSize range)
 {
     if (!textureDescriptorSetLayout->isLayoutCreated()) throw std::runtime_error("Descriptor set layout not created.");
 
@@ -622,9 +748,16 @@ void vpp::SuperDescriptorSet::addBuffersToBinding(std::vector<std::shared_ptr<Bu
         throw std::runtime_error("Binding's buffer count(" + std::to_string(buffers.size()) + ") does not match descriptor count(" + std::to_string(textureDescriptorSetLayout->bindings[currentBinding].descriptorCount) + ").");
     }
 
-    if ((textureDescriptorSetLayout->bindings[currentBinding].descriptorType != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && textureDescriptorSetLayout->bindings[currentBinding].descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER))
+    VkDescriptorType descriptorType = textureDescriptorSetLayout->bindings[currentBinding].descriptorType;
+    if (descriptorType != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && descriptorType != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+    {
+        throw std::runtime_error("Binding's descriptor type must be VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER or VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC.");
+    }
+
+    // A dynamic descriptor covers one allocation, the offset comes at bind time
+    if (descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC && range == VK_WHOLE_SIZE)
     {
-        throw std::runtime_error("Binding's descriptor type must be VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER or VK_DESCRIPTOR_TYPE_STORAGE_BUFFER.");
+        throw std::runtime_error("Dynamic uniform buffer bindings need an explicit range.");
     }
 
     std::vector<VkDescriptorBufferInfo> bufferInfoVector(textureDescriptorSetLayout->bindings[currentBinding].descriptorCount);
@@ -632,7 +765,7 @@ void vpp::SuperDescriptorSet::addBuffersToBinding(std::vector<std::shared_ptr<Bu
 	{
 		bufferInfoVector[i].buffer = buffers[i]->buffer;
 		bufferInfoVector[i].offset = 0;
-		bufferInfoVector[i].range = buffers[i]->size;
+		bufferInfoVector[i].range = (range == VK_WHOLE_SIZE) ? buffers[i]->size : range;
 	}
 	(*bufferInfos)[currentBinding] = std::move(bufferInfoVector);
     currentBinding++;
@@ -671,11 +804,12 @@ void vpp::SuperDescriptorSet::createDescriptorSet()
         descriptorWrite.pImageInfo = nullptr;
         descriptorWrite.pTexelBufferView = nullptr;
 
-        if (textureDescriptorSetLayout->bindings[j].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || textureDescriptorSetLayout->bindings[j].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+        if (textureDescriptorSetLayout->bindings[j].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || textureDescriptorSetLayout->bindings[j].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ||
+            textureDescriptorSetLayout->bindings[j].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
         {
             descriptorWrite.pBufferInfo = bufferInfos->at(j).data();
         }
-        else if (textureDescriptorSetLayout->bindings[j].descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || textureDescriptorSetLayout->bindings[j].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
+        else if (textureDescriptorSetLayout->bindings[j].descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || textureDescriptorSetLayout->bindings[j].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE || textureDescriptorSetLayout->bindings[j].descriptorType == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT)
         {
             descriptorWrite.pImageInfo = imageInfos->at(j).data();
         }
@@ -0,0 +1,310 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <json.hpp>
+#include <glm/gtc/constants.hpp>
+
+static glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+{
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+// Nearest rank on a sorted copy
+static float percentile(const std::vector<float>& sorted, float fraction)
+{
+    if (sorted.empty())
+    {
+        return 0.0f;
+    }
+
+    size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+static nlohmann::json summarize(const std::vector<float>& frameTimes)
+{
+    std::vector<float> sorted = frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+
+    float mean = sorted.empty() ? 0.0f : std::accumulate(sorted.begin(), sorted.end(), 0.0f) / sorted.size();
+    float median = percentile(sorted, 0.5f);
+
+    // A stutter is a frame that takes more than twice the median
+    uint32_t stutters = static_cast<uint32_t>(std::count_if(sorted.begin(), sorted.end(), [median](float time) { return time > 2.0f * median; }));
+
+    return {
+        {"mean", mean},
+        {"p50", median},
+        {"p95", percentile(sorted, 0.95f)},
+        {"p99", percentile(sorted, 0.99f)},
+        {"max", sorted.empty() ? 0.0f : sorted.back()},
+        {"stutters", stutters}
+    };
+}
+
+static nlohmann::json loadJson(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+
+    return nlohmann::json::parse(file);
+}
+
+// An ellipse through the middle of the scene, looking along the direction of travel
+CameraPath CameraPath::createDefault(const vpp::AABB& bounds)
+{
+    CameraPath path;
+    path.keyframeInterval = 2.0f;
+
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    glm::vec3 extent = bounds.max - bounds.min;
+    glm::vec2 radius = glm::vec2(extent.x, extent.z) * 0.3f;
+    float height = bounds.min.y + extent.y * 0.2f;
+
+    const uint32_t keyframeCount = 12;
+    for (uint32_t i = 0; i <= keyframeCount; i++)
+    {
+        float angle = glm::two_pi<float>() * i / keyframeCount;
+        glm::vec3 position = glm::vec3(center.x + radius.x * std::cos(angle), height, center.z + radius.y * std::sin(angle));
+        glm::vec3 tangent = glm::vec3(-radius.x * std::sin(angle), 0.0f, radius.y * std::cos(angle));
+
+        // Look slightly inward so the path sees more of the scene
+        glm::vec3 inward = glm::vec3(center.x, height, center.z) - position;
+        path.keyframes.push_back({ position, glm::normalize(glm::normalize(tangent) + 0.5f * glm::normalize(inward)) });
+    }
+
+    return path;
+}
+
+void CameraPath::load(const std::string& path)
+{
+    nlohmann::json json = loadJson(path);
+
+    keyframeInterval = json.at("keyframeInterval").get<float>();
+    keyframes.clear();
+
+    for (const nlohmann::json& keyframe : json.at("keyframes"))
+    {
+        const nlohmann::json& position = keyframe.at("position");
+        const nlohmann::json& front = keyframe.at("front");
+        keyframes.push_back({
+            glm::vec3(position[0].get<float>(), position[1].get<float>(), position[2].get<float>()),
+            glm::normalize(glm::vec3(front[0].get<float>(), front[1].get<float>(), front[2].get<float>()))
+        });
+    }
+
+    if (keyframes.size() < 2 || keyframeInterval <= 0.0f)
+    {
+        throw std::runtime_error("camera path " + path + " needs at least two keyframes!");
+    }
+}
+
+void CameraPath::save(const std::string& path) const
+{
+    nlohmann::json json;
+    json["keyframeInterval"] = keyframeInterval;
+    json["keyframes"] = nlohmann::json::array();
+
+    for (const Keyframe& keyframe : keyframes)
+    {
+        json["keyframes"].push_back({
+            {"position", {keyframe.position.x, keyframe.position.y, keyframe.position.z}},
+            {"front", {keyframe.front.x, keyframe.front.y, keyframe.front.z}}
+        });
+    }
+
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open " + path + " for the camera path!");
+    }
+    file << json.dump(4);
+}
+
+float CameraPath::duration() const
+{
+    return keyframes.size() < 2 ? 0.0f : keyframeInterval * (keyframes.size() - 1);
+}
+
+CameraPath::Keyframe CameraPath::evaluate(float time) const
+{
+    if (keyframes.size() < 2)
+    {
+        return keyframes.empty() ? Keyframe{ glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f) } : keyframes[0];
+    }
+
+    float segment = std::clamp(time / keyframeInterval, 0.0f, static_cast<float>(keyframes.size() - 1));
+    int index = std::min(static_cast<int>(segment), static_cast<int>(keyframes.size()) - 2);
+    float t = segment - index;
+
+    auto keyframe = [this](int i) -> const Keyframe& { return keyframes[std::clamp(i, 0, static_cast<int>(keyframes.size()) - 1)]; };
+
+    Keyframe result;
+    result.position = catmullRom(keyframe(index - 1).position, keyframe(index).position, keyframe(index + 1).position, keyframe(index + 2).position, t);
+    result.front = glm::normalize(catmullRom(keyframe(index - 1).front, keyframe(index).front, keyframe(index + 1).front, keyframe(index + 2).front, t));
+    return result;
+}
+
+Benchmark::Benchmark(BenchmarkSettings settings) : settings(settings)
+{
+}
+
+void Benchmark::start(const vpp::AABB& sceneBounds)
+{
+    if (settings.cameraPath.empty())
+    {
+        path = CameraPath::createDefault(sceneBounds);
+    }
+    else
+    {
+        path.load(settings.cameraPath);
+    }
+
+    uint32_t pathFrames = static_cast<uint32_t>(std::ceil(path.duration() / settings.fixedStep)) + 1;
+    totalFrames = settings.warmupFrames + (settings.frameCount > 0 ? settings.frameCount : pathFrames);
+    frameIndex = 0;
+    lastFrameStart = std::chrono::steady_clock::now();
+}
+
+void Benchmark::update(vpp::Camera& camera)
+{
+    // Warmup holds the first pose, measured frames then walk the path one fixed step at a time
+    uint32_t measuredFrame = frameIndex > settings.warmupFrames ? frameIndex - settings.warmupFrames : 0;
+    float time = std::fmod(static_cast<float>(measuredFrame * settings.fixedStep), std::max(path.duration(), 1e-3f));
+
+    CameraPath::Keyframe pose = path.evaluate(time);
+    camera.position = pose.position;
+    camera.setFront(pose.front);
+}
+
+void Benchmark::recordFrame(float gpuFrameTime, const std::vector<std::pair<std::string, float>>& passTimes)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    float cpuFrameTime = std::chrono::duration<float, std::milli>(now - lastFrameStart).count();
+    lastFrameStart = now;
+
+    uint32_t index = frameIndex++;
+    if (index < settings.warmupFrames || index >= totalFrames)
+    {
+        return;
+    }
+
+    cpuFrameTimes.push_back(cpuFrameTime);
+    gpuFrameTimes.push_back(gpuFrameTime);
+
+    for (const auto& [name, time] : passTimes)
+    {
+        passFrameTimes[name].push_back(time);
+    }
+}
+
+bool Benchmark::isFinished() const
+{
+    return frameIndex >= totalFrames;
+}
+
+void Benchmark::writeReport() const
+{
+    nlohmann::json report;
+    report["device"] = deviceName;
+    report["resolution"] = { width, height };
+    report["frames"] = cpuFrameTimes.size();
+    report["warmupFrames"] = settings.warmupFrames;
+    report["fixedStep"] = settings.fixedStep;
+    report["cameraPath"] = settings.cameraPath.empty() ? "default" : settings.cameraPath;
+    report["cpu"] = summarize(cpuFrameTimes);
+    report["gpu"] = summarize(gpuFrameTimes);
+
+    report["passes"] = nlohmann::json::object();
+    for (const auto& [name, times] : passFrameTimes)
+    {
+        report["passes"][name] = summarize(times);
+    }
+
+    std::ofstream file(settings.reportPath);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open " + settings.reportPath + " for the benchmark report!");
+    }
+    file << report.dump(4);
+}
+
+uint32_t Benchmark::compareWithBaseline() const
+{
+    nlohmann::json baseline = loadJson(settings.baselinePath);
+    nlohmann::json current = loadJson(settings.reportPath);
+
+    // Differences below this are timer noise even if they are a large fraction of a cheap pass
+    const float minimumDelta = 0.05f;
+    uint32_t regressions = 0;
+
+    auto compare = [&](const std::string& name, const nlohmann::json& before, const nlohmann::json& after)
+    {
+        for (const char* metric : { "mean", "p50", "p95", "p99" })
+        {
+            float baselineTime = before.at(metric).get<float>();
+            float currentTime = after.at(metric).get<float>();
+            float change = baselineTime > 0.0f ? (currentTime - baselineTime) / baselineTime : 0.0f;
+            bool regressed = change > settings.regressionThreshold && currentTime - baselineTime > minimumDelta;
+            regressions += regressed ? 1 : 0;
+
+            printf("%-24s %-4s %8.3f ms -> %8.3f ms (%+6.1f%%)%s\n", name.c_str(), metric, baselineTime, currentTime, change * 100.0f, regressed ? "  REGRESSION" : "");
+        }
+    };
+
+    compare("cpu", baseline.at("cpu"), current.at("cpu"));
+    compare("gpu", baseline.at("gpu"), current.at("gpu"));
+
+    for (const auto& [name, times] : current.at("passes").items())
+    {
+        if (baseline.at("passes").contains(name))
+        {
+            compare(name, baseline["passes"][name], times);
+        }
+    }
+
+    printf("%u regression(s) above %.1f%%\n", regressions, settings.regressionThreshold * 100.0f);
+    return regressions;
+}
+
+void CameraPathRecorder::start()
+{
+    path = CameraPath();
+    path.keyframeInterval = 0.5f;
+    timeSinceKeyframe = path.keyframeInterval;
+    recording = true;
+}
+
+void CameraPathRecorder::update(const vpp::Camera& camera, double deltaTime)
+{
+    if (!recording)
+    {
+        return;
+    }
+
+    timeSinceKeyframe += deltaTime;
+    if (timeSinceKeyframe >= path.keyframeInterval)
+    {
+        timeSinceKeyframe -= path.keyframeInterval;
+        path.keyframes.push_back({ camera.position, camera.front });
+    }
+}
+
+void CameraPathRecorder::stop(const std::string& outputPath)
+{
+    recording = false;
+    if (path.keyframes.size() >= 2)
+    {
+        path.save(outputPath);
+    }
+}
@@ -0,0 +1,218 @@
+#include "BindlessHeap.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+// Sampled images and buffers the other sets of a pipeline layout may still use under the per stage limits
+static constexpr uint32_t RESERVED_DESCRIPTORS = 256;
+static constexpr uint32_t MAX_TEXTURE_BINDING_SIZE = 1u << 20;
+
+vpp::BindlessSlot vpp::BindlessHeap::SlotAllocator::allocate()
+{
+    BindlessSlot slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else if (highWaterMark < capacity)
+    {
+        slot = highWaterMark++;
+        states.push_back(SLOT_FREE);
+    }
+    else
+    {
+        return INVALID_SLOT;
+    }
+
+    states[slot] = SLOT_ALLOCATED;
+    used++;
+    return slot;
+}
+
+void vpp::BindlessHeap::SlotAllocator::retire(BindlessSlot slot, uint64_t frame)
+{
+    if (slot >= highWaterMark) throw std::runtime_error("Bindless slot was never allocated.");
+    if (states[slot] != SLOT_ALLOCATED) throw std::runtime_error("Bindless slot was already freed.");
+
+    states[slot] = SLOT_RETIRED;
+
+    retiredSlots.push_back({ slot, frame });
+}
+
+std::vector<vpp::BindlessSlot> vpp::BindlessHeap::SlotAllocator::collect(uint64_t completedFrame)
+{
+    std::vector<BindlessSlot> collected;
+
+    auto firstPending = std::partition(retiredSlots.begin(), retiredSlots.end(), [completedFrame](const RetiredSlot& retired) { return retired.frame <= completedFrame; });
+    for (auto it = retiredSlots.begin(); it != firstPending; it++)
+    {
+        collected.push_back(it->slot);
+        freeSlots.push_back(it->slot);
+        states[it->slot] = SLOT_FREE;
+    }
+    retiredSlots.erase(retiredSlots.begin(), firstPending);
+
+    used -= static_cast<uint32_t>(collected.size());
+    return collected;
+}
+
+vpp::BindlessHeap::BindlessHeap(std::shared_ptr<Backend> backend, uint32_t textureCapacity, uint32_t bufferCapacity) :
+    backend(backend)
+{
+    VkPhysicalDeviceVulkan12Properties properties12{};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(backend->physicalDevice, &properties);
+
+    uint32_t bufferLimit = std::min(properties12.maxDescriptorSetUpdateAfterBindStorageBuffers, properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers);
+    buffers.capacity = std::min(bufferCapacity, bufferLimit > RESERVED_DESCRIPTORS ? bufferLimit - RESERVED_DESCRIPTORS : bufferLimit / 2);
+
+    // The layout only bounds the texture binding, a bigger heap later needs a new set but no new pipelines
+    uint32_t textureLimit = std::min({ properties12.maxDescriptorSetUpdateAfterBindSampledImages, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        properties12.maxPerStageUpdateAfterBindResources - std::min(properties12.maxPerStageUpdateAfterBindResources, buffers.capacity) });
+    uint32_t textureBound = std::min(MAX_TEXTURE_BINDING_SIZE, textureLimit > RESERVED_DESCRIPTORS ? textureLimit - RESERVED_DESCRIPTORS : textureLimit / 2);
+    textures.capacity = std::min(textureCapacity, textureBound);
+
+    if (textures.capacity == 0 || buffers.capacity == 0) throw std::runtime_error("failed to fit the bindless heap into the device's update after bind limits!");
+
+    VkDescriptorBindingFlags flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+    layout = std::make_shared<SuperDescriptorSetLayout>(backend, "Bindless heap layout");
+    layout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, buffers.capacity, flags);
+    layout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, stages, textureBound, flags | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT);
+    layout->createLayout();
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = buffers.capacity;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = textures.capacity;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(backend->device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create bindless descriptor pool!");
+    }
+    backend->setNameOfObject(VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t)descriptorPool, "Bindless descriptor pool");
+
+    VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+    variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+    variableCountInfo.descriptorSetCount = 1;
+    variableCountInfo.pDescriptorCounts = &textures.capacity;
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.pNext = &variableCountInfo;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout->descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(backend->device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate bindless descriptor set!");
+    }
+    backend->setNameOfObject(VK_OBJECT_TYPE_DESCRIPTOR_SET, (uint64_t)descriptorSet, "Bindless heap");
+
+    textureViews.resize(textures.capacity);
+    textureSamplers.resize(textures.capacity);
+    bufferResources.resize(buffers.capacity);
+}
+
+vpp::BindlessHeap::~BindlessHeap()
+{
+    vkDestroyDescriptorPool(backend->device, descriptorPool, nullptr);
+}
+
+vpp::BindlessSlot vpp::BindlessHeap::addTexture(std::shared_ptr<ImageView> imageView, std::shared_ptr<Sampler> sampler, VkImageLayout imageLayout)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    BindlessSlot slot = textures.allocate();
+    if (slot == INVALID_SLOT) throw std::runtime_error("Bindless heap is out of texture slots.");
+
+    textureViews[slot] = imageView;
+    textureSamplers[slot] = sampler;
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageView = imageView->imageView;
+    imageInfo.sampler = sampler->sampler;
+    imageInfo.imageLayout = imageLayout;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = TEXTURE_BINDING;
+    descriptorWrite.dstArrayElement = slot;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(backend->device, 1, &descriptorWrite, 0, nullptr);
+    return slot;
+}
+
+vpp::BindlessSlot vpp::BindlessHeap::addBuffer(std::shared_ptr<Buffer> buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    BindlessSlot slot = buffers.allocate();
+    if (slot == INVALID_SLOT) throw std::runtime_error("Bindless heap is out of buffer slots.");
+
+    bufferResources[slot] = buffer;
+
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = buffer->buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = buffer->size;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = BUFFER_BINDING;
+    descriptorWrite.dstArrayElement = slot;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(backend->device, 1, &descriptorWrite, 0, nullptr);
+    return slot;
+}
+
+void vpp::BindlessHeap::freeTexture(BindlessSlot slot, uint64_t lastUsedFrame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    textures.retire(slot, lastUsedFrame);
+}
+
+void vpp::BindlessHeap::freeBuffer(BindlessSlot slot, uint64_t lastUsedFrame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers.retire(slot, lastUsedFrame);
+}
+
+void vpp::BindlessHeap::collect(uint64_t completedFrame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // The stale descriptors stay in the set, partially bound slots nobody indexes are never read
+    for (BindlessSlot slot : textures.collect(completedFrame))
+    {
+        textureViews[slot].reset();
+        textureSamplers[slot].reset();
+    }
+
+    for (BindlessSlot slot : buffers.collect(completedFrame))
+    {
+        bufferResources[slot].reset();
+    }
+}
@@ -0,0 +1,177 @@
+#include "Bloom.h"
+#include <algorithm>
+
+VkExtent2D Bloom::getBaseExtent(uint32_t width, uint32_t height)
+{
+    return { std::max(width / 2, 1u), std::max(height / 2, 1u) };
+}
+
+uint32_t Bloom::getMipCount(VkExtent2D baseExtent)
+{
+    uint32_t mipCount = 1;
+    while (mipCount < MAX_MIP_COUNT && (baseExtent.width >> mipCount) >= MIN_MIP_SIZE && (baseExtent.height >> mipCount) >= MIN_MIP_SIZE)
+    {
+        mipCount++;
+    }
+    return mipCount;
+}
+
+Bloom::Bloom(std::shared_ptr<vpp::Backend> backend, std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::Image> image) :
+    backend(backend)
+{
+    // Clamped so the composite doesn't pull bloom across the screen edges
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+    sampler = std::make_shared<vpp::Sampler>(backend, samplerInfo, "Bloom::Sampler");
+
+    descriptorSetLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "Bloom::Descriptor Set Layout");
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+    descriptorSetLayout->createLayout();
+
+    createTargets(hdrImageView, image);
+    createPipelines();
+}
+
+Bloom::~Bloom()
+{
+    downsamplePipeline.reset();
+    upsamplePipeline.reset();
+    downsampleDescriptorSets.clear();
+    upsampleDescriptorSets.clear();
+    descriptorSetLayout.reset();
+    sampler.reset();
+    outputImageView.reset();
+    mipViews.clear();
+    image.reset();
+}
+
+void Bloom::resize(vpp::RenderTargets& renderTargets, std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::Image> image)
+{
+    renderTargets.retire(this->image);
+    for (auto& mipView : mipViews)
+    {
+        renderTargets.retire(mipView);
+    }
+    for (auto& descriptorSet : downsampleDescriptorSets)
+    {
+        renderTargets.retire(descriptorSet);
+    }
+    for (auto& descriptorSet : upsampleDescriptorSets)
+    {
+        renderTargets.retire(descriptorSet);
+    }
+
+    createTargets(hdrImageView, image);
+}
+
+void Bloom::createTargets(std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::Image> image)
+{
+    this->image = image;
+    mipCount = image->mipLevels;
+
+    mipViews.clear();
+    for (uint32_t i = 0; i < mipCount; i++)
+    {
+        mipViews.push_back(std::make_shared<vpp::ImageView>(backend, image, i, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Bloom::Mip " + std::to_string(i) + " View"));
+    }
+    outputImageView = mipViews[0];
+
+    downsampleDescriptorSets.clear();
+    upsampleDescriptorSets.clear();
+
+    // Downsample i reads the HDR image or mip i - 1 and writes mip i
+    for (uint32_t i = 0; i < mipCount; i++)
+    {
+        std::shared_ptr<vpp::ImageView> source = i == 0 ? hdrImageView : mipViews[i - 1];
+
+        std::shared_ptr<vpp::SuperDescriptorSet> descriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, descriptorSetLayout, "Bloom::Downsample " + std::to_string(i) + " Descriptor Set");
+        descriptorSet->addImagesToBinding({ source }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSet->addImagesToBinding({ mipViews[i] }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSet->addImagesToBinding({ mipViews[i] }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSet->createDescriptorSet();
+        downsampleDescriptorSets.push_back(descriptorSet);
+    }
+
+    // Upsample i reads mip i + 1 and accumulates into mip i
+    for (uint32_t i = 0; i + 1 < mipCount; i++)
+    {
+        std::shared_ptr<vpp::SuperDescriptorSet> descriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, descriptorSetLayout, "Bloom::Upsample " + std::to_string(i) + " Descriptor Set");
+        descriptorSet->addImagesToBinding({ mipViews[i + 1] }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSet->addImagesToBinding({ mipViews[i] }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSet->addImagesToBinding({ mipViews[i] }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSet->createDescriptorSet();
+        upsampleDescriptorSets.push_back(descriptorSet);
+    }
+}
+
+void Bloom::createPipelines()
+{
+    downsamplePipeline = std::make_shared<vpp::ComputePipeline>(backend, "Bloom::Downsample Pipeline", "shaders/bloomDownsample.comp.spv");
+    downsamplePipeline->addDescriptorSetLayout(descriptorSetLayout);
+    downsamplePipeline->addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BloomPushConstants));
+    downsamplePipeline->createPipeline();
+
+    upsamplePipeline = std::make_shared<vpp::ComputePipeline>(backend, "Bloom::Upsample Pipeline", "shaders/bloomUpsample.comp.spv");
+    upsamplePipeline->addDescriptorSetLayout(descriptorSetLayout);
+    upsamplePipeline->addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BloomPushConstants));
+    upsamplePipeline->createPipeline();
+}
+
+void Bloom::shaderBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask)
+{
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, backend->supportedStages(commandBuffer, srcStageMask), backend->supportedStages(commandBuffer, dstStageMask), 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void Bloom::recordDownsample(VkCommandBuffer commandBuffer)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipeline->pipeline);
+
+    for (uint32_t i = 0; i < mipCount; i++)
+    {
+        if (i > 0)
+        {
+            shaderBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+
+        BloomPushConstants pushConstants{ threshold, knee, 1.0f, i == 0 ? 1u : 0u };
+        vkCmdPushConstants(commandBuffer, downsamplePipeline->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BloomPushConstants), &pushConstants);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipeline->pipelineLayout, 0, 1, &downsampleDescriptorSets[i]->descriptorSet, 0, nullptr);
+
+        uint32_t mipWidth = std::max(image->width >> i, 1u);
+        uint32_t mipHeight = std::max(image->height >> i, 1u);
+        vkCmdDispatch(commandBuffer, (mipWidth + 7) / 8, (mipHeight + 7) / 8, 1);
+    }
+}
+
+void Bloom::recordUpsample(VkCommandBuffer commandBuffer)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, upsamplePipeline->pipeline);
+
+    for (uint32_t i = mipCount - 1; i-- > 0;)
+    {
+        shaderBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+        // Every mip adds its own level, so mip 0 is normalized by the level count
+        float outputScale = i == 0 ? 1.0f / static_cast<float>(mipCount) : 1.0f;
+        BloomPushConstants pushConstants{ threshold, knee, outputScale, 0u };
+        vkCmdPushConstants(commandBuffer, upsamplePipeline->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BloomPushConstants), &pushConstants);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, upsamplePipeline->pipelineLayout, 0, 1, &upsampleDescriptorSets[i]->descriptorSet, 0, nullptr);
+
+        uint32_t mipWidth = std::max(image->width >> i, 1u);
+        uint32_t mipHeight = std::max(image->height >> i, 1u);
+        vkCmdDispatch(commandBuffer, (mipWidth + 7) / 8, (mipHeight + 7) / 8, 1);
+    }
+}
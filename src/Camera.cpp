@@ -16,12 +16,51 @@ vpp::ViewProjectionMatrices vpp::Camera::getMVPMatrices(float width, float heigh
 	ViewProjectionMatrices matrices;
 
 	matrices.view = glm::lookAt(this->position, this->position + this->front, this->up);
-	matrices.proj = glm::perspective(glm::radians(45.0f), width / height, 20.0f, 100000.0f);
+	matrices.proj = glm::perspective(glm::radians(fov), width / height, nearPlane, farPlane);
 	matrices.proj[1][1] *= -1;
+	matrices.unjitteredViewProj = matrices.proj * matrices.view;
+
+	// Offset in clip space, so NDC moves by exactly the jitter after the divide
+	glm::vec2 jitterNdc = 2.0f * jitter / glm::vec2(width, height);
+	matrices.proj = glm::translate(glm::mat4(1.0f), glm::vec3(jitterNdc, 0.0f)) * matrices.proj;
+	matrices.jitter = glm::vec4(jitterNdc * 0.5f, 0.0f, 0.0f);
+
+	matrices.inverseViewProj = glm::inverse(matrices.proj * matrices.view);
+	matrices.inverseProj = glm::inverse(matrices.proj);
+	matrices.previousViewProj = matrices.unjitteredViewProj;
 
 	return matrices;
 }
 
+// World space corners of the view frustum between two view distances, near quad first
+std::array<glm::vec3, 8> vpp::Camera::getFrustumCorners(float aspect, float sliceNear, float sliceFar) const
+{
+	float tanHalfFov = glm::tan(glm::radians(fov) * 0.5f);
+	std::array<glm::vec3, 8> corners;
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		float distance = i == 0 ? sliceNear : sliceFar;
+		glm::vec3 center = position + front * distance;
+		glm::vec3 halfUp = up * (distance * tanHalfFov);
+		glm::vec3 halfRight = right * (distance * tanHalfFov * aspect);
+
+		corners[i * 4 + 0] = center - halfRight - halfUp;
+		corners[i * 4 + 1] = center + halfRight - halfUp;
+		corners[i * 4 + 2] = center + halfRight + halfUp;
+		corners[i * 4 + 3] = center - halfRight + halfUp;
+	}
+
+	return corners;
+}
+
+void vpp::Camera::setFront(glm::vec3 front)
+{
+	this->front = glm::normalize(front);
+	this->right = glm::normalize(glm::cross(this->front, this->worldUp));
+	this->up = glm::normalize(glm::cross(this->right, this->front));
+}
+
 void vpp::Camera::move()
 {
 	if (this->movingForward)
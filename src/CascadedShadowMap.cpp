@@ -0,0 +1,345 @@
+#include "CascadedShadowMap.h"
+#include "Model.h"
+#include <algorithm>
+#include <cmath>
+
+CascadedShadowMap::CascadedShadowMap(std::shared_ptr<vpp::Backend> backend) :
+    backend(backend)
+{
+    uint32_t atlasSize = CASCADE_RESOLUTION * vpp::SHADOW_ATLAS_TILES;
+
+    atlasImage = std::make_shared<vpp::Image>(backend, atlasSize, atlasSize, 1, 1, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Shadow pass::Atlas Image");
+    atlasImageView = std::make_shared<vpp::ImageView>(backend, atlasImage, 0, 1, VK_IMAGE_ASPECT_DEPTH_BIT, "Shadow Atlas Image View");
+    atlasImage->transitionLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+
+    // Linear filtering on a comparison sampler gives a bilinear 2x2 PCF per tap
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.maxLod = 0.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    comparisonSampler = std::make_shared<vpp::Sampler>(backend, samplerInfo, "Shadow comparison sampler");
+
+    createRenderPass();
+    createFramebuffer();
+    createPipeline();
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+    pipeline.reset();
+    vkDestroyFramebuffer(backend->device, framebuffer, nullptr);
+    vkDestroyRenderPass(backend->device, renderPass, nullptr);
+    comparisonSampler.reset();
+    atlasImageView.reset();
+    atlasImage.reset();
+}
+
+void CascadedShadowMap::createRenderPass()
+{
+    // Cascades that aren't re-rendered keep their contents, so the atlas is loaded and cleared per tile
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = atlasImage->format;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // The render graph transitions the atlas around the pass and orders it against the lighting reads
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 0;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 0;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &depthAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    if (vkCreateRenderPass(backend->device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow render pass!");
+    }
+}
+
+void CascadedShadowMap::createFramebuffer()
+{
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = renderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &atlasImageView->imageView;
+    framebufferInfo.width = atlasImage->width;
+    framebufferInfo.height = atlasImage->height;
+    framebufferInfo.layers = 1;
+
+    if (vkCreateFramebuffer(backend->device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow framebuffer!");
+    }
+}
+
+void CascadedShadowMap::createPipeline()
+{
+    pipeline = std::make_shared<vpp::GraphicsPipeline>(backend, "CascadedShadowMap::Shadow Pipeline", renderPass, VK_TRUE, VK_TRUE, 0);
+    pipeline->addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, "shaders/shadowPass.vert.spv");
+    pipeline->addPushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShadowPushConstants));
+
+    // Both faces cast, the slope scaled bias handles acne at grazing angles
+    pipeline->rasterizer.cullMode = VK_CULL_MODE_NONE;
+    pipeline->rasterizer.depthBiasEnable = VK_TRUE;
+    pipeline->rasterizer.depthBiasConstantFactor = 1.25f;
+    pipeline->rasterizer.depthBiasSlopeFactor = 1.75f;
+
+    pipeline->createPipeline();
+}
+
+bool CascadedShadowMap::hasDirtyCascades() const
+{
+    if (!enabled)
+    {
+        return false;
+    }
+
+    for (auto& cascade : cascades)
+    {
+        if (cascade.dirty)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CascadedShadowMap::invalidate()
+{
+    for (auto& cascade : cascades)
+    {
+        cascade.valid = false;
+        cascade.dirty = true;
+    }
+}
+
+void CascadedShadowMap::fitCascade(Cascade& cascade, glm::vec3 center, float radius, glm::vec3 lightDirection, const vpp::AABB& sceneBounds)
+{
+    glm::vec3 up = glm::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightView = glm::lookAt(center, center - lightDirection, up);
+
+    // Depth range covers the receivers around the cascade and every caster between them and the sun
+    float nearPlane = -radius;
+    float farPlane = radius;
+    if (sceneBounds.isValid())
+    {
+        vpp::AABB lightSpaceBounds = sceneBounds.transform(lightView);
+        nearPlane = std::min(nearPlane, -lightSpaceBounds.max.z);
+        farPlane = std::max(farPlane, -lightSpaceBounds.min.z);
+    }
+
+    glm::mat4 lightProj = glm::ortho(-radius, radius, -radius, radius, nearPlane, farPlane);
+
+    // Snap to whole texels so the cascade doesn't shimmer while the camera moves
+    glm::vec4 origin = lightProj * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    glm::vec2 texelOrigin = glm::vec2(origin) * (CASCADE_RESOLUTION * 0.5f);
+    glm::vec2 offset = (glm::round(texelOrigin) - texelOrigin) * (2.0f / CASCADE_RESOLUTION);
+    lightProj[3][0] += offset.x;
+    lightProj[3][1] += offset.y;
+
+    // A still camera snaps to the same matrix, so the cascade keeps its tile and isn't redrawn
+    glm::mat4 viewProj = lightProj * lightView;
+    cascade.dirty = cascade.dirty || !cascade.valid || viewProj != cascade.viewProj;
+
+    cascade.viewProj = viewProj;
+    cascade.center = center;
+    cascade.radius = radius;
+    cascade.valid = true;
+}
+
+void CascadedShadowMap::update(const vpp::Camera& camera, float aspect, glm::vec3 lightDirection, const std::vector<ShadowCaster>& casters)
+{
+    renderedCascadeCount = 0;
+    drawnCasterCount = 0;
+
+    lightDirection = glm::normalize(lightDirection);
+
+    // Any light or caster movement invalidates the cached cascades
+    bool castersMoved = casters.size() != lastCasterTransforms.size();
+    for (size_t i = 0; i < casters.size() && !castersMoved; i++)
+    {
+        castersMoved = casters[i].transform != lastCasterTransforms[i];
+    }
+
+    if (castersMoved || glm::dot(lightDirection, lastLightDirection) < 0.99999f)
+    {
+        invalidate();
+        lastLightDirection = lightDirection;
+        lastCasterTransforms.clear();
+        for (auto& caster : casters)
+        {
+            lastCasterTransforms.push_back(caster.transform);
+        }
+    }
+
+    vpp::AABB sceneBounds;
+    for (auto& caster : casters)
+    {
+        sceneBounds.expand(caster.bounds);
+    }
+
+    // Practical split scheme, a blend of logarithmic and uniform splits
+    float nearPlane = camera.nearPlane;
+    float farPlane = std::min(camera.farPlane, shadowDistance);
+    float sliceNear = nearPlane;
+
+    for (uint32_t i = 0; i < vpp::SHADOW_CASCADE_COUNT; i++)
+    {
+        float p = static_cast<float>(i + 1) / vpp::SHADOW_CASCADE_COUNT;
+        float logSplit = nearPlane * std::pow(farPlane / nearPlane, p);
+        float uniformSplit = nearPlane + (farPlane - nearPlane) * p;
+        float sliceFar = splitLambda * logSplit + (1.0f - splitLambda) * uniformSplit;
+
+        // A bounding sphere keeps the cascade size constant as the camera rotates
+        std::array<glm::vec3, 8> corners = camera.getFrustumCorners(aspect, sliceNear, sliceFar);
+        glm::vec3 center(0.0f);
+        for (auto& corner : corners)
+        {
+            center += corner / 8.0f;
+        }
+
+        float radius = 0.0f;
+        for (auto& corner : corners)
+        {
+            radius = std::max(radius, glm::length(corner - center));
+        }
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        Cascade& cascade = cascades[i];
+        cascade.splitFar = sliceFar;
+
+        if (cacheFarCascades && i >= firstCachedCascade)
+        {
+            bool contained = cascade.valid && glm::length(center - cascade.center) + radius <= cascade.radius;
+            if (!contained)
+            {
+                fitCascade(cascade, center, radius * cacheMargin, lightDirection, sceneBounds);
+            }
+        }
+        else
+        {
+            fitCascade(cascade, center, radius, lightDirection, sceneBounds);
+        }
+
+        sliceNear = sliceFar;
+    }
+}
+
+void CascadedShadowMap::record(VkCommandBuffer commandBuffer, const std::vector<ShadowCaster>& casters)
+{
+    // Everything is cached, the frame pays nothing for shadows
+    if (!hasDirtyCascades())
+    {
+        return;
+    }
+
+    for (auto& cascade : cascades)
+    {
+        renderedCascadeCount += cascade.dirty ? 1 : 0;
+    }
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = framebuffer;
+    renderPassInfo.renderArea.offset = { 0, 0 };
+    renderPassInfo.renderArea.extent = { atlasImage->width, atlasImage->height };
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+
+    VkDeviceSize offsets[] = { 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &(vpp::Model::getVertexBuffer()->buffer), offsets);
+    vkCmdBindIndexBuffer(commandBuffer, vpp::Model::getIndexBuffer()->buffer, 0, VK_INDEX_TYPE_UINT32);
+
+    for (uint32_t i = 0; i < vpp::SHADOW_CASCADE_COUNT; i++)
+    {
+        Cascade& cascade = cascades[i];
+        if (!cascade.dirty)
+        {
+            continue;
+        }
+
+        VkRect2D tile{};
+        tile.offset = { static_cast<int32_t>((i % vpp::SHADOW_ATLAS_TILES) * CASCADE_RESOLUTION), static_cast<int32_t>((i / vpp::SHADOW_ATLAS_TILES) * CASCADE_RESOLUTION) };
+        tile.extent = { CASCADE_RESOLUTION, CASCADE_RESOLUTION };
+
+        VkViewport viewport{};
+        viewport.x = static_cast<float>(tile.offset.x);
+        viewport.y = static_cast<float>(tile.offset.y);
+        viewport.width = static_cast<float>(CASCADE_RESOLUTION);
+        viewport.height = static_cast<float>(CASCADE_RESOLUTION);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &tile);
+
+        VkClearAttachment clearAttachment{};
+        clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        clearAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+        VkClearRect clearRect{};
+        clearRect.rect = tile;
+        clearRect.baseArrayLayer = 0;
+        clearRect.layerCount = 1;
+        vkCmdClearAttachments(commandBuffer, 1, &clearAttachment, 1, &clearRect);
+
+        for (auto& caster : casters)
+        {
+            // Casters in front of the near plane can't exist, the depth range covers the scene
+            vpp::AABB clipBounds = caster.bounds.transform(cascade.viewProj);
+            if (clipBounds.max.x < -1.0f || clipBounds.min.x > 1.0f || clipBounds.max.y < -1.0f || clipBounds.min.y > 1.0f || clipBounds.min.z > 1.0f)
+            {
+                continue;
+            }
+
+            ShadowPushConstants pushConstants{ cascade.viewProj * caster.transform };
+            vkCmdPushConstants(commandBuffer, pipeline->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShadowPushConstants), &pushConstants);
+            vkCmdDrawIndexed(commandBuffer, caster.indexCount, 1, caster.firstIndex, caster.vertexOffset, 0);
+            drawnCasterCount++;
+        }
+
+        cascade.dirty = false;
+    }
+
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+vpp::ShadowData CascadedShadowMap::getShadowData()
+{
+    vpp::ShadowData shadowData{};
+
+    for (uint32_t i = 0; i < vpp::SHADOW_CASCADE_COUNT; i++)
+    {
+        shadowData.cascadeViewProj[i] = cascades[i].viewProj;
+        shadowData.cascadeSplits[i] = cascades[i].splitFar;
+        shadowData.cascadeTexelSizes[i] = 2.0f * cascades[i].radius / CASCADE_RESOLUTION;
+    }
+
+    shadowData.normalOffset = normalOffset;
+    shadowData.pcfRadius = static_cast<uint32_t>(pcfRadius);
+    shadowData.enabled = enabled ? 1 : 0;
+    shadowData.atlasTexelSize = 1.0f / atlasImage->width;
+
+    return shadowData;
+}
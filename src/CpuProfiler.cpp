@@ -0,0 +1,113 @@
+#include "CpuProfiler.h"
+
+#ifdef VPP_CPU_PROFILER
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <json.hpp>
+
+vpp::CpuProfiler& vpp::CpuProfiler::get()
+{
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+uint64_t vpp::CpuProfiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+vpp::CpuProfiler::CpuProfiler() : startTime(now())
+{
+}
+
+vpp::CpuProfiler::ThreadBuffer& vpp::CpuProfiler::threadBuffer()
+{
+    thread_local ThreadBuffer* buffer = nullptr;
+
+    if (buffer == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        threadBuffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = threadBuffers.back().get();
+        buffer->threadId = static_cast<uint32_t>(threadBuffers.size() - 1);
+        buffer->name = "Thread " + std::to_string(buffer->threadId);
+    }
+
+    return *buffer;
+}
+
+void vpp::CpuProfiler::record(const char* name, uint64_t begin, uint64_t end)
+{
+    ThreadBuffer& buffer = threadBuffer();
+
+    // Single writer per ring, the release store publishes the event to the exporter
+    uint64_t index = buffer.writeIndex.load(std::memory_order_relaxed);
+    buffer.events[index % EVENTS_PER_THREAD] = { name, begin, end };
+    buffer.writeIndex.store(index + 1, std::memory_order_release);
+}
+
+void vpp::CpuProfiler::setThreadName(const std::string& name)
+{
+    ThreadBuffer& buffer = threadBuffer();
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer.name = name;
+}
+
+void vpp::CpuProfiler::exportTrace(const std::string& path)
+{
+    nlohmann::json events = nlohmann::json::array();
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    for (const std::unique_ptr<ThreadBuffer>& buffer : threadBuffers)
+    {
+        events.push_back({ {"name", "thread_name"}, {"ph", "M"}, {"pid", 0}, {"tid", buffer->threadId}, {"args", {{"name", buffer->name}}} });
+
+        uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+        uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+
+        std::vector<CpuProfileEvent> copied;
+        copied.reserve(end - begin);
+        for (uint64_t i = begin; i < end; i++)
+        {
+            copied.push_back(buffer->events[i % EVENTS_PER_THREAD]);
+        }
+
+        // The owning thread keeps recording while we copy, drop anything it may have overwritten,
+        // including the slot it may be writing at index after right now
+        uint64_t after = buffer->writeIndex.load(std::memory_order_acquire);
+        uint64_t firstValid = after + 1 > EVENTS_PER_THREAD ? after + 1 - EVENTS_PER_THREAD : 0;
+        size_t skip = static_cast<size_t>(std::min<uint64_t>(firstValid > begin ? firstValid - begin : 0, copied.size()));
+
+        for (size_t i = skip; i < copied.size(); i++)
+        {
+            const CpuProfileEvent& event = copied[i];
+            events.push_back({
+                {"name", event.name},
+                {"cat", "cpu"},
+                {"ph", "X"},
+                {"pid", 0},
+                {"tid", buffer->threadId},
+                {"ts", static_cast<int64_t>(event.begin - startTime) / 1000.0},
+                {"dur", (event.end - event.begin) / 1000.0}
+            });
+        }
+    }
+
+    nlohmann::json trace;
+    trace["traceEvents"] = std::move(events);
+    trace["displayTimeUnit"] = "ms";
+
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open " + path + " for the CPU trace!");
+    }
+    file << trace.dump();
+}
+
+#endif // VPP_CPU_PROFILER
@@ -0,0 +1,43 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+float DynamicResolution::update(float gpuFrameTime)
+{
+    if (gpuFrameTime <= 0.0f)
+    {
+        return scale;
+    }
+
+    smoothedFrameTime = smoothedFrameTime > 0.0f ? smoothedFrameTime + (gpuFrameTime - smoothedFrameTime) * 0.1f : gpuFrameTime;
+
+    if (!enabled)
+    {
+        return scale;
+    }
+
+    framesSinceChange++;
+
+    // Going over budget is corrected right away, spare time is only used once it has been stable
+    float ratio = targetFrameTime / smoothedFrameTime;
+    bool overBudget = ratio < 0.9f && framesSinceChange >= 2;
+    bool underBudget = ratio > 1.05f && framesSinceChange >= ADJUST_INTERVAL;
+
+    if (overBudget || underBudget)
+    {
+        // Most of the frame scales with the pixel count, which goes with the square of the scale
+        float desired = scale * std::sqrt(ratio);
+        float next = scale + (desired - scale) * 0.5f;
+
+        // Whole steps of 1/64 keep tiny corrections from changing the resolution every frame
+        next = std::clamp(std::round(next * 64.0f) / 64.0f, minScale, maxScale);
+
+        // Predict the new cost so the average doesn't keep pushing in the same direction while it catches up
+        smoothedFrameTime *= (next * next) / (scale * scale);
+        scale = next;
+        framesSinceChange = 0;
+    }
+
+    return scale;
+}
@@ -0,0 +1,155 @@
+#include "FrameContext.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+vpp::FrameContexts::FrameContexts(std::shared_ptr<Backend> backend, uint32_t maxFramesInFlight, uint32_t framesInFlight) :
+    backend(backend), framesInFlight(std::clamp(framesInFlight, 1u, maxFramesInFlight)), requestedFramesInFlight(this->framesInFlight)
+{
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo timelineSemaphoreInfo{};
+    timelineSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    timelineSemaphoreInfo.pNext = &timelineInfo;
+
+    if (vkCreateSemaphore(backend->device, &timelineSemaphoreInfo, nullptr, &timelineSemaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create frame timeline semaphore!");
+    }
+    backend->setNameOfObject(VK_OBJECT_TYPE_SEMAPHORE, (uint64_t)timelineSemaphore, "Frame timeline semaphore");
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    contexts.resize(maxFramesInFlight);
+    for (uint32_t i = 0; i < maxFramesInFlight; i++)
+    {
+        FrameContext& context = contexts[i];
+        context.index = i;
+        context.commandBuffer = backend->commandBuffers[i];
+
+        if (vkCreateSemaphore(backend->device, &semaphoreInfo, nullptr, &context.imageAvailableSemaphore) != VK_SUCCESS ||
+            vkCreateSemaphore(backend->device, &semaphoreInfo, nullptr, &context.renderFinishedSemaphore) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create synchronization objects for a frame!");
+        }
+    }
+}
+
+vpp::FrameContexts::~FrameContexts()
+{
+    for (FrameContext& context : contexts)
+    {
+        vkDestroySemaphore(backend->device, context.imageAvailableSemaphore, nullptr);
+        vkDestroySemaphore(backend->device, context.renderFinishedSemaphore, nullptr);
+    }
+
+    vkDestroySemaphore(backend->device, timelineSemaphore, nullptr);
+}
+
+vpp::FrameContext& vpp::FrameContexts::beginFrame()
+{
+    // Contexts map to frames by number, so changing the count needs every submitted frame retired first
+    if (requestedFramesInFlight != framesInFlight)
+    {
+        waitForFrame(submittedFrameNumber);
+        framesInFlight = requestedFramesInFlight;
+    }
+
+    frameNumber++;
+    currentIndex = static_cast<uint32_t>(frameNumber % framesInFlight);
+
+    FrameContext& context = contexts[currentIndex];
+    waitForFrame(context.frameNumber);
+
+    return context;
+}
+
+void vpp::FrameContexts::submit(VkQueue queue, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage, bool signalRenderFinished)
+{
+    FrameContext& context = contexts[currentIndex];
+
+    VkSemaphore signalSemaphores[] = { timelineSemaphore, context.renderFinishedSemaphore };
+    uint64_t signalValues[] = { frameNumber, 0 };
+    uint32_t signalSemaphoreCount = signalRenderFinished ? 2 : 1;
+
+    if (waitSemaphore != VK_NULL_HANDLE)
+    {
+        pendingWaits.push_back({ waitSemaphore, 0, waitStage });
+    }
+
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStages;
+    for (const SemaphoreWait& wait : pendingWaits)
+    {
+        waitSemaphores.push_back(wait.semaphore);
+        waitValues.push_back(wait.value);
+        waitStages.push_back(wait.stage);
+    }
+    pendingWaits.clear();
+
+    uint32_t waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = waitSemaphoreCount;
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = signalSemaphoreCount;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = waitSemaphoreCount;
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &context.commandBuffer;
+    submitInfo.signalSemaphoreCount = signalSemaphoreCount;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit draw command buffer!");
+    }
+
+    // Only set once submitted, a frame that was begun but never submitted must not be waited on
+    context.frameNumber = frameNumber;
+    submittedFrameNumber = frameNumber;
+}
+
+uint64_t vpp::FrameContexts::getCompletedFrameNumber() const
+{
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(backend->device, timelineSemaphore, &value);
+    return value;
+}
+
+bool vpp::FrameContexts::isFrameComplete(uint64_t frame) const
+{
+    return getCompletedFrameNumber() >= frame;
+}
+
+void vpp::FrameContexts::waitForFrame(uint64_t frame) const
+{
+    if (frame == 0)
+    {
+        return;
+    }
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timelineSemaphore;
+    waitInfo.pValues = &frame;
+
+    if (vkWaitSemaphores(backend->device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("failed to wait for frame " + std::to_string(frame) + "!");
+    }
+}
+
+void vpp::FrameContexts::setFramesInFlight(uint32_t count)
+{
+    requestedFramesInFlight = std::clamp(count, 1u, getMaxFramesInFlight());
+}
@@ -0,0 +1,60 @@
+#include "FramePacer.h"
+#include "CpuProfiler.h"
+
+const char* vpp::presentModeName(VkPresentModeKHR mode)
+{
+    switch (mode)
+    {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "Immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "Mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO relaxed";
+    default: return "Unknown";
+    }
+}
+
+vpp::FramePacer::FramePacer(std::shared_ptr<FrameContexts> frameContexts) :
+    frameContexts(frameContexts), inputTime(Clock::now())
+{
+}
+
+void vpp::FramePacer::waitForPreviousFrame()
+{
+    if (settings.lowLatency)
+    {
+        VPP_PROFILE_SCOPE("Wait for previous frame");
+        frameContexts->waitForFrame(frameContexts->getSubmittedFrameNumber());
+    }
+
+    update();
+}
+
+void vpp::FramePacer::sampleInput()
+{
+    inputTime = Clock::now();
+}
+
+void vpp::FramePacer::frameSubmitted(uint64_t frame)
+{
+    inputToSubmit = std::chrono::duration<double, std::milli>(Clock::now() - inputTime).count();
+    pendingFrames.push_back({ frame, inputTime });
+}
+
+void vpp::FramePacer::update()
+{
+    if (pendingFrames.empty())
+    {
+        return;
+    }
+
+    uint64_t completedFrame = frameContexts->getCompletedFrameNumber();
+    Clock::time_point now = Clock::now();
+
+    while (!pendingFrames.empty() && pendingFrames.front().frame <= completedFrame)
+    {
+        inputToGpu = std::chrono::duration<double, std::milli>(now - pendingFrames.front().inputTime).count();
+        latency = inputToGpu + presentDelay;
+        smoothedLatency = smoothedLatency > 0.0 ? smoothedLatency + (latency - smoothedLatency) * 0.1 : latency;
+        pendingFrames.pop_front();
+    }
+}
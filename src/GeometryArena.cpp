@@ -0,0 +1,285 @@
+#include "GeometryArena.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+bool vpp::GeometryArena::RangeAllocator::allocate(uint32_t count, uint32_t limit, uint32_t& offset)
+{
+    if (count == 0)
+    {
+        offset = 0;
+        return true;
+    }
+
+    for (auto it = freeRanges.begin(); it != freeRanges.end() && it->first + count <= limit; it++)
+    {
+        if (it->second < count)
+        {
+            continue;
+        }
+
+        offset = it->first;
+        uint32_t remaining = it->second - count;
+        freeRanges.erase(it);
+        if (remaining > 0)
+        {
+            freeRanges[offset + count] = remaining;
+        }
+
+        used += count;
+        return true;
+    }
+
+    return false;
+}
+
+void vpp::GeometryArena::RangeAllocator::free(uint32_t offset, uint32_t count)
+{
+    auto next = freeRanges.lower_bound(offset);
+
+    // Merge with the free ranges on either side
+    if (next != freeRanges.end() && offset + count == next->first)
+    {
+        count += next->second;
+        next = freeRanges.erase(next);
+    }
+    if (next != freeRanges.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            previous->second += count;
+            return;
+        }
+    }
+
+    freeRanges[offset] = count;
+}
+
+void vpp::GeometryArena::RangeAllocator::retire(uint32_t offset, uint32_t count, uint64_t frame)
+{
+    if (count > 0)
+    {
+        retiredRanges.push_back({ offset, count, frame });
+    }
+}
+
+void vpp::GeometryArena::RangeAllocator::collect(uint64_t completedFrame)
+{
+    auto firstPending = std::partition(retiredRanges.begin(), retiredRanges.end(), [completedFrame](const RetiredRange& retired) { return retired.frame <= completedFrame; });
+    for (auto it = retiredRanges.begin(); it != firstPending; it++)
+    {
+        free(it->offset, it->count);
+        used -= it->count;
+    }
+    retiredRanges.erase(retiredRanges.begin(), firstPending);
+}
+
+vpp::GeometryArena::GeometryArena(std::shared_ptr<Backend> backend, uint32_t vertexCapacity, uint32_t indexCapacity) :
+    backend(backend)
+{
+    vertexBuffer = std::make_shared<Buffer>(backend, VkDeviceSize(vertexCapacity) * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        vpp::GPU_ONLY, nullptr, "Geometry arena vertex buffer");
+    indexBuffer = std::make_shared<Buffer>(backend, VkDeviceSize(indexCapacity) * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        vpp::GPU_ONLY, nullptr, "Geometry arena index buffer");
+
+    vertices.capacity = vertexCapacity;
+    vertices.freeRanges[0] = vertexCapacity;
+    indices.capacity = indexCapacity;
+    indices.freeRanges[0] = indexCapacity;
+}
+
+vpp::GeometryHandle vpp::GeometryArena::add(const std::vector<Vertex>& vertexData, const std::vector<uint32_t>& indexData)
+{
+    VkDeviceSize vertexSize = vertexData.size() * sizeof(Vertex);
+    VkDeviceSize indexSize = indexData.size() * sizeof(uint32_t);
+
+    // Vertices first, then indices
+    std::shared_ptr<Buffer> stagingBuffer = std::make_shared<Buffer>(backend, std::max<VkDeviceSize>(vertexSize + indexSize, 1), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, vpp::CONTINOUS_TRANSFER, nullptr, "Geometry staging buffer");
+    memcpy(stagingBuffer->mappedPtr, vertexData.data(), vertexSize);
+    memcpy(static_cast<char*>(stagingBuffer->mappedPtr) + vertexSize, indexData.data(), indexSize);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    GeometryRange range;
+    range.vertexCount = static_cast<uint32_t>(vertexData.size());
+    range.indexCount = static_cast<uint32_t>(indexData.size());
+
+    if (!vertices.allocate(range.vertexCount, vertices.capacity, range.firstVertex))
+    {
+        throw std::runtime_error("Geometry arena is out of vertex space.");
+    }
+    if (!indices.allocate(range.indexCount, indices.capacity, range.firstIndex))
+    {
+        vertices.free(range.firstVertex, range.vertexCount);
+        vertices.used -= range.vertexCount;
+        throw std::runtime_error("Geometry arena is out of index space.");
+    }
+
+    GeometryHandle handle;
+    if (!freeHandles.empty())
+    {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+        ranges[handle] = range;
+        live[handle] = true;
+        resident[handle] = false;
+    }
+    else
+    {
+        handle = static_cast<GeometryHandle>(ranges.size());
+        ranges.push_back(range);
+        live.push_back(true);
+        resident.push_back(false);
+    }
+
+    pendingUploads.push_back({ handle, stagingBuffer });
+    return handle;
+}
+
+void vpp::GeometryArena::remove(GeometryHandle handle, uint64_t lastUsedFrame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (handle >= ranges.size()) throw std::runtime_error("Geometry handle was never allocated.");
+    if (!live[handle]) throw std::runtime_error("Geometry handle was already removed.");
+
+    std::erase_if(pendingUploads, [handle](const Upload& upload) { return upload.handle == handle; });
+
+    const GeometryRange& range = ranges[handle];
+    vertices.retire(range.firstVertex, range.vertexCount, lastUsedFrame);
+    indices.retire(range.firstIndex, range.indexCount, lastUsedFrame);
+
+    ranges[handle] = {};
+    live[handle] = false;
+    resident[handle] = false;
+    freeHandles.push_back(handle);
+}
+
+vpp::GeometryRange vpp::GeometryArena::getRange(GeometryHandle handle) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ranges[handle];
+}
+
+void vpp::GeometryArena::record(VkCommandBuffer commandBuffer, uint64_t frame)
+{
+    VPP_PROFILE_FUNCTION();
+    std::lock_guard<std::mutex> lock(mutex);
+
+    VkDeviceSize movedBefore = movedBytes;
+    bool recorded = !pendingUploads.empty();
+
+    // Moves only touch resident geometry, so they never overlap the uploads below
+    if (compaction)
+    {
+        compact(commandBuffer, frame);
+        recorded |= movedBytes != movedBefore;
+    }
+
+    for (Upload& upload : pendingUploads)
+    {
+        const GeometryRange& range = ranges[upload.handle];
+        VkDeviceSize vertexSize = VkDeviceSize(range.vertexCount) * sizeof(Vertex);
+
+        if (range.vertexCount > 0)
+        {
+            VkBufferCopy region{ 0, VkDeviceSize(range.firstVertex) * sizeof(Vertex), vertexSize };
+            vkCmdCopyBuffer(commandBuffer, upload.stagingBuffer->buffer, vertexBuffer->buffer, 1, &region);
+        }
+        if (range.indexCount > 0)
+        {
+            VkBufferCopy region{ vertexSize, VkDeviceSize(range.firstIndex) * sizeof(uint32_t), VkDeviceSize(range.indexCount) * sizeof(uint32_t) };
+            vkCmdCopyBuffer(commandBuffer, upload.stagingBuffer->buffer, indexBuffer->buffer, 1, &region);
+        }
+
+        resident[upload.handle] = true;
+        retiredStagingBuffers.push_back({ upload.stagingBuffer, frame });
+    }
+    pendingUploads.clear();
+
+    if (!recorded)
+    {
+        return;
+    }
+
+    // Later moves of the same data read and overwrite it too, not only the draws
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void vpp::GeometryArena::compact(VkCommandBuffer commandBuffer, uint64_t frame)
+{
+    std::vector<GeometryHandle> handles;
+    for (GeometryHandle handle = 0; handle < ranges.size(); handle++)
+    {
+        if (resident[handle])
+        {
+            handles.push_back(handle);
+        }
+    }
+
+    VkDeviceSize budget = compactionBudget;
+    std::vector<VkBufferCopy> vertexRegions;
+    std::vector<VkBufferCopy> indexRegions;
+
+    // The destination is a free hole and the source stays retired until the frame is done, so no copy overlaps another
+    std::sort(handles.begin(), handles.end(), [this](GeometryHandle a, GeometryHandle b) { return ranges[a].firstVertex > ranges[b].firstVertex; });
+    for (GeometryHandle handle : handles)
+    {
+        GeometryRange& range = ranges[handle];
+        VkDeviceSize size = VkDeviceSize(range.vertexCount) * sizeof(Vertex);
+        uint32_t offset;
+        if (range.vertexCount == 0 || size > budget || !vertices.allocate(range.vertexCount, range.firstVertex, offset))
+        {
+            continue;
+        }
+
+        vertexRegions.push_back({ VkDeviceSize(range.firstVertex) * sizeof(Vertex), VkDeviceSize(offset) * sizeof(Vertex), size });
+        vertices.retire(range.firstVertex, range.vertexCount, frame);
+        range.firstVertex = offset;
+        budget -= size;
+    }
+
+    std::sort(handles.begin(), handles.end(), [this](GeometryHandle a, GeometryHandle b) { return ranges[a].firstIndex > ranges[b].firstIndex; });
+    for (GeometryHandle handle : handles)
+    {
+        GeometryRange& range = ranges[handle];
+        VkDeviceSize size = VkDeviceSize(range.indexCount) * sizeof(uint32_t);
+        uint32_t offset;
+        if (range.indexCount == 0 || size > budget || !indices.allocate(range.indexCount, range.firstIndex, offset))
+        {
+            continue;
+        }
+
+        indexRegions.push_back({ VkDeviceSize(range.firstIndex) * sizeof(uint32_t), VkDeviceSize(offset) * sizeof(uint32_t), size });
+        indices.retire(range.firstIndex, range.indexCount, frame);
+        range.firstIndex = offset;
+        budget -= size;
+    }
+
+    if (!vertexRegions.empty())
+    {
+        vkCmdCopyBuffer(commandBuffer, vertexBuffer->buffer, vertexBuffer->buffer, static_cast<uint32_t>(vertexRegions.size()), vertexRegions.data());
+    }
+    if (!indexRegions.empty())
+    {
+        vkCmdCopyBuffer(commandBuffer, indexBuffer->buffer, indexBuffer->buffer, static_cast<uint32_t>(indexRegions.size()), indexRegions.data());
+    }
+
+    movedBytes += compactionBudget - budget;
+}
+
+void vpp::GeometryArena::collect(uint64_t completedFrame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    vertices.collect(completedFrame);
+    indices.collect(completedFrame);
+    std::erase_if(retiredStagingBuffers, [completedFrame](const RetiredStagingBuffer& retired) { return retired.frame <= completedFrame; });
+}
@@ -0,0 +1,259 @@
+#include "GpuProfiler.h"
+
+#include <array>
+#include <cfloat>
+#include <cstdio>
+#include <fstream>
+#include "imgui.h"
+#include <json.hpp>
+
+vpp::GpuProfiler::GpuProfiler(std::shared_ptr<Backend> backend, uint32_t framesInFlight) :
+    backend(backend), framesInFlight(framesInFlight)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(backend->physicalDevice, &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+
+    // Without this the graphics queue may not support timestamps at all
+    supported = properties.limits.timestampComputeAndGraphics == VK_TRUE;
+
+    slotScopes.resize(framesInFlight);
+    slotQueryCounts.resize(framesInFlight, 0);
+    slotCpuTimes.resize(framesInFlight, 0.0f);
+    slotFrameNumbers.resize(framesInFlight, 0);
+
+    if (supported)
+    {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = MAX_SCOPES * 2 * framesInFlight;
+
+        if (vkCreateQueryPool(backend->device, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create GPU profiler query pool!");
+        }
+        backend->setNameOfObject(VK_OBJECT_TYPE_QUERY_POOL, (uint64_t)queryPool, "GPU profiler query pool");
+    }
+
+    // Only present when the debug utils extension is enabled
+    beginLabel = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(backend->instance, "vkCmdBeginDebugUtilsLabelEXT");
+    endLabel = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(backend->instance, "vkCmdEndDebugUtilsLabelEXT");
+}
+
+vpp::GpuProfiler::~GpuProfiler()
+{
+    if (queryPool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(backend->device, queryPool, nullptr);
+    }
+}
+
+void vpp::GpuProfiler::readResults(uint32_t frameIndex)
+{
+    std::vector<Scope>& scopes = slotScopes[frameIndex];
+    uint32_t queryCount = slotQueryCounts[frameIndex];
+
+    if (!supported || scopes.empty() || queryCount == 0)
+    {
+        return;
+    }
+
+    std::array<uint64_t, MAX_SCOPES * 2> timestamps{};
+    VkResult result = vkGetQueryPoolResults(backend->device, queryPool, frameIndex * MAX_SCOPES * 2, queryCount,
+        queryCount * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+    if (result != VK_SUCCESS)
+    {
+        return;
+    }
+
+    GpuProfileFrame frame{};
+    frame.frameNumber = slotFrameNumbers[frameIndex];
+    frame.cpuTime = slotCpuTimes[frameIndex];
+
+    for (auto& history : histories)
+    {
+        history.second.latest = 0.0f;
+    }
+
+    for (const Scope& scope : scopes)
+    {
+        float time = static_cast<float>(static_cast<double>(timestamps[scope.endQuery] - timestamps[scope.beginQuery]) * timestampPeriod / 1e6);
+
+        if (histories.find(scope.name) == histories.end())
+        {
+            scopeOrder.push_back(scope.name);
+        }
+
+        // A scope can be opened several times per frame, those add up
+        ScopeHistory& history = histories[scope.name];
+        history.depth = scope.depth;
+        history.latest += time;
+
+        frame.scopes.push_back({ scope.name, time });
+    }
+
+    for (auto& history : histories)
+    {
+        history.second.values[historyOffset] = history.second.latest;
+    }
+    historyOffset = (historyOffset + 1) % HISTORY_LENGTH;
+
+    recordedFrames.push_back(std::move(frame));
+    if (recordedFrames.size() > MAX_RECORDED_FRAMES)
+    {
+        recordedFrames.pop_front();
+    }
+
+    scopes.clear();
+    slotQueryCounts[frameIndex] = 0;
+}
+
+void vpp::GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, float cpuFrameTime)
+{
+    currentSlot = frameIndex;
+    currentDepth = 0;
+    slotScopes[frameIndex].clear();
+    slotQueryCounts[frameIndex] = 0;
+    slotCpuTimes[frameIndex] = cpuFrameTime;
+    slotFrameNumbers[frameIndex] = frameNumber++;
+
+    if (supported)
+    {
+        vkCmdResetQueryPool(commandBuffer, queryPool, frameIndex * MAX_SCOPES * 2, MAX_SCOPES * 2);
+    }
+
+    frameScope = beginScope(commandBuffer, "Frame");
+}
+
+void vpp::GpuProfiler::endFrame(VkCommandBuffer commandBuffer)
+{
+    endScope(commandBuffer, frameScope);
+}
+
+uint32_t vpp::GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string& name, VkPipelineStageFlagBits stage)
+{
+    if (beginLabel)
+    {
+        VkDebugUtilsLabelEXT label{};
+        label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+        label.pLabelName = name.c_str();
+        beginLabel(commandBuffer, &label);
+    }
+
+    std::vector<Scope>& scopes = slotScopes[currentSlot];
+    uint32_t& queryCount = slotQueryCounts[currentSlot];
+
+    // Past the limit the label is still emitted, only the timing is dropped
+    if (!supported || scopes.size() >= MAX_SCOPES)
+    {
+        currentDepth++;
+        return UINT32_MAX;
+    }
+
+    Scope scope{ name, currentDepth++, queryCount++, 0 };
+    vkCmdWriteTimestamp(commandBuffer, stage, queryPool, currentSlot * MAX_SCOPES * 2 + scope.beginQuery);
+    scopes.push_back(scope);
+
+    return static_cast<uint32_t>(scopes.size() - 1);
+}
+
+void vpp::GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope, VkPipelineStageFlagBits stage)
+{
+    currentDepth--;
+
+    if (scope != UINT32_MAX)
+    {
+        Scope& entry = slotScopes[currentSlot][scope];
+        entry.endQuery = slotQueryCounts[currentSlot]++;
+        vkCmdWriteTimestamp(commandBuffer, stage, queryPool, currentSlot * MAX_SCOPES * 2 + entry.endQuery);
+    }
+
+    if (endLabel)
+    {
+        endLabel(commandBuffer);
+    }
+}
+
+float vpp::GpuProfiler::getTime(const std::string& name) const
+{
+    auto it = histories.find(name);
+    return it != histories.end() ? it->second.latest : 0.0f;
+}
+
+std::vector<std::pair<std::string, float>> vpp::GpuProfiler::getLatestTimes() const
+{
+    std::vector<std::pair<std::string, float>> times;
+    for (const std::string& name : scopeOrder)
+    {
+        times.push_back({ name, histories.at(name).latest });
+    }
+    return times;
+}
+
+void vpp::GpuProfiler::drawImGui()
+{
+    if (!ImGui::CollapsingHeader("GPU Profiler"))
+    {
+        return;
+    }
+
+    if (!supported)
+    {
+        ImGui::Text("Timestamps are not supported on this queue");
+        return;
+    }
+
+    for (const std::string& name : scopeOrder)
+    {
+        const ScopeHistory& history = histories[name];
+        char overlay[32];
+        snprintf(overlay, sizeof(overlay), "%.3f ms", history.latest);
+
+        ImGui::Indent(static_cast<float>(history.depth) * 8.0f + 1.0f);
+        ImGui::PlotLines(name.c_str(), history.values.data(), HISTORY_LENGTH, historyOffset, overlay, 0.0f, FLT_MAX, ImVec2(0.0f, 32.0f));
+        ImGui::Unindent(static_cast<float>(history.depth) * 8.0f + 1.0f);
+    }
+
+    if (ImGui::Button("Export GPU Profile"))
+    {
+        exportTrace("gpu_profile.json");
+    }
+    ImGui::SameLine();
+    ImGui::Text("%zu frames recorded", recordedFrames.size());
+}
+
+void vpp::GpuProfiler::exportTrace(const std::string& path) const
+{
+    nlohmann::json frames = nlohmann::json::array();
+
+    for (const GpuProfileFrame& frame : recordedFrames)
+    {
+        nlohmann::json scopes = nlohmann::json::array();
+        for (const auto& scope : frame.scopes)
+        {
+            scopes.push_back({ { "name", scope.first }, { "gpuMs", scope.second } });
+        }
+
+        frames.push_back({ { "frame", frame.frameNumber }, { "cpuMs", frame.cpuTime }, { "scopes", scopes } });
+    }
+
+    nlohmann::json trace = { { "timestampPeriodNs", timestampPeriod }, { "frames", frames } };
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open " + path + " for writing!");
+    }
+    file << trace.dump(2);
+}
+
+vpp::GpuProfileScope::GpuProfileScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const std::string& name) :
+    profiler(profiler), commandBuffer(commandBuffer)
+{
+    scope = profiler.beginScope(commandBuffer, name);
+}
+
+vpp::GpuProfileScope::~GpuProfileScope()
+{
+    profiler.endScope(commandBuffer, scope);
+}
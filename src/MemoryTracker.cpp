@@ -0,0 +1,263 @@
+#include "MemoryTracker.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include "imgui.h"
+#include <json.hpp>
+
+static constexpr double MB = 1024.0 * 1024.0;
+
+const char* vpp::memoryCategoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MEMORY_GEOMETRY: return "Geometry";
+    case MEMORY_TEXTURES: return "Textures";
+    case MEMORY_RENDER_TARGETS: return "Render targets";
+    case MEMORY_STAGING: return "Staging";
+    case MEMORY_UNIFORMS: return "Uniforms";
+    default: return "Other";
+    }
+}
+
+vpp::MemoryCategory vpp::bufferMemoryCategory(VkBufferUsageFlags usage, BufferType type)
+{
+    if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+        return MEMORY_GEOMETRY;
+
+    if (type == CONTINOUS_TRANSFER && (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT))
+        return MEMORY_STAGING;
+
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+        return MEMORY_UNIFORMS;
+
+    return MEMORY_OTHER;
+}
+
+vpp::MemoryCategory vpp::imageMemoryCategory(VkImageUsageFlags usage)
+{
+    if (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT))
+        return MEMORY_RENDER_TARGETS;
+
+    if (usage & VK_IMAGE_USAGE_SAMPLED_BIT)
+        return MEMORY_TEXTURES;
+
+    return MEMORY_OTHER;
+}
+
+vpp::MemoryTracker::MemoryTracker(VkPhysicalDevice physicalDevice, bool budgetSupported) :
+    physicalDevice(physicalDevice), budgetSupported(budgetSupported)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    heapTrackedSizes.resize(memoryProperties.memoryHeapCount, 0);
+    heapPeakUsages.resize(memoryProperties.memoryHeapCount, 0);
+}
+
+void vpp::MemoryTracker::add(MemoryUsage& usage, VkDeviceSize size)
+{
+    usage.size += size;
+    usage.peakSize = std::max(usage.peakSize, usage.size);
+    usage.allocationCount++;
+}
+
+void vpp::MemoryTracker::remove(MemoryUsage& usage, VkDeviceSize size)
+{
+    usage.size -= size;
+    usage.allocationCount--;
+}
+
+void vpp::MemoryTracker::allocated(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, MemoryCategory category, const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    allocations[memory] = { size, heapIndex, category, name };
+
+    add(categories[category], size);
+    add(total, size);
+    add(names[name], size);
+    heapTrackedSizes[heapIndex] += size;
+}
+
+void vpp::MemoryTracker::freed(VkDeviceMemory memory)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = allocations.find(memory);
+    if (it == allocations.end())
+    {
+        return;
+    }
+
+    const Allocation& allocation = it->second;
+    remove(categories[allocation.category], allocation.size);
+    remove(total, allocation.size);
+    remove(names[allocation.name], allocation.size);
+    heapTrackedSizes[allocation.heapIndex] -= allocation.size;
+    allocations.erase(it);
+}
+
+vpp::MemoryUsage vpp::MemoryTracker::getUsage(MemoryCategory category) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return categories[category];
+}
+
+vpp::MemoryUsage vpp::MemoryTracker::getTotalUsage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return total;
+}
+
+std::vector<vpp::MemoryHeapInfo> vpp::MemoryTracker::queryHeaps()
+{
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = budgetSupported ? &budgetProperties : nullptr;
+    vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    heaps.resize(memoryProperties.memoryHeapCount);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    {
+        MemoryHeapInfo& heap = heaps[i];
+        heap.size = memoryProperties.memoryHeaps[i].size;
+        heap.deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heap.trackedSize = heapTrackedSizes[i];
+        heap.budget = budgetSupported ? budgetProperties.heapBudget[i] : heap.size;
+        heap.usage = budgetSupported ? budgetProperties.heapUsage[i] : heap.trackedSize;
+
+        heapPeakUsages[i] = std::max(heapPeakUsages[i], heap.usage);
+        heap.peakUsage = heapPeakUsages[i];
+    }
+
+    return heaps;
+}
+
+std::vector<vpp::MemoryHeapInfo> vpp::MemoryTracker::getHeaps() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return heaps;
+}
+
+void vpp::MemoryTracker::drawImGui()
+{
+    if (!ImGui::CollapsingHeader("GPU Memory"))
+    {
+        return;
+    }
+
+    std::vector<MemoryHeapInfo> sampledHeaps = getHeaps();
+    for (size_t i = 0; i < sampledHeaps.size(); i++)
+    {
+        const MemoryHeapInfo& heap = sampledHeaps[i];
+        ImGui::Text("Heap %zu (%s): %.1f / %.1f MB, peak %.1f MB, %.1f MB ours", i, heap.deviceLocal ? "VRAM" : "system",
+            heap.usage / MB, heap.budget / MB, heap.peakUsage / MB, heap.trackedSize / MB);
+    }
+
+    if (!budgetSupported)
+    {
+        ImGui::Text("No VK_EXT_memory_budget, heap usage is our allocations only");
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    ImGui::Text("Tracked: %.1f MB in %u allocations, peak %.1f MB", total.size / MB, total.allocationCount, total.peakSize / MB);
+
+    if (ImGui::BeginTable("Memory categories", 4, ImGuiTableFlags_RowBg))
+    {
+        ImGui::TableSetupColumn("Category");
+        ImGui::TableSetupColumn("MB");
+        ImGui::TableSetupColumn("Peak MB");
+        ImGui::TableSetupColumn("Allocations");
+        ImGui::TableHeadersRow();
+
+        for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+        {
+            const MemoryUsage& usage = categories[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%s", memoryCategoryName(MemoryCategory(i)));
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", usage.size / MB);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", usage.peakSize / MB);
+            ImGui::TableNextColumn(); ImGui::Text("%u", usage.allocationCount);
+        }
+
+        ImGui::EndTable();
+    }
+
+    if (ImGui::TreeNode("By name"))
+    {
+        // Largest first, names that are gone but had a peak stay visible for leak hunting
+        std::vector<std::pair<std::string, MemoryUsage>> sorted(names.begin(), names.end());
+        std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.size > b.second.size; });
+
+        if (ImGui::BeginTable("Memory names", 4, ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Name");
+            ImGui::TableSetupColumn("MB");
+            ImGui::TableSetupColumn("Peak MB");
+            ImGui::TableSetupColumn("Allocations");
+            ImGui::TableHeadersRow();
+
+            for (const auto& [name, usage] : sorted)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::Text("%s", name.c_str());
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", usage.size / MB);
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", usage.peakSize / MB);
+                ImGui::TableNextColumn(); ImGui::Text("%u", usage.allocationCount);
+            }
+
+            ImGui::EndTable();
+        }
+
+        ImGui::TreePop();
+    }
+
+    if (ImGui::Button("Export GPU Memory"))
+    {
+        exportJson("gpu_memory.json");
+    }
+}
+
+void vpp::MemoryTracker::exportJson(const std::string& path)
+{
+    auto usageJson = [](const MemoryUsage& usage) {
+        return nlohmann::json{ { "bytes", usage.size }, { "peakBytes", usage.peakSize }, { "allocations", usage.allocationCount } };
+    };
+
+    nlohmann::json heapsJson = nlohmann::json::array();
+    for (const MemoryHeapInfo& heap : queryHeaps())
+    {
+        heapsJson.push_back({ { "size", heap.size }, { "budget", heap.budget }, { "usage", heap.usage }, { "peakUsage", heap.peakUsage },
+            { "trackedBytes", heap.trackedSize }, { "deviceLocal", heap.deviceLocal } });
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    nlohmann::json categoriesJson = nlohmann::json::object();
+    for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+    {
+        categoriesJson[memoryCategoryName(MemoryCategory(i))] = usageJson(categories[i]);
+    }
+
+    nlohmann::json namesJson = nlohmann::json::object();
+    for (const auto& [name, usage] : names)
+    {
+        namesJson[name] = usageJson(usage);
+    }
+
+    nlohmann::json report = { { "budgetSupported", budgetSupported }, { "heaps", heapsJson }, { "total", usageJson(total) },
+        { "categories", categoriesJson }, { "names", namesJson } };
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open " + path + " for writing!");
+    }
+    file << report.dump(2);
+}
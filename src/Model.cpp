@@ -1,6 +1,7 @@
 #include "Model.h"
 
 #include <stdexcept>
+#include "CpuProfiler.h"
 
 glm::mat4 convertMatrix(const aiMatrix4x4& aiMat)
 {
@@ -27,39 +28,40 @@ void vpp::Model::processNode(aiNode* node, const aiScene* scene, glm::mat4 paren
     }
 }
 
-glm::mat4 vpp::Model::getModelMatrix()
-{
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, position);
-    model = glm::rotate(model, glm::radians(rotationAngleAxis.first), rotationAngleAxis.second);
-    model = glm::scale(model, scale);
-	return model;
-}
-
 vpp::Model::Model(std::string path, std::shared_ptr<vpp::Backend> backend, TextureType textureType) :
     backend(backend), path(path), directory(path.substr(0, path.find_last_of('/'))), textureType(textureType)
 {
+    if (finished && textureType == FLAT_COLOR)
+    {
+        throw std::runtime_error("Flat color models have to be loaded before finishLoadingModels");
+    }
+
     if (!initialized)
     {
         defaultImage = std::make_shared<Image>(backend, 1, 1, 1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Default image");
         defaultImageView = std::make_shared<ImageView>(backend, defaultImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Default Image View");
+        defaultOrmImageView = createDefaultOrmView(backend, defaultImage);
         defaultBuffer = std::make_shared<Buffer>(backend, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vpp::GPU_ONLY, nullptr, "Default SSBO");
+        bindlessHeap = std::make_shared<BindlessHeap>(backend, MAX_BINDLESS_TEXTURES, MAX_BINDLESS_BUFFERS);
+        geometryArena = std::make_shared<GeometryArena>(backend, GEOMETRY_ARENA_VERTICES, GEOMETRY_ARENA_INDICES);
 
         // transition default image
         backend->transitionImageLayout(defaultImage->image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
     }
 
-    position = glm::vec3(0.0f);
-    scale = glm::vec3(1.0f);
-    rotationAngleAxis = { 0.0f, glm::vec3(0.0f, 1.0f, 0.0f) };
+    VPP_PROFILE_SCOPE("Model load");
 
     Assimp::Importer importer;
 
-    const aiScene* scene = importer.ReadFile(path,
-        aiProcess_CalcTangentSpace |
-        aiProcess_Triangulate |
-        aiProcess_JoinIdenticalVertices |
-        aiProcess_SortByPType);
+    const aiScene* scene;
+    {
+        VPP_PROFILE_SCOPE("Model import");
+        scene = importer.ReadFile(path,
+            aiProcess_CalcTangentSpace |
+            aiProcess_Triangulate |
+            aiProcess_JoinIdenticalVertices |
+            aiProcess_SortByPType);
+    }
 
     std::cout << scene->HasTextures() << std::endl;
 
@@ -73,9 +75,14 @@ vpp::Model::Model(std::string path, std::shared_ptr<vpp::Backend> backend, Textu
         throw std::runtime_error("Failed to load model");
     }
 
-    // Populate vertices and indices
+    size_t firstMaterial = albedoImageViews.size();
+
+    // Populate vertices and indices, relative to the model's range in the geometry arena
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
     for (unsigned int i = 0; i < scene->mNumMeshes; i++) 
     {
+        VPP_PROFILE_SCOPE("Model mesh");
 		const aiMesh* aiMesh = scene->mMeshes[i];
 
         Mesh mesh;
@@ -87,12 +94,11 @@ vpp::Model::Model(std::string path, std::shared_ptr<vpp::Backend> backend, Textu
         mesh.startIndex = indices.size();
         meshes.push_back(mesh);
 
-        uint32_t indexBias = vertices.size();
-
         for (unsigned int j = 0; j < aiMesh->mNumVertices; j++) 
         {
 			Vertex vertex = {};
 			vertex.pos = glm::vec3(aiMesh->mVertices[j].x, aiMesh->mVertices[j].y, aiMesh->mVertices[j].z);
+			meshes.back().bounds.expand(vertex.pos);
 			vertex.normal = glm::vec3(aiMesh->mNormals[j].x, aiMesh->mNormals[j].y, aiMesh->mNormals[j].z);
             if (aiMesh->mTextureCoords[0]) {
 				vertex.texCoord = aiMesh->HasTextureCoords(0) ? glm::vec2(aiMesh->mTextureCoords[0][j].x, 1-aiMesh->mTextureCoords[0][j].y) : glm::vec2(0.0f, 0.0f);
@@ -111,7 +117,7 @@ vpp::Model::Model(std::string path, std::shared_ptr<vpp::Backend> backend, Textu
 
             for (unsigned int k = 0; k < face.mNumIndices; k++) 
             {
-				indices.push_back(face.mIndices[k] + indexBias);
+				indices.push_back(face.mIndices[k]);
 			}
 		}
 	}
@@ -123,6 +129,7 @@ vpp::Model::Model(std::string path, std::shared_ptr<vpp::Backend> backend, Textu
 
         for (unsigned int i = 0; i < scene->mNumTextures; i++)
         {
+            VPP_PROFILE_SCOPE("Model embedded texture");
 			aiTexture* texture = scene->mTextures[i];
 			
             // if compressed
@@ -140,8 +147,12 @@ vpp::Model::Model(std::string path, std::shared_ptr<vpp::Backend> backend, Textu
         mipLevels.resize(mipLevels.size() + scene->mNumMaterials);
     }
 
+    VkDeviceSize modelOrmSize = 0;
+    VkDeviceSize modelUnpackedOrmSize = 0;
+
     for (unsigned int i = 0; i < scene->mNumMaterials; i++)
     {
+        VPP_PROFILE_SCOPE("Model material");
         const aiMaterial* material = scene->mMaterials[i];
         
         if (textureType == FLAT_COLOR)
@@ -195,53 +206,77 @@ vpp::Model::Model(std::string path, std::shared_ptr<vpp::Backend> backend, Textu
                 albedoImageViews.push_back(defaultImageView);
             }
 
-            //metallic
-            if (material->GetTextureCount(aiTextureType_METALNESS) > 0)
+            // metallic, roughness and occlusion share one packed texture
+            if (textureType == TEXTURE)
             {
-                if (material->GetTexture(aiTextureType_METALNESS, 0, &Path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS)
-                {
-					std::string FullPath = directory + "/" + Path.data;
+                auto texturePath = [&](aiTextureType type) -> std::string {
+                    if (material->GetTextureCount(type) == 0)
+                        return "";
 
-					vpp::TextureImageCreationResults results = backend->createTextureImage(FullPath, &mipLevels[i]);
-					metallicImages.push_back(results.image);
-					metallicImageViews.push_back(results.imageView);
-				}
-                else
-                {
-					throw std::runtime_error("Texture path retrieval failed");
-				}
-			}
-            else
-            {
-                std::cout << "No metallic texture found for material " << i << std::endl;
-                metallicImages.push_back(defaultImage);
-                metallicImageViews.push_back(defaultImageView);
-            }
+                    if (material->GetTexture(type, 0, &Path, NULL, NULL, NULL, NULL, NULL) != AI_SUCCESS)
+                        throw std::runtime_error("Texture path retrieval failed");
 
-            //roughness
-            if (material->GetTextureCount(aiTextureType_DIFFUSE_ROUGHNESS) > 0)
-            {
-                if (material->GetTexture(aiTextureType_DIFFUSE_ROUGHNESS, 0, &Path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS)
-                {
-                    std::string FullPath = directory + "/" + Path.data;
+                    return directory + "/" + Path.data;
+                };
 
-                    vpp::TextureImageCreationResults results = backend->createTextureImage(FullPath, &mipLevels[i]);
-                    roughnessImages.push_back(results.image);
-                    roughnessImageViews.push_back(results.imageView);
+                std::string metallicPath = texturePath(aiTextureType_METALNESS);
+                std::string roughnessPath = texturePath(aiTextureType_DIFFUSE_ROUGHNESS);
+                std::string occlusionPath = texturePath(aiTextureType_LIGHTMAP);
+                if (occlusionPath.empty())
+                {
+                    occlusionPath = texturePath(aiTextureType_AMBIENT_OCCLUSION);
                 }
-                else
+
+                // Older importers only report glTF's metallicRoughness map as an unknown texture
+                if (metallicPath.empty() && roughnessPath.empty())
                 {
-                    throw std::runtime_error("Texture path retrieval failed");
+                    metallicPath = roughnessPath = texturePath(aiTextureType_UNKNOWN);
                 }
+
+                // glTF combined map: occlusion in R, roughness in G, metallic in B
+                bool combined = !metallicPath.empty() && metallicPath == roughnessPath;
+
+                vpp::OrmSources sources;
+                sources[ORM_OCCLUSION] = { occlusionPath, 0 };
+                sources[ORM_ROUGHNESS] = { roughnessPath, combined ? 1u : 0u };
+                sources[ORM_METALLIC] = { metallicPath, combined ? 2u : 0u };
+
+                vpp::PackedTexture orm = createOrmTexture(backend, sources, "ORM texture");
+                ormImages.push_back(orm.channelCount > 0 ? orm.image : defaultImage);
+                ormImageViews.push_back(orm.channelCount > 0 ? orm.imageView : defaultOrmImageView);
+                modelOrmSize += orm.size;
+                modelUnpackedOrmSize += orm.unpackedSize;
             }
             else
             {
-                std::cout << "No roughness texture found for material " << i << std::endl;
-                roughnessImages.push_back(defaultImage);
-                roughnessImageViews.push_back(defaultImageView);
+                ormImages.push_back(defaultImage);
+                ormImageViews.push_back(defaultOrmImageView);
             }
         }
     }
 
+    // Negative when occlusion maps cost more than packing saved on metallic and roughness
+    if (modelOrmSize > 0)
+    {
+        std::cout << "Packed ORM textures of " << path << ": " << modelOrmSize / (1024.0 * 1024.0) << " MB, "
+            << (double(modelUnpackedOrmSize) - double(modelOrmSize)) / (1024.0 * 1024.0) << " MB saved over separate RGBA8 metallic and roughness maps" << std::endl;
+    }
+
+    ormTextureSize += modelOrmSize;
+    unpackedOrmTextureSize += modelUnpackedOrmSize;
+
+    geometry = geometryArena->add(vertices, indices);
+
+    if (finished)
+    {
+        createMaterialSlots(firstMaterial);
+    }
+
     initialized = true;
+}
+
+void vpp::Model::unload(uint64_t lastUsedFrame)
+{
+    geometryArena->remove(geometry, lastUsedFrame);
+    geometry = GeometryArena::INVALID_GEOMETRY;
 }
\ No newline at end of file
@@ -153,6 +153,12 @@ vpp::GraphicsPipeline::~GraphicsPipeline()
 }
 
 void vpp::GraphicsPipeline::addShaderStage(VkShaderStageFlagBits stage, std::string path)
+{
+    addShaderStage(stage, path, nullptr);
+}
+
+// specializationInfo has to stay alive until createPipeline is called
+void vpp::GraphicsPipeline::addShaderStage(VkShaderStageFlagBits stage, std::string path, const VkSpecializationInfo* specializationInfo)
 {
     auto shaderCode = vpp::Backend::readFile(path);
     shaderModules.push_back(backend->createShaderModule(shaderCode));
@@ -163,6 +169,7 @@ void vpp::GraphicsPipeline::addShaderStage(VkShaderStageFlagBits stage, std::str
     shaderStageInfo.stage = stage;
     shaderStageInfo.module = shaderModules[shaderModules.size() - 1];
     shaderStageInfo.pName = "main";
+    shaderStageInfo.pSpecializationInfo = specializationInfo;
     shaderStages.push_back(shaderStageInfo);
 }
 
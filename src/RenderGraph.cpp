@@ -0,0 +1,525 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static VkAccessFlags2 writeAccessOf(VkAccessFlags2 access)
+{
+    return access & (VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
+}
+
+static VkImageAspectFlags aspectOf(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+vpp::RenderGraph::RenderGraph(std::shared_ptr<Backend> backend) :
+    backend(backend)
+{
+}
+
+vpp::RenderGraph::~RenderGraph()
+{
+    passes.clear();
+    resources.clear();
+
+    for (MemoryBlock& block : memoryBlocks)
+    {
+        backend->freeMemory(block.memory);
+    }
+}
+
+vpp::RenderGraphResource vpp::RenderGraph::createImage(std::string name, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage)
+{
+    if (allocated)
+    {
+        throw std::runtime_error("render graph images must be created before allocate!");
+    }
+
+    Resource resource;
+    resource.name = name;
+    resource.transient = true;
+    resource.transientImage = std::make_shared<Image>(backend, width, height, 1, mipLevels, format, usage, name);
+    resource.image = resource.transientImage->image;
+    resource.mipLevels = mipLevels;
+    resource.aspect = aspectOf(format);
+    resources.push_back(resource);
+
+    return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+vpp::RenderGraphResource vpp::RenderGraph::importImage(std::string name, VkImage image, uint32_t mipLevels, VkImageAspectFlags aspect, VkImageLayout layout)
+{
+    Resource resource;
+    resource.name = name;
+    resource.image = image;
+    resource.mipLevels = mipLevels;
+    resource.aspect = aspect;
+    resource.state.layout = layout;
+    resources.push_back(resource);
+
+    return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+vpp::RenderGraphResource vpp::RenderGraph::importBuffer(std::string name, std::shared_ptr<Buffer> buffer)
+{
+    Resource resource;
+    resource.name = name;
+    resource.buffer = buffer;
+    resources.push_back(resource);
+
+    return static_cast<RenderGraphResource>(resources.size() - 1);
+}
+
+void vpp::RenderGraph::setImage(RenderGraphResource resource, VkImage image, uint32_t mipLevels, VkImageLayout layout)
+{
+    Resource& imported = resources.at(resource);
+    if (imported.transient || imported.buffer)
+    {
+        throw std::runtime_error("only imported images can be replaced in the render graph!");
+    }
+
+    imported.image = image;
+    imported.mipLevels = mipLevels;
+    imported.state = ResourceState{};
+    imported.state.layout = layout;
+}
+
+std::shared_ptr<vpp::Image> vpp::RenderGraph::getImage(RenderGraphResource resource) const
+{
+    return resources.at(resource).transientImage;
+}
+
+void vpp::RenderGraph::reset()
+{
+    passes.clear();
+}
+
+vpp::RenderGraphPass vpp::RenderGraph::addPass(std::string name, uint32_t batch, std::function<void(VkCommandBuffer)> record, bool enabled)
+{
+    Pass pass;
+    pass.name = name;
+    pass.batch = batch;
+    pass.record = record;
+    pass.enabled = enabled;
+    passes.push_back(pass);
+
+    return static_cast<RenderGraphPass>(passes.size() - 1);
+}
+
+void vpp::RenderGraph::read(RenderGraphPass pass, RenderGraphResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout)
+{
+    addAccess(pass, resource, stages, access, layout, false);
+}
+
+void vpp::RenderGraph::write(RenderGraphPass pass, RenderGraphResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout)
+{
+    addAccess(pass, resource, stages, access, layout, true);
+}
+
+void vpp::RenderGraph::keep(RenderGraphPass pass)
+{
+    passes.at(pass).kept = true;
+}
+
+void vpp::RenderGraph::addAccess(RenderGraphPass pass, RenderGraphResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout, bool write)
+{
+    Pass& declaringPass = passes.at(pass);
+    bool isImage = !resources.at(resource).buffer;
+
+    if (isImage && layout == VK_IMAGE_LAYOUT_UNDEFINED)
+    {
+        throw std::runtime_error("render graph pass " + declaringPass.name + " needs a layout for " + resources[resource].name + "!");
+    }
+
+    // A pass that reads and writes a resource gets one barrier covering both
+    for (Access& existing : declaringPass.accesses)
+    {
+        if (existing.resource == resource)
+        {
+            if (isImage && existing.layout != layout)
+            {
+                throw std::runtime_error("render graph pass " + declaringPass.name + " uses " + resources[resource].name + " in two layouts!");
+            }
+
+            existing.stages |= stages;
+            existing.access |= access;
+            existing.read |= !write;
+            existing.write |= write;
+            return;
+        }
+    }
+
+    declaringPass.accesses.push_back({ resource, stages, access, isImage ? layout : VK_IMAGE_LAYOUT_UNDEFINED, !write, write });
+}
+
+void vpp::RenderGraph::allocate()
+{
+    if (allocated)
+    {
+        throw std::runtime_error("render graph memory is already allocated!");
+    }
+
+    // Lifetimes in declaration order, a transient nobody uses keeps its memory to itself
+    std::vector<uint32_t> firstUse(resources.size(), UINT32_MAX);
+    std::vector<uint32_t> lastUse(resources.size(), 0);
+    for (uint32_t i = 0; i < passes.size(); i++)
+    {
+        for (const Access& access : passes[i].accesses)
+        {
+            firstUse[access.resource] = std::min(firstUse[access.resource], i);
+            lastUse[access.resource] = std::max(lastUse[access.resource], i);
+        }
+    }
+
+    struct TransientRequirements
+    {
+        RenderGraphResource resource;
+        VkMemoryRequirements requirements;
+    };
+
+    std::vector<TransientRequirements> transients;
+    for (RenderGraphResource i = 0; i < resources.size(); i++)
+    {
+        if (!resources[i].transient)
+        {
+            continue;
+        }
+
+        if (firstUse[i] == UINT32_MAX)
+        {
+            firstUse[i] = 0;
+            lastUse[i] = static_cast<uint32_t>(passes.size());
+        }
+
+        TransientRequirements transient{ i };
+        vkGetImageMemoryRequirements(backend->device, resources[i].image, &transient.requirements);
+        transients.push_back(transient);
+        stats.unaliasedTransientMemory += transient.requirements.size;
+    }
+
+    // Largest first, so the smaller images fill the blocks the large ones opened
+    std::sort(transients.begin(), transients.end(), [](const TransientRequirements& a, const TransientRequirements& b) {
+        return a.requirements.size > b.requirements.size;
+    });
+
+    for (const TransientRequirements& transient : transients)
+    {
+        RenderGraphResource resource = transient.resource;
+        uint32_t blockIndex = static_cast<uint32_t>(memoryBlocks.size());
+
+        for (uint32_t i = 0; i < memoryBlocks.size() && blockIndex == memoryBlocks.size(); i++)
+        {
+            if ((memoryBlocks[i].memoryTypeBits & transient.requirements.memoryTypeBits) == 0)
+            {
+                continue;
+            }
+
+            bool overlaps = false;
+            for (RenderGraphResource occupant : memoryBlocks[i].resources)
+            {
+                overlaps |= firstUse[resource] <= lastUse[occupant] && firstUse[occupant] <= lastUse[resource];
+            }
+
+            if (!overlaps)
+            {
+                blockIndex = i;
+            }
+        }
+
+        if (blockIndex == memoryBlocks.size())
+        {
+            memoryBlocks.push_back(MemoryBlock{});
+        }
+
+        // Everything is bound at offset 0, which satisfies any alignment
+        MemoryBlock& block = memoryBlocks[blockIndex];
+        block.size = std::max(block.size, transient.requirements.size);
+        block.memoryTypeBits &= transient.requirements.memoryTypeBits;
+        block.resources.push_back(resource);
+        resources[resource].memoryBlock = blockIndex;
+    }
+
+    for (MemoryBlock& block : memoryBlocks)
+    {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = block.size;
+        allocInfo.memoryTypeIndex = backend->findMemoryType(block.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        if (backend->allocateMemory(allocInfo, block.memory, MEMORY_RENDER_TARGETS, "Render graph memory block") != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate render graph memory!");
+        }
+
+        for (RenderGraphResource resource : block.resources)
+        {
+            vkBindImageMemory(backend->device, resources[resource].image, block.memory, 0);
+        }
+
+        stats.transientMemory += block.size;
+    }
+
+    allocated = true;
+}
+
+// Walks back from the kept passes, a pass lives when a live pass after it reads something it writes.
+// Partial writes can't be told apart from full ones, so earlier writers of a resource stay alive too.
+std::vector<bool> vpp::RenderGraph::findLivePasses() const
+{
+    std::vector<bool> live(passes.size(), false);
+    std::vector<bool> needed(resources.size(), false);
+
+    for (size_t i = passes.size(); i-- > 0;)
+    {
+        const Pass& pass = passes[i];
+        if (!pass.enabled)
+        {
+            continue;
+        }
+
+        bool isLive = pass.kept;
+        for (const Access& access : pass.accesses)
+        {
+            isLive |= access.write && needed[access.resource];
+        }
+
+        if (!isLive)
+        {
+            continue;
+        }
+
+        live[i] = true;
+        for (const Access& access : pass.accesses)
+        {
+            if (access.read)
+            {
+                needed[access.resource] = true;
+            }
+        }
+    }
+
+    return live;
+}
+
+void vpp::RenderGraph::addBarrier(const Access& access, uint32_t queue, std::vector<VkImageMemoryBarrier2>& imageBarriers, std::vector<VkBufferMemoryBarrier2>& bufferBarriers)
+{
+    Resource& resource = resources[access.resource];
+    ResourceState& state = resource.state;
+    bool isImage = !resource.buffer;
+
+    if (isImage && resource.image == VK_NULL_HANDLE)
+    {
+        throw std::runtime_error("render graph image " + resource.name + " has no image set!");
+    }
+
+    VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE;
+    VkImageLayout oldLayout = state.layout;
+    bool barrier = false;
+    bool restarted = false;	// nothing before the barrier matters to later accesses on this queue
+
+    if (resource.transient && state.queue == NO_QUEUE)
+    {
+        // First use this frame, the contents are undefined and the memory may still be in use by another image
+        MemoryBlock& block = memoryBlocks[resource.memoryBlock];
+        oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (block.queue == queue)
+        {
+            srcStages = block.stages;
+            srcAccess = block.writeAccess;
+        }
+        else if (block.queue != NO_QUEUE)
+        {
+            srcStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        }
+        barrier = true;
+        restarted = true;
+    }
+    else if (state.queue != queue)
+    {
+        // Another queue or an unknown user, the semaphore made its writes available, this chains onto the wait.
+        // An unknown user may also be an earlier graph on this queue, its writes are made available here.
+        srcStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        srcAccess = state.queue == NO_QUEUE ? VK_ACCESS_2_MEMORY_WRITE_BIT : VK_ACCESS_2_NONE;
+        barrier = true;
+        restarted = true;
+    }
+    else if ((isImage && access.layout != state.layout) || access.write)
+    {
+        // Reads since the last write already waited on it, so a write after them only needs execution order
+        if (access.layout != state.layout || state.readStages == VK_PIPELINE_STAGE_2_NONE)
+        {
+            srcStages = state.writeStages | state.readStages;
+            srcAccess = state.writeAccess;
+        }
+        else
+        {
+            srcStages = state.readStages;
+        }
+        barrier = srcStages != VK_PIPELINE_STAGE_2_NONE || (isImage && access.layout != state.layout);
+        restarted = isImage && access.layout != state.layout;
+    }
+    else if (state.writeStages != VK_PIPELINE_STAGE_2_NONE && ((access.stages & ~state.visibleStages) != 0 || (access.access & ~state.visibleAccess) != 0))
+    {
+        srcStages = state.writeStages;
+        srcAccess = state.writeAccess;
+        barrier = true;
+    }
+
+    if (barrier)
+    {
+        if (isImage)
+        {
+            VkImageMemoryBarrier2 imageBarrier{};
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            imageBarrier.srcStageMask = srcStages;
+            imageBarrier.srcAccessMask = srcAccess;
+            imageBarrier.dstStageMask = access.stages;
+            imageBarrier.dstAccessMask = access.access;
+            imageBarrier.oldLayout = oldLayout;
+            imageBarrier.newLayout = access.layout;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image = resource.image;
+            imageBarrier.subresourceRange.aspectMask = resource.aspect;
+            imageBarrier.subresourceRange.baseMipLevel = 0;
+            imageBarrier.subresourceRange.levelCount = resource.mipLevels;
+            imageBarrier.subresourceRange.baseArrayLayer = 0;
+            imageBarrier.subresourceRange.layerCount = 1;
+            imageBarriers.push_back(imageBarrier);
+        }
+        else
+        {
+            VkBufferMemoryBarrier2 bufferBarrier{};
+            bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+            bufferBarrier.srcStageMask = srcStages;
+            bufferBarrier.srcAccessMask = srcAccess;
+            bufferBarrier.dstStageMask = access.stages;
+            bufferBarrier.dstAccessMask = access.access;
+            bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.buffer = resource.buffer->buffer;
+            bufferBarrier.offset = 0;
+            bufferBarrier.size = VK_WHOLE_SIZE;
+            bufferBarriers.push_back(bufferBarrier);
+        }
+    }
+
+    if (access.write)
+    {
+        state.writeStages = access.stages;
+        state.writeAccess = writeAccessOf(access.access);
+        state.readStages = VK_PIPELINE_STAGE_2_NONE;
+        state.visibleStages = VK_PIPELINE_STAGE_2_NONE;
+        state.visibleAccess = VK_ACCESS_2_NONE;
+    }
+    else if (restarted)
+    {
+        // Later reads in other stages have to wait on this barrier, like on a write
+        state.writeStages = access.stages;
+        state.writeAccess = VK_ACCESS_2_NONE;
+        state.readStages = access.stages;
+        state.visibleStages = access.stages;
+        state.visibleAccess = access.access;
+    }
+    else
+    {
+        if (barrier)
+        {
+            state.visibleStages |= access.stages;
+            state.visibleAccess |= access.access;
+        }
+        state.readStages |= access.stages;
+    }
+
+    state.layout = isImage ? access.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+    state.queue = queue;
+
+    if (resource.transient)
+    {
+        // Stages from another queue are covered by its semaphore, only this queue's need waiting on
+        MemoryBlock& block = memoryBlocks[resource.memoryBlock];
+        if (block.owner != access.resource || block.queue != queue)
+        {
+            block.owner = access.resource;
+            block.stages = VK_PIPELINE_STAGE_2_NONE;
+            block.writeAccess = VK_ACCESS_2_NONE;
+        }
+        block.stages |= access.stages;
+        block.writeAccess |= writeAccessOf(access.access);
+        block.queue = queue;
+    }
+}
+
+void vpp::RenderGraph::execute(const std::vector<RenderGraphBatch>& batches)
+{
+    if (!allocated)
+    {
+        throw std::runtime_error("render graph executed before its memory was allocated!");
+    }
+
+    for (Resource& resource : resources)
+    {
+        if (resource.transient)
+        {
+            resource.state = ResourceState{};
+        }
+    }
+
+    std::vector<bool> live = findLivePasses();
+
+    stats.passCount = 0;
+    stats.culledPassCount = 0;
+    stats.barrierCount = 0;
+    stats.barrierBatchCount = 0;
+
+    std::vector<VkImageMemoryBarrier2> imageBarriers;
+    std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+
+    for (size_t i = 0; i < passes.size(); i++)
+    {
+        Pass& pass = passes[i];
+        if (!live[i])
+        {
+            stats.culledPassCount += pass.enabled ? 1 : 0;
+            continue;
+        }
+
+        const RenderGraphBatch& batch = batches.at(pass.batch);
+
+        imageBarriers.clear();
+        bufferBarriers.clear();
+        for (const Access& access : pass.accesses)
+        {
+            addBarrier(access, batch.queue, imageBarriers, bufferBarriers);
+        }
+
+        if (!imageBarriers.empty() || !bufferBarriers.empty())
+        {
+            VkDependencyInfo dependencyInfo{};
+            dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+            dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+            dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size());
+            dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+            vkCmdPipelineBarrier2(batch.commandBuffer, &dependencyInfo);
+
+            stats.barrierCount += static_cast<uint32_t>(imageBarriers.size() + bufferBarriers.size());
+            stats.barrierBatchCount++;
+        }
+
+        pass.record(batch.commandBuffer);
+        stats.passCount++;
+    }
+}
@@ -0,0 +1,63 @@
+#include "RenderTargets.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+
+vpp::RenderTargets::RenderTargets(std::shared_ptr<Backend> backend, std::shared_ptr<FrameContexts> frameContexts, VkExtent2D extent) :
+    backend(backend), frameContexts(frameContexts), extent(extent)
+{
+}
+
+vpp::RenderTargets::~RenderTargets()
+{
+    for (auto it = retired.rbegin(); it != retired.rend(); it++)
+    {
+        it->destroy();
+    }
+}
+
+void vpp::RenderTargets::addResizeCallback(std::string name, std::function<void(VkExtent2D)> callback)
+{
+    callbacks.push_back({ name, callback });
+}
+
+bool vpp::RenderTargets::resize(VkExtent2D extent)
+{
+    if (extent.width == this->extent.width && extent.height == this->extent.height)
+    {
+        return false;
+    }
+
+    VPP_PROFILE_SCOPE("Resize render targets");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    this->extent = extent;
+    for (ResizeCallback& callback : callbacks)
+    {
+        VPP_PROFILE_SCOPE("Resize callback");
+        callback.callback(extent);
+    }
+
+    lastResizeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    resizeCount++;
+    return true;
+}
+
+void vpp::RenderTargets::retire(std::function<void()> destroy)
+{
+    // A frame that was begun but never submitted is covered by the next one on the timeline
+    retired.push_back({ frameContexts->getCurrentFrameNumber(), destroy });
+}
+
+void vpp::RenderTargets::collect(uint64_t completedFrame)
+{
+    auto firstPending = std::stable_partition(retired.begin(), retired.end(), [completedFrame](const Retired& entry) { return entry.frame <= completedFrame; });
+    std::vector<Retired> collected(std::make_move_iterator(retired.begin()), std::make_move_iterator(firstPending));
+    retired.erase(retired.begin(), firstPending);
+
+    for (auto it = collected.rbegin(); it != collected.rend(); it++)
+    {
+        it->destroy();
+    }
+}
@@ -0,0 +1,189 @@
+#include "Scene.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cstring>
+#include <stdexcept>
+
+vpp::Entity vpp::Scene::createEntity(const glm::mat4& transform, MeshRef mesh, MaterialRef material, const AABB& localBounds, uint32_t flags)
+{
+    uint32_t slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(generations.size());
+        generations.push_back(0);
+        slotToDense.push_back(UINT32_MAX);
+    }
+
+    slotToDense[slot] = static_cast<uint32_t>(transforms.size());
+    denseToSlot.push_back(slot);
+
+    transforms.push_back(transform);
+    this->localBounds.push_back(localBounds);
+    worldBounds.push_back(localBounds.transform(transform));
+    meshes.push_back(mesh);
+    materials.push_back(material);
+    this->flags.push_back(flags);
+
+    return { slot, generations[slot] };
+}
+
+void vpp::Scene::destroyEntity(Entity entity)
+{
+    uint32_t dense = getDenseIndex(entity);
+    uint32_t last = static_cast<uint32_t>(transforms.size() - 1);
+
+    // The last row takes the destroyed one's place, so the arrays stay packed
+    if (dense != last)
+    {
+        transforms[dense] = transforms[last];
+        localBounds[dense] = localBounds[last];
+        worldBounds[dense] = worldBounds[last];
+        meshes[dense] = meshes[last];
+        materials[dense] = materials[last];
+        flags[dense] = flags[last];
+        denseToSlot[dense] = denseToSlot[last];
+        slotToDense[denseToSlot[dense]] = dense;
+    }
+
+    transforms.pop_back();
+    localBounds.pop_back();
+    worldBounds.pop_back();
+    meshes.pop_back();
+    materials.pop_back();
+    flags.pop_back();
+    denseToSlot.pop_back();
+
+    slotToDense[entity.index] = UINT32_MAX;
+    generations[entity.index]++;
+    freeSlots.push_back(entity.index);
+}
+
+bool vpp::Scene::isAlive(Entity entity) const
+{
+    return entity.index < generations.size() && generations[entity.index] == entity.generation;
+}
+
+uint32_t vpp::Scene::getDenseIndex(Entity entity) const
+{
+    if (!isAlive(entity))
+    {
+        throw std::runtime_error("Entity is not alive");
+    }
+
+    return slotToDense[entity.index];
+}
+
+std::vector<vpp::Entity> vpp::Scene::instantiate(const Model& model, const glm::mat4& transform, uint32_t flags)
+{
+    std::vector<Entity> entities;
+
+    if (model.hasTree)
+    {
+        for (const Node& node : model.nodes)
+        {
+            const Mesh& mesh = model.meshes[node.meshIndex];
+            entities.push_back(createEntity(transform * node.transform, { model.geometry, mesh.indexCount, mesh.startIndex, mesh.startVertex }, { mesh.materialIndex, mesh.colorIndex, model.textureType }, mesh.bounds, flags));
+        }
+    }
+    else
+    {
+        for (const Mesh& mesh : model.meshes)
+        {
+            entities.push_back(createEntity(transform, { model.geometry, mesh.indexCount, mesh.startIndex, mesh.startVertex }, { mesh.materialIndex, mesh.colorIndex, model.textureType }, mesh.bounds, flags));
+        }
+    }
+
+    return entities;
+}
+
+void vpp::Scene::setTransform(Entity entity, const glm::mat4& transform)
+{
+    uint32_t dense = getDenseIndex(entity);
+    transforms[dense] = transform;
+    worldBounds[dense] = localBounds[dense].transform(transform);
+}
+
+const glm::mat4& vpp::Scene::getTransform(Entity entity) const
+{
+    return transforms[getDenseIndex(entity)];
+}
+
+void vpp::Scene::cull(const glm::mat4& viewProj, std::vector<uint32_t>& drawList) const
+{
+    // Frustum planes from the rows of the matrix, with a [0, 1] depth range
+    glm::vec4 rows[4] = {
+        glm::vec4(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]),
+        glm::vec4(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]),
+        glm::vec4(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]),
+        glm::vec4(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3])
+    };
+    std::array<glm::vec4, 6> planes = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] };
+
+    for (uint32_t i = 0; i < worldBounds.size(); i++)
+    {
+        bool visible = true;
+
+        if (!(flags[i] & ENTITY_BACKGROUND))
+        {
+            const AABB& bounds = worldBounds[i];
+            for (const glm::vec4& plane : planes)
+            {
+                // The corner furthest along the plane normal
+                glm::vec3 corner(plane.x >= 0.0f ? bounds.max.x : bounds.min.x, plane.y >= 0.0f ? bounds.max.y : bounds.min.y, plane.z >= 0.0f ? bounds.max.z : bounds.min.z);
+                if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+        }
+
+        if (visible)
+        {
+            drawList.push_back(i);
+        }
+    }
+}
+
+void vpp::Scene::sortFrontToBack(std::vector<uint32_t>& drawList, glm::vec3 viewPosition) const
+{
+    // Positive floats order like their bits, so the distance and the index sort as one key
+    sortKeys.clear();
+    for (uint32_t index : drawList)
+    {
+        const AABB& bounds = worldBounds[index];
+        glm::vec3 closest = glm::clamp(viewPosition, bounds.min, bounds.max);
+        float distance = (flags[index] & ENTITY_BACKGROUND) ? FLT_MAX : glm::length(closest - viewPosition);
+
+        uint32_t distanceBits;
+        memcpy(&distanceBits, &distance, sizeof(float));
+        sortKeys.push_back((uint64_t(distanceBits) << 32) | index);
+    }
+
+    std::sort(sortKeys.begin(), sortKeys.end());
+
+    for (size_t i = 0; i < sortKeys.size(); i++)
+    {
+        drawList[i] = static_cast<uint32_t>(sortKeys[i]);
+    }
+}
+
+vpp::AABB vpp::Scene::getBounds() const
+{
+    AABB bounds;
+    for (size_t i = 0; i < worldBounds.size(); i++)
+    {
+        if (!(flags[i] & ENTITY_BACKGROUND))
+        {
+            bounds.expand(worldBounds[i]);
+        }
+    }
+    return bounds;
+}
@@ -0,0 +1,430 @@
+#include "SubpassDeferred.h"
+#include "Model.h"
+
+SubpassDeferred::SubpassDeferred(std::shared_ptr<vpp::Backend> backend, std::shared_ptr<vpp::SuperDescriptorSetLayout> perFrameLayout, std::shared_ptr<vpp::SuperDescriptorSetLayout> lightingImageLayout,
+    std::shared_ptr<vpp::SuperDescriptorSetLayout> depthImageLayout, std::shared_ptr<vpp::SuperDescriptorSetLayout> lightingDataLayout,
+    std::shared_ptr<vpp::Buffer> exposureBuffer, std::shared_ptr<vpp::Buffer> histogramBuffer) :
+    backend(backend), exposureBuffer(exposureBuffer), histogramBuffer(histogramBuffer)
+{
+    // The lighting result only needs an unsigned HDR range, as in the compute path
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(backend->physicalDevice, VK_FORMAT_B10G11R11_UFLOAT_PACK32, &formatProperties);
+    bool packedHdr = formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT;
+
+    formats[SWAPCHAIN_ATTACHMENT] = backend->swapChainImageFormat;
+    formats[DEPTH_ATTACHMENT] = VK_FORMAT_D32_SFLOAT;
+    formats[NORMAL_ATTACHMENT] = VK_FORMAT_R32G32B32A32_SFLOAT;
+    formats[ALBEDO_ATTACHMENT] = VK_FORMAT_R8G8B8A8_UNORM;
+    formats[METALLIC_ATTACHMENT] = VK_FORMAT_R8G8_UNORM;
+    formats[ROUGHNESS_ATTACHMENT] = VK_FORMAT_R8_UNORM;
+    formats[HDR_ATTACHMENT] = packedHdr ? VK_FORMAT_B10G11R11_UFLOAT_PACK32 : VK_FORMAT_R16G16B16A16_SFLOAT;
+
+    sampler = std::make_shared<vpp::Sampler>(backend, 1, "Subpass deferred::Sampler");
+
+    createRenderPass();
+    createDescriptorSetLayouts();
+    createPipelines(perFrameLayout, lightingImageLayout, depthImageLayout, lightingDataLayout);
+    createTargets();
+}
+
+SubpassDeferred::~SubpassDeferred()
+{
+    destroyTargets();
+
+    geometryPipeline.reset();
+    lightingPipeline.reset();
+    compositionPipeline.reset();
+    gBufferInputDescriptorSet.reset();
+    compositionDescriptorSet.reset();
+    gBufferInputLayout.reset();
+    compositionLayout.reset();
+    sampler.reset();
+
+    vkDestroyRenderPass(backend->device, renderPass, nullptr);
+}
+
+void SubpassDeferred::createRenderPass()
+{
+    std::array<VkAttachmentDescription, ATTACHMENT_COUNT> attachments{};
+    for (uint32_t i = 0; i < ATTACHMENT_COUNT; i++)
+    {
+        attachments[i].format = formats[i];
+        attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[i].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    // The only attachment that is stored. The render graph transitions it around the pass.
+    attachments[SWAPCHAIN_ATTACHMENT].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[SWAPCHAIN_ATTACHMENT].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[SWAPCHAIN_ATTACHMENT].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[SWAPCHAIN_ATTACHMENT].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    attachments[DEPTH_ATTACHMENT].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    // Every pixel is written by the full screen lighting triangle
+    attachments[HDR_ATTACHMENT].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+    // Geometry
+    std::array<VkAttachmentReference, 4> gBufferOutputs = { {
+        { NORMAL_ATTACHMENT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+        { ALBEDO_ATTACHMENT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+        { METALLIC_ATTACHMENT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+        { ROUGHNESS_ATTACHMENT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }
+    } };
+    VkAttachmentReference depthOutput = { DEPTH_ATTACHMENT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+    // Lighting, input_attachment_index follows this order
+    std::array<VkAttachmentReference, 5> gBufferInputs = { {
+        { NORMAL_ATTACHMENT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { ALBEDO_ATTACHMENT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { METALLIC_ATTACHMENT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { ROUGHNESS_ATTACHMENT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        { DEPTH_ATTACHMENT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL }
+    } };
+    VkAttachmentReference hdrOutput = { HDR_ATTACHMENT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+    // Composition
+    VkAttachmentReference hdrInput = { HDR_ATTACHMENT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    VkAttachmentReference swapChainOutput = { SWAPCHAIN_ATTACHMENT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+    std::array<VkSubpassDescription, 3> subpasses{};
+    subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[0].colorAttachmentCount = static_cast<uint32_t>(gBufferOutputs.size());
+    subpasses[0].pColorAttachments = gBufferOutputs.data();
+    subpasses[0].pDepthStencilAttachment = &depthOutput;
+
+    subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[1].inputAttachmentCount = static_cast<uint32_t>(gBufferInputs.size());
+    subpasses[1].pInputAttachments = gBufferInputs.data();
+    subpasses[1].colorAttachmentCount = 1;
+    subpasses[1].pColorAttachments = &hdrOutput;
+
+    subpasses[2].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpasses[2].inputAttachmentCount = 1;
+    subpasses[2].pInputAttachments = &hdrInput;
+    subpasses[2].colorAttachmentCount = 1;
+    subpasses[2].pColorAttachments = &swapChainOutput;
+
+    const VkPipelineStageFlags attachmentStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    const VkAccessFlags attachmentWrites = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    std::array<VkSubpassDependency, 3> dependencies{};
+
+    // The previous frame's subpasses are still reading the same transient attachments
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = attachmentStages | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[0].srcAccessMask = attachmentWrites;
+    dependencies[0].dstStageMask = attachmentStages;
+    dependencies[0].dstAccessMask = attachmentWrites | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+    // Each pixel only reads what was written at the same pixel, so the dependencies stay in the tile
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = 1;
+    dependencies[1].srcStageMask = attachmentStages;
+    dependencies[1].srcAccessMask = attachmentWrites;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    dependencies[2].srcSubpass = 1;
+    dependencies[2].dstSubpass = 2;
+    dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependencies[2].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassInfo.pSubpasses = subpasses.data();
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+
+    if (vkCreateRenderPass(backend->device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create subpass deferred render pass!");
+    }
+}
+
+void SubpassDeferred::createDescriptorSetLayouts()
+{
+    gBufferInputLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "Subpass deferred::G Buffer input descriptor set layout");
+    gBufferInputLayout->addBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 1); // normal
+    gBufferInputLayout->addBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 1); // albedo
+    gBufferInputLayout->addBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 1); // metallic
+    gBufferInputLayout->addBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 1); // roughness
+    gBufferInputLayout->addBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 1); // depth
+    gBufferInputLayout->createLayout();
+
+    compositionLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "Subpass deferred::Composition descriptor set layout");
+    compositionLayout->addBinding(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT, 1); // lighting result
+    compositionLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1); // exposure
+    compositionLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1); // luminance histogram
+    compositionLayout->createLayout();
+}
+
+void SubpassDeferred::createPipelines(std::shared_ptr<vpp::SuperDescriptorSetLayout> perFrameLayout, std::shared_ptr<vpp::SuperDescriptorSetLayout> lightingImageLayout,
+    std::shared_ptr<vpp::SuperDescriptorSetLayout> depthImageLayout, std::shared_ptr<vpp::SuperDescriptorSetLayout> lightingDataLayout)
+{
+    // Velocity has no attachment here, the geometry shader's write to it is discarded
+    geometryPipeline = std::make_shared<vpp::GraphicsPipeline>(backend, "SubpassDeferred::Geometry Pipeline", renderPass, VK_TRUE, VK_TRUE, 4);
+    geometryPipeline->addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, "shaders/geometryPass.vert.spv");
+    geometryPipeline->addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, "shaders/geometryPass.frag.spv");
+    geometryPipeline->addPushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(vpp::MainPushConstants));
+    geometryPipeline->addDescriptorSetLayout(perFrameLayout);
+    geometryPipeline->addDescriptorSetLayout(vpp::Model::getBindlessHeap()->layout);
+    geometryPipeline->addDescriptorSetLayout(vpp::Model::getColorDescriptorSetLayout());
+    geometryPipeline->createPipeline();
+
+    // Same set numbers as the compute lighting pass, set 2 holds its storage output and stays unbound
+    lightingPipeline = std::make_shared<vpp::GraphicsPipeline>(backend, "SubpassDeferred::Lighting Pipeline", renderPass, VK_FALSE, VK_FALSE, 1);
+    lightingPipeline->addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, "shaders/toneMappingPass.vert.spv");
+    lightingPipeline->addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, "shaders/deferredLighting.frag.spv");
+    lightingPipeline->addDescriptorSetLayout(perFrameLayout);
+    lightingPipeline->addDescriptorSetLayout(gBufferInputLayout);
+    lightingPipeline->addDescriptorSetLayout(lightingImageLayout);
+    lightingPipeline->addDescriptorSetLayout(depthImageLayout);
+    lightingPipeline->addDescriptorSetLayout(lightingDataLayout);
+
+    // ENCODE_SRGB, as in the tone mapping pass
+    VkBool32 encodeSrgb = formats[SWAPCHAIN_ATTACHMENT] == VK_FORMAT_B8G8R8A8_SRGB || formats[SWAPCHAIN_ATTACHMENT] == VK_FORMAT_R8G8B8A8_SRGB || formats[SWAPCHAIN_ATTACHMENT] == VK_FORMAT_A8B8G8R8_SRGB_PACK32 ? VK_FALSE : VK_TRUE;
+    VkSpecializationMapEntry mapEntry = { 0, 0, sizeof(VkBool32) };
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &mapEntry;
+    specializationInfo.dataSize = sizeof(VkBool32);
+    specializationInfo.pData = &encodeSrgb;
+
+    compositionPipeline = std::make_shared<vpp::GraphicsPipeline>(backend, "SubpassDeferred::Composition Pipeline", renderPass, VK_FALSE, VK_FALSE, 1);
+    compositionPipeline->addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, "shaders/toneMappingPass.vert.spv");
+    compositionPipeline->addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, "shaders/deferredComposition.frag.spv", &specializationInfo);
+    compositionPipeline->addDescriptorSetLayout(perFrameLayout);
+    compositionPipeline->addDescriptorSetLayout(compositionLayout);
+
+    std::array<std::shared_ptr<vpp::GraphicsPipeline>, 2> fullScreenPipelines = { lightingPipeline, compositionPipeline };
+    for (uint32_t i = 0; i < fullScreenPipelines.size(); i++)
+    {
+        std::shared_ptr<vpp::GraphicsPipeline> pipeline = fullScreenPipelines[i];
+        pipeline->vertexInputInfo.vertexAttributeDescriptionCount = 0;
+        pipeline->vertexInputInfo.vertexBindingDescriptionCount = 0;
+        pipeline->vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+        pipeline->vertexInputInfo.pVertexBindingDescriptions = nullptr;
+        pipeline->rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
+        pipeline->rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        pipeline->colorBlendAttachments[0].blendEnable = VK_FALSE;
+        pipeline->pipelineInfo.subpass = i + 1;
+        pipeline->createPipeline();
+    }
+}
+
+std::shared_ptr<vpp::Image> SubpassDeferred::createAttachment(Attachment attachment, VkImageUsageFlags usage, std::string name)
+{
+    std::shared_ptr<vpp::Image> image = std::make_shared<vpp::Image>(backend, extent.width, extent.height, 1, 1, formats[attachment], usage | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, name);
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(backend->device, image->image, &memRequirements);
+
+    // Nothing is stored, so lazily allocated memory is never committed on GPUs that keep the tile on chip
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    if (!backend->hasMemoryType(memRequirements.memoryTypeBits, properties))
+    {
+        properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        lazilyAllocated = false;
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = backend->findMemoryType(memRequirements.memoryTypeBits, properties);
+
+    if (backend->allocateMemory(allocInfo, image->imageMemory, vpp::MEMORY_RENDER_TARGETS, name) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate subpass deferred attachment memory!");
+    }
+
+    vkBindImageMemory(backend->device, image->image, image->imageMemory, 0);
+
+    return image;
+}
+
+void SubpassDeferred::recreateTargets(vpp::RenderTargets& renderTargets)
+{
+    renderTargets.retire(images[DEPTH_ATTACHMENT], images[NORMAL_ATTACHMENT], images[ALBEDO_ATTACHMENT], images[METALLIC_ATTACHMENT], images[ROUGHNESS_ATTACHMENT], images[HDR_ATTACHMENT],
+        imageViews[DEPTH_ATTACHMENT], imageViews[NORMAL_ATTACHMENT], imageViews[ALBEDO_ATTACHMENT], imageViews[METALLIC_ATTACHMENT], imageViews[ROUGHNESS_ATTACHMENT], imageViews[HDR_ATTACHMENT],
+        gBufferInputDescriptorSet, compositionDescriptorSet);
+
+    VkDevice device = backend->device;
+    std::vector<VkFramebuffer> oldFramebuffers = framebuffers;
+    renderTargets.retire([device, oldFramebuffers]() {
+        for (VkFramebuffer framebuffer : oldFramebuffers)
+        {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+    });
+    framebuffers.clear();
+
+    createTargets();
+}
+
+void SubpassDeferred::createTargets()
+{
+    extent = backend->swapChainExtent;
+    lazilyAllocated = true;
+
+    images[DEPTH_ATTACHMENT] = createAttachment(DEPTH_ATTACHMENT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, "Subpass deferred::Depth Image");
+    images[NORMAL_ATTACHMENT] = createAttachment(NORMAL_ATTACHMENT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, "Subpass deferred::Normal Image");
+    images[ALBEDO_ATTACHMENT] = createAttachment(ALBEDO_ATTACHMENT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, "Subpass deferred::Albedo Image");
+    images[METALLIC_ATTACHMENT] = createAttachment(METALLIC_ATTACHMENT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, "Subpass deferred::Metallic Image");
+    images[ROUGHNESS_ATTACHMENT] = createAttachment(ROUGHNESS_ATTACHMENT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, "Subpass deferred::Roughness Image");
+    images[HDR_ATTACHMENT] = createAttachment(HDR_ATTACHMENT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, "Subpass deferred::HDR Image");
+
+    for (uint32_t i = DEPTH_ATTACHMENT; i < ATTACHMENT_COUNT; i++)
+    {
+        VkImageAspectFlagBits aspect = i == DEPTH_ATTACHMENT ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        imageViews[i] = std::make_shared<vpp::ImageView>(backend, images[i], 0, 1, aspect, "Subpass deferred::Attachment View " + std::to_string(i));
+    }
+
+    gBufferInputDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, gBufferInputLayout, "Subpass deferred::G Buffer input descriptor set");
+    gBufferInputDescriptorSet->addImagesToBinding({ imageViews[NORMAL_ATTACHMENT] }, { sampler }, { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+    gBufferInputDescriptorSet->addImagesToBinding({ imageViews[ALBEDO_ATTACHMENT] }, { sampler }, { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+    gBufferInputDescriptorSet->addImagesToBinding({ imageViews[METALLIC_ATTACHMENT] }, { sampler }, { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+    gBufferInputDescriptorSet->addImagesToBinding({ imageViews[ROUGHNESS_ATTACHMENT] }, { sampler }, { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+    gBufferInputDescriptorSet->addImagesToBinding({ imageViews[DEPTH_ATTACHMENT] }, { sampler }, { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL });
+    gBufferInputDescriptorSet->createDescriptorSet();
+
+    compositionDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, compositionLayout, "Subpass deferred::Composition descriptor set");
+    compositionDescriptorSet->addImagesToBinding({ imageViews[HDR_ATTACHMENT] }, { sampler }, { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+    compositionDescriptorSet->addBuffersToBinding({ exposureBuffer });
+    compositionDescriptorSet->addBuffersToBinding({ histogramBuffer });
+    compositionDescriptorSet->createDescriptorSet();
+
+    for (auto& swapChainImageView : backend->swapChainImageViews)
+    {
+        std::array<VkImageView, ATTACHMENT_COUNT> attachments;
+        attachments[SWAPCHAIN_ATTACHMENT] = swapChainImageView->imageView;
+        for (uint32_t i = DEPTH_ATTACHMENT; i < ATTACHMENT_COUNT; i++)
+        {
+            attachments[i] = imageViews[i]->imageView;
+        }
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        framebufferInfo.pAttachments = attachments.data();
+        framebufferInfo.width = extent.width;
+        framebufferInfo.height = extent.height;
+        framebufferInfo.layers = 1;
+
+        VkFramebuffer framebuffer;
+        if (vkCreateFramebuffer(backend->device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create subpass deferred framebuffer!");
+        }
+        framebuffers.push_back(framebuffer);
+    }
+}
+
+void SubpassDeferred::destroyTargets()
+{
+    for (VkFramebuffer framebuffer : framebuffers)
+    {
+        vkDestroyFramebuffer(backend->device, framebuffer, nullptr);
+    }
+    framebuffers.clear();
+
+    for (uint32_t i = 0; i < ATTACHMENT_COUNT; i++)
+    {
+        imageViews[i].reset();
+        images[i].reset();
+    }
+}
+
+// Lazily allocated attachments report what the driver actually committed, usually nothing
+VkDeviceSize SubpassDeferred::getAttachmentMemory() const
+{
+    VkDeviceSize total = 0;
+
+    for (uint32_t i = DEPTH_ATTACHMENT; i < ATTACHMENT_COUNT; i++)
+    {
+        if (lazilyAllocated)
+        {
+            VkDeviceSize committed = 0;
+            vkGetDeviceMemoryCommitment(backend->device, images[i]->imageMemory, &committed);
+            total += committed;
+        }
+        else
+        {
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(backend->device, images[i]->image, &memRequirements);
+            total += memRequirements.size;
+        }
+    }
+
+    return total;
+}
+
+void SubpassDeferred::record(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkDescriptorSet perFrameSet, const std::vector<uint32_t>& perFrameOffsets, VkDescriptorSet depthImageSet,
+    VkDescriptorSet lightingDataSet, const std::vector<uint32_t>& lightingOffsets, const std::function<void(VkCommandBuffer)>& renderObjects)
+{
+    std::array<VkClearValue, ATTACHMENT_COUNT> clearValues{};
+    clearValues[DEPTH_ATTACHMENT].depthStencil = { 1.0f, 0 };
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = framebuffers[imageIndex];
+    renderPassInfo.renderArea.offset = { 0, 0 };
+    renderPassInfo.renderArea.extent = extent;
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+    VkRect2D scissor{ { 0, 0 }, extent };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    // Geometry
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPipeline->pipeline);
+
+    VkDeviceSize offsets[] = { 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &(vpp::Model::getVertexBuffer()->buffer), offsets);
+    vkCmdBindIndexBuffer(commandBuffer, vpp::Model::getIndexBuffer()->buffer, 0, VK_INDEX_TYPE_UINT32);
+
+    std::array<VkDescriptorSet, 3> geometrySets = { perFrameSet, vpp::Model::getBindlessHeap()->descriptorSet, vpp::Model::getColorDescriptorSet()->descriptorSet };
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPipeline->pipelineLayout, 0, static_cast<uint32_t>(geometrySets.size()), geometrySets.data(),
+        static_cast<uint32_t>(perFrameOffsets.size()), perFrameOffsets.data());
+
+    renderObjects(commandBuffer);
+
+    // Lighting
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline->pipeline);
+
+    std::array<VkDescriptorSet, 2> lightingSets = { perFrameSet, gBufferInputDescriptorSet->descriptorSet };
+    std::array<VkDescriptorSet, 2> lightingDataSets = { depthImageSet, lightingDataSet };
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline->pipelineLayout, 0, static_cast<uint32_t>(lightingSets.size()), lightingSets.data(),
+        static_cast<uint32_t>(perFrameOffsets.size()), perFrameOffsets.data());
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline->pipelineLayout, 3, static_cast<uint32_t>(lightingDataSets.size()), lightingDataSets.data(),
+        static_cast<uint32_t>(lightingOffsets.size()), lightingOffsets.data());
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+    // Composition
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compositionPipeline->pipeline);
+
+    std::array<VkDescriptorSet, 2> compositionSets = { perFrameSet, compositionDescriptorSet->descriptorSet };
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compositionPipeline->pipelineLayout, 0, static_cast<uint32_t>(compositionSets.size()), compositionSets.data(),
+        static_cast<uint32_t>(perFrameOffsets.size()), perFrameOffsets.data());
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+    vkCmdEndRenderPass(commandBuffer);
+}
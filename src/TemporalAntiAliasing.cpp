@@ -0,0 +1,142 @@
+#include "TemporalAntiAliasing.h"
+
+static float halton(uint32_t index, uint32_t base)
+{
+    float result = 0.0f;
+    float fraction = 1.0f;
+
+    while (index > 0)
+    {
+        fraction /= static_cast<float>(base);
+        result += fraction * static_cast<float>(index % base);
+        index /= base;
+    }
+
+    return result;
+}
+
+TemporalAntiAliasing::TemporalAntiAliasing(std::shared_ptr<vpp::Backend> backend, std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> velocityImageView, std::shared_ptr<vpp::Image> outputImage) :
+    backend(backend)
+{
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+    sampler = std::make_shared<vpp::Sampler>(backend, samplerInfo, "Temporal anti-aliasing sampler");
+
+    descriptorSetLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "Temporal anti-aliasing descriptor set layout");
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1); // current frame
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1); // depth
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1); // velocity
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1); // history input
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1); // output
+    descriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1); // history output
+    descriptorSetLayout->createLayout();
+
+    createTargets(hdrImageView, depthImageView, velocityImageView, outputImage);
+
+    resolvePipeline = std::make_shared<vpp::ComputePipeline>(backend, "TemporalAntiAliasing::Resolve Pipeline", "shaders/taaResolve.comp.spv");
+    resolvePipeline->addDescriptorSetLayout(descriptorSetLayout);
+    resolvePipeline->addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(TemporalAntiAliasingPushConstants));
+    resolvePipeline->createPipeline();
+}
+
+TemporalAntiAliasing::~TemporalAntiAliasing()
+{
+    resolvePipeline.reset();
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        descriptorSets[i].reset();
+        historyImageViews[i].reset();
+        historyImages[i].reset();
+    }
+    descriptorSetLayout.reset();
+    sampler.reset();
+    outputImageView.reset();
+    outputImage.reset();
+}
+
+void TemporalAntiAliasing::resize(vpp::RenderTargets& renderTargets, std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> velocityImageView, std::shared_ptr<vpp::Image> outputImage)
+{
+    renderTargets.retire(this->outputImage, historyImages[0], historyImages[1], outputImageView, historyImageViews[0], historyImageViews[1], descriptorSets[0], descriptorSets[1]);
+    createTargets(hdrImageView, depthImageView, velocityImageView, outputImage);
+    resetHistory();
+}
+
+// The history images start out undefined, the render graph transitions them on first use
+void TemporalAntiAliasing::createTargets(std::shared_ptr<vpp::ImageView> hdrImageView, std::shared_ptr<vpp::ImageView> depthImageView, std::shared_ptr<vpp::ImageView> velocityImageView, std::shared_ptr<vpp::Image> outputImage)
+{
+    this->outputImage = outputImage;
+    width = outputImage->width;
+    height = outputImage->height;
+
+    outputImageView = std::make_shared<vpp::ImageView>(backend, outputImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Temporal anti-aliasing output Image View");
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        historyImages[i] = std::make_shared<vpp::Image>(backend, width, height, 1, 1, outputImage->format, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Temporal anti-aliasing::History Image " + std::to_string(i));
+        historyImageViews[i] = std::make_shared<vpp::ImageView>(backend, historyImages[i], 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Temporal anti-aliasing history Image View " + std::to_string(i));
+    }
+
+    // Set i writes history i and reads the other one
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        descriptorSets[i] = std::make_shared<vpp::SuperDescriptorSet>(backend, descriptorSetLayout, "Temporal anti-aliasing descriptor set " + std::to_string(i));
+        descriptorSets[i]->addImagesToBinding({ hdrImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSets[i]->addImagesToBinding({ depthImageView }, { sampler }, { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL });
+        descriptorSets[i]->addImagesToBinding({ velocityImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSets[i]->addImagesToBinding({ historyImageViews[1 - i] }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSets[i]->addImagesToBinding({ outputImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSets[i]->addImagesToBinding({ historyImageViews[i] }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSets[i]->createDescriptorSet();
+    }
+}
+
+// Halton(2, 3), skipping index 0 which would put the first sample on the pixel corner
+glm::vec2 TemporalAntiAliasing::nextJitter()
+{
+    if (!enabled)
+    {
+        return glm::vec2(0.0f);
+    }
+
+    uint32_t index = frameIndex % JITTER_SAMPLE_COUNT + 1;
+    return glm::vec2(halton(index, 2), halton(index, 3)) - 0.5f;
+}
+
+void TemporalAntiAliasing::resetHistory()
+{
+    historyValid = false;
+}
+
+void TemporalAntiAliasing::record(VkCommandBuffer commandBuffer, VkExtent2D renderExtent, glm::vec2 jitter)
+{
+    // History is kept at output resolution, so it stays valid when the render resolution changes
+    if (enabled != wasEnabled)
+    {
+        historyValid = false;
+    }
+    wasEnabled = enabled;
+
+    TemporalAntiAliasingPushConstants pushConstants{};
+    pushConstants.jitter = jitter / glm::vec2(renderExtent.width, renderExtent.height);
+    pushConstants.renderWidth = renderExtent.width;
+    pushConstants.renderHeight = renderExtent.height;
+    pushConstants.blendFactor = blendFactor;
+    pushConstants.historyValid = historyValid ? 1 : 0;
+    pushConstants.enabled = enabled ? 1 : 0;
+
+    uint32_t parity = frameIndex % 2;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, resolvePipeline->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, resolvePipeline->pipelineLayout, 0, 1, &descriptorSets[parity]->descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, resolvePipeline->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(TemporalAntiAliasingPushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, (width + 7) / 8, (height + 7) / 8, 1);
+
+    historyValid = enabled;
+    frameIndex++;
+}
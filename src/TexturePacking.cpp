@@ -0,0 +1,309 @@
+#include "TexturePacking.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+namespace
+{
+    struct Plane
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> texels;
+    };
+
+    struct DecodedImage
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> rgba;
+    };
+
+    const VkComponentSwizzle ormDefaults[vpp::ORM_CHANNEL_COUNT] = { VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_ZERO };
+
+    Plane resample(const Plane& plane, uint32_t width, uint32_t height)
+    {
+        if (plane.width == width && plane.height == height)
+        {
+            return plane;
+        }
+
+        Plane result{ width, height, std::vector<uint8_t>(size_t(width) * height) };
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                result.texels[size_t(y) * width + x] = plane.texels[size_t(y * plane.height / height) * plane.width + x * plane.width / width];
+            }
+        }
+
+        return result;
+    }
+
+    // 2x2 box filter, an odd edge repeats its last texel
+    Plane downsample(const Plane& plane)
+    {
+        Plane result{ std::max(plane.width / 2, 1u), std::max(plane.height / 2, 1u) };
+        result.texels.resize(size_t(result.width) * result.height);
+
+        for (uint32_t y = 0; y < result.height; y++)
+        {
+            uint32_t y0 = std::min(y * 2, plane.height - 1) * plane.width;
+            uint32_t y1 = std::min(y * 2 + 1, plane.height - 1) * plane.width;
+            for (uint32_t x = 0; x < result.width; x++)
+            {
+                uint32_t x0 = std::min(x * 2, plane.width - 1);
+                uint32_t x1 = std::min(x * 2 + 1, plane.width - 1);
+                uint32_t sum = plane.texels[y0 + x0] + plane.texels[y0 + x1] + plane.texels[y1 + x0] + plane.texels[y1 + x1];
+                result.texels[size_t(y) * result.width + x] = uint8_t((sum + 2) / 4);
+            }
+        }
+
+        return result;
+    }
+
+    // Endpoints are the block's max and min, every texel takes the nearest of the eight palette values between them
+    void encodeBc4Block(const Plane& plane, uint32_t blockX, uint32_t blockY, uint8_t* block)
+    {
+        uint8_t values[16];
+        uint8_t low = 255, high = 0;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint32_t x = std::min(blockX * 4 + i % 4, plane.width - 1);
+            uint32_t y = std::min(blockY * 4 + i / 4, plane.height - 1);
+            values[i] = plane.texels[size_t(y) * plane.width + x];
+            low = std::min(low, values[i]);
+            high = std::max(high, values[i]);
+        }
+
+        // red0 > red1 selects the eight value palette: red0, red1, then six steps from red0 towards red1
+        block[0] = high;
+        block[1] = low;
+
+        uint64_t indices = 0;
+        if (high > low)
+        {
+            uint32_t range = high - low;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                uint32_t step = ((high - values[i]) * 7 + range / 2) / range;
+                uint64_t index = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+                indices |= index << (3 * i);
+            }
+        }
+
+        for (uint32_t i = 0; i < 6; i++)
+        {
+            block[2 + i] = uint8_t(indices >> (8 * i));
+        }
+    }
+
+    VkDeviceSize rgba8MipChainSize(uint32_t width, uint32_t height)
+    {
+        VkDeviceSize size = 0;
+        while (true)
+        {
+            size += VkDeviceSize(width) * height * 4;
+            if (width == 1 && height == 1) return size;
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+    }
+
+    bool isSampleable(std::shared_ptr<vpp::Backend> backend, VkFormat format)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(backend->physicalDevice, format, &properties);
+        return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+    }
+}
+
+vpp::PackedTexture vpp::createOrmTexture(std::shared_ptr<Backend> backend, const OrmSources& sources, std::string name)
+{
+    VPP_PROFILE_SCOPE("Pack ORM texture");
+    PackedTexture result;
+
+    // A combined map is referenced by two or three channels and decoded once
+    std::map<std::string, DecodedImage> decoded;
+    std::vector<Plane> planes;
+    VkComponentSwizzle swizzles[ORM_CHANNEL_COUNT];
+    uint32_t width = 0, height = 0;
+
+    for (uint32_t channel = 0; channel < ORM_CHANNEL_COUNT; channel++)
+    {
+        const TextureChannelSource& source = sources[channel];
+        if (source.path.empty())
+        {
+            swizzles[channel] = ormDefaults[channel];
+            continue;
+        }
+
+        auto it = decoded.find(source.path);
+        if (it == decoded.end())
+        {
+            int texWidth, texHeight, texChannels;
+            stbi_uc* pixels = stbi_load(source.path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+            if (!pixels)
+            {
+                throw std::runtime_error("failed to load texture image!");
+            }
+
+            DecodedImage image{ uint32_t(texWidth), uint32_t(texHeight), std::vector<uint8_t>(pixels, pixels + size_t(texWidth) * texHeight * 4) };
+            stbi_image_free(pixels);
+            it = decoded.emplace(source.path, std::move(image)).first;
+        }
+
+        const DecodedImage& image = it->second;
+        Plane plane{ image.width, image.height, std::vector<uint8_t>(size_t(image.width) * image.height) };
+        for (size_t i = 0; i < plane.texels.size(); i++)
+        {
+            plane.texels[i] = image.rgba[i * 4 + std::min(source.channel, 3u)];
+        }
+
+        swizzles[channel] = VkComponentSwizzle(VK_COMPONENT_SWIZZLE_R + planes.size());
+        width = std::max(width, plane.width);
+        height = std::max(height, plane.height);
+        // The loader had no occlusion texture before packing, so only metallic and roughness are the baseline
+        if (channel != ORM_OCCLUSION)
+        {
+            result.unpackedSize += rgba8MipChainSize(plane.width, plane.height);
+        }
+        planes.push_back(std::move(plane));
+    }
+
+    result.channelCount = static_cast<uint32_t>(planes.size());
+    if (planes.empty())
+    {
+        return result;
+    }
+
+    for (Plane& plane : planes)
+    {
+        plane = resample(plane, width, height);
+    }
+
+    VkFormat format;
+    bool compressed = false;
+    if (planes.size() == 1)
+    {
+        compressed = backend->textureCompressionBCSupported && isSampleable(backend, VK_FORMAT_BC4_UNORM_BLOCK);
+        format = compressed ? VK_FORMAT_BC4_UNORM_BLOCK : VK_FORMAT_R8_UNORM;
+    }
+    else if (planes.size() == 2)
+    {
+        compressed = backend->textureCompressionBCSupported && isSampleable(backend, VK_FORMAT_BC5_UNORM_BLOCK);
+        format = compressed ? VK_FORMAT_BC5_UNORM_BLOCK : VK_FORMAT_R8G8_UNORM;
+    }
+    else
+    {
+        format = VK_FORMAT_R8G8B8A8_UNORM;
+    }
+
+    // All levels are built on the CPU, blits can't write block compressed images
+    uint32_t levels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+    std::vector<uint8_t> data;
+    std::vector<VkBufferImageCopy> regions;
+
+    for (uint32_t level = 0; level < levels; level++)
+    {
+        uint32_t levelWidth = planes[0].width;
+        uint32_t levelHeight = planes[0].height;
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = data.size();
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { levelWidth, levelHeight, 1 };
+        regions.push_back(region);
+
+        if (compressed)
+        {
+            uint32_t blocksX = (levelWidth + 3) / 4;
+            uint32_t blocksY = (levelHeight + 3) / 4;
+            size_t blockSize = 8 * planes.size();
+            size_t offset = data.size();
+            data.resize(offset + size_t(blocksX) * blocksY * blockSize);
+
+            for (uint32_t blockY = 0; blockY < blocksY; blockY++)
+            {
+                for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+                {
+                    uint8_t* block = data.data() + offset + (size_t(blockY) * blocksX + blockX) * blockSize;
+                    for (size_t plane = 0; plane < planes.size(); plane++)
+                    {
+                        encodeBc4Block(planes[plane], blockX, blockY, block + plane * 8);
+                    }
+                }
+            }
+        }
+        else
+        {
+            size_t texelSize = planes.size() == 3 ? 4 : planes.size();
+            size_t texelCount = size_t(levelWidth) * levelHeight;
+            size_t offset = data.size();
+            data.resize(offset + texelCount * texelSize, 255);
+
+            for (size_t i = 0; i < texelCount; i++)
+            {
+                for (size_t plane = 0; plane < planes.size(); plane++)
+                {
+                    data[offset + i * texelSize + plane] = planes[plane].texels[i];
+                }
+            }
+        }
+
+        for (Plane& plane : planes)
+        {
+            plane = downsample(plane);
+        }
+    }
+
+    result.size = data.size();
+
+    Buffer stagingBuffer(backend, data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, CONTINOUS_TRANSFER, nullptr, "Staging buffer for texture");
+    memcpy(stagingBuffer.mappedPtr, data.data(), data.size());
+
+    result.image = std::make_shared<Image>(backend, width, height, 1, levels, format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, name);
+
+    VkCommandBuffer commandBuffer = backend->beginSingleTimeCommands();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = result.image->image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = levels;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.buffer, result.image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    backend->endSingleTimeCommands(commandBuffer);
+
+    VkComponentMapping components = { swizzles[ORM_OCCLUSION], swizzles[ORM_ROUGHNESS], swizzles[ORM_METALLIC], VK_COMPONENT_SWIZZLE_ONE };
+    result.imageView = std::make_shared<ImageView>(backend, result.image, 0, levels, VK_IMAGE_ASPECT_COLOR_BIT, name + " view", components);
+
+    return result;
+}
+
+std::shared_ptr<vpp::ImageView> vpp::createDefaultOrmView(std::shared_ptr<Backend> backend, std::shared_ptr<Image> image)
+{
+    VkComponentMapping components = { ormDefaults[ORM_OCCLUSION], ormDefaults[ORM_ROUGHNESS], ormDefaults[ORM_METALLIC], VK_COMPONENT_SWIZZLE_ONE };
+    return std::make_shared<ImageView>(backend, image, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Default ORM image view", components);
+}
@@ -1,44 +1,62 @@
 #include "TriangleRenderer.h"
 
 #include "CubeMap.h"
+#include "CpuProfiler.h"
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cfloat>
+#include <random>
 #include "util.h"
 
-TriangleRenderer::TriangleRenderer(std::string app_name, uint32_t apiVersion, std::vector<VkValidationFeatureEnableEXT> validation_features) : 
-    vpp::Application(app_name, apiVersion, validation_features), camera(glm::vec3(-2907.25, 2827.39, 755.888), glm::vec3(0.0f, 0.0f, 0.0f))
+TriangleRenderer::TriangleRenderer(std::string app_name, uint32_t apiVersion, std::vector<VkValidationFeatureEnableEXT> validation_features, vpp::HeadlessSettings headless, BenchmarkSettings benchmarkSettings) : 
+    vpp::Application(app_name, apiVersion, validation_features, headless), benchmark(benchmarkSettings), camera(glm::vec3(-2907.25, 2827.39, 755.888), glm::vec3(0.0f, 0.0f, 0.0f))
 {
+    scene = std::make_shared<vpp::Scene>();
 
-    sky = std::make_shared<vpp::Model>("models/skyBox/sky.glb", backend, vpp::TextureType::EMBEDDED);
-    models.push_back(sky);
-    sky->scale = glm::vec3(190.0f);
-        
-    std::shared_ptr<vpp::Model> sponza = std::make_shared<vpp::Model>("models/sponza/Sponza.gltf", backend, vpp::TEXTURE);
-    models.push_back(sponza);
+    vpp::Model sky("models/skyBox/sky.glb", backend, vpp::TextureType::EMBEDDED);
+    skyEntities = scene->instantiate(sky, glm::scale(glm::mat4(1.0f), glm::vec3(190.0f)), vpp::ENTITY_BACKGROUND);
+    for (vpp::Entity entity : skyEntities)
+    {
+        skyTransforms.push_back(scene->getTransform(entity));
+    }
 
-    /*std::shared_ptr<vpp::Model> sponza = std::make_unique<vpp::Model>("models/sponza3/NewSponza_Main_glTF_002.gltf", backend, vpp::TEXTURE);
-    models.push_back(sponza);
-    sponza->scale = glm::vec3(100.0f);
+    vpp::Model sponza("models/sponza/Sponza.gltf", backend, vpp::TEXTURE);
+    scene->instantiate(sponza, glm::mat4(1.0f));
 
-    std::shared_ptr<vpp::Model> sponzaCurtains = std::make_unique<vpp::Model>("models/sponza3curtains/NewSponza_Curtains_glTF.gltf", backend, vpp::TEXTURE);
-    models.push_back(sponzaCurtains);
-    sponzaCurtains->scale = glm::vec3(100.0f);*/
+    /*vpp::Model sponza("models/sponza3/NewSponza_Main_glTF_002.gltf", backend, vpp::TEXTURE);
+    scene->instantiate(sponza, glm::scale(glm::mat4(1.0f), glm::vec3(100.0f)));
 
-    std::shared_ptr<vpp::Model> trashGod = std::make_shared<vpp::Model>("models/trashGod/scene.fbx", backend, vpp::FLAT_COLOR);
-    models.push_back(trashGod);
+    vpp::Model sponzaCurtains("models/sponza3curtains/NewSponza_Curtains_glTF.gltf", backend, vpp::TEXTURE);
+    scene->instantiate(sponzaCurtains, glm::scale(glm::mat4(1.0f), glm::vec3(100.0f)));*/
+
+    vpp::Model trashGod("models/trashGod/scene.fbx", backend, vpp::FLAT_COLOR);
+    scene->instantiate(trashGod, glm::mat4(1.0f));
 
     vpp::Model::finishLoadingModels(backend);
 
     CubeMap cubeMap(backend);
 
-    createUniformBuffers();
+    createLights();
+
+    if (benchmark.settings.enabled)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(backend->physicalDevice, &properties);
+        benchmark.deviceName = properties.deviceName;
+        benchmark.width = backend->swapChainExtent.width;
+        benchmark.height = backend->swapChainExtent.height;
+        benchmark.start(getSceneBounds());
+    }
+    createAutoExposureBuffers();
     initialize();
 
     sampler = std::make_shared<vpp::Sampler>(backend, 1, "Depth sampler");
+    shadowMap = std::make_shared<CascadedShadowMap>(backend);
 
     createGeometryPassImages();
     createDescriptorSets();
@@ -46,11 +64,36 @@ TriangleRenderer::TriangleRenderer(std::string app_name, uint32_t apiVersion, st
     createGeometryPassRenderPass();
     createGeometryPassPipeline();
     createGeometryPassFrameBuffer();
+    createLightCullingPipeline();
     createLightingPassPipeline();
+    createAutoExposurePipelines();
     createToneMappingPassPipeline();
+    createFusedOverlayRenderPass();
+
+    subpassDeferred = std::make_shared<SubpassDeferred>(backend, perFrameDescriptorSetLayout, lightingImageDescriptorSetLayout, depthImageDescriptorSetLayout, lightingDataDescriptorSetLayout, exposureBuffer, luminanceHistogramBuffer);
+
+    // After the depth image, which the application registered first
+    renderTargets->addResizeCallback("Renderer targets", [this](VkExtent2D extent) {
+        resizeRenderTargets();
+    });
+
+    gpuProfiler = std::make_shared<vpp::GpuProfiler>(backend, MAX_FRAMES_IN_FLIGHT);
+    lightingDispatchCounts.resize(MAX_FRAMES_IN_FLIGHT, 1);
+
+    if (vpp::AsyncCompute::isSupported(backend))
+    {
+        asyncCompute = std::make_shared<vpp::AsyncCompute>(backend, MAX_FRAMES_IN_FLIGHT);
+    }
 
     controls.ambientFactor = 0.1f;
     controls.sunlightIntensity = 3.0f;
+    controls.exposure = 0.0f;
+    controls.toneMappingOperator = vpp::TONE_MAPPING_ACES;
+    controls.minLogLuminance = -10.0f;
+    controls.logLuminanceRange = 22.0f;
+    controls.adaptationRate = 1.5f;
+    controls.bloomIntensity = 0.04f;
+    controls.sharpness = 0.2f;
 }
 
 void TriangleRenderer::cleanup_extended()
@@ -59,20 +102,10 @@ void TriangleRenderer::cleanup_extended()
 
     graphicsPipeline.reset();
 
-    perFrameDescriptorSetLayout.reset();
-
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		viewProjectionUniformBuffers[i].reset();
-        modelUniformBuffers[i].reset();
-        cameraLightInfoBuffers[i].reset();
-        controlUniformBuffers[i].reset();
-        viewportUniformBuffers[i].reset();
-	}
-
     vpp::Model::destroyModels(backend);
 
     perFrameDescriptorSetLayout.reset();
-    perFrameDescriptorSets.clear();
+    perFrameDescriptorSet.reset();
 
     vkDestroyFramebuffer(backend->device, geometryPassFrameBuffer, nullptr);
 
@@ -91,6 +124,9 @@ void TriangleRenderer::cleanup_extended()
 	roughnessImageView.reset();
 	roughnessImage.reset();
 
+	velocityImageView.reset();
+	velocityImage.reset();
+
 	vkDestroyRenderPass(backend->device, geometryPassRenderPass, nullptr);
 
     geometryPassGraphicsPipeline.reset();
@@ -100,12 +136,54 @@ void TriangleRenderer::cleanup_extended()
 	lightingImageView.reset();
 	lightingImage.reset();
 
+	ldrImageView.reset();
+	ldrImage.reset();
+
+	bloom.reset();
+	temporalAntiAliasing.reset();
+	subpassDeferred.reset();
+
+	// After every view of its transient images
+	renderGraph.reset();
+
+	shadowMap.reset();
+	ambientOcclusion.reset();
+
+	toneMappingInputDescriptorSetLayout.reset();
+	hdrInputDescriptorSet.reset();
+	ldrImageDescriptorSet.reset();
+	ldrInputDescriptorSet.reset();
+	swapChainImageDescriptorSets.clear();
+
+	luminanceHistogramComputePipeline.reset();
+	luminanceAverageComputePipeline.reset();
+	luminanceDescriptorSet.reset();
+	luminanceDescriptorSetLayout.reset();
+	luminanceHistogramBuffer.reset();
+	exposureBuffer.reset();
+	luminanceReadbackBuffers.clear();
+
 	lightingPassComputePipeline.reset();
+	lightingPassFp16ComputePipeline.reset();
+	fusedLightingPassComputePipeline.reset();
+	fusedLightingPassFp16ComputePipeline.reset();
+	lightCullingComputePipeline.reset();
+	depthlessLightCullingComputePipeline.reset();
+
+	gpuProfiler.reset();
+	asyncCompute.reset();
+
+	lightingDataDescriptorSets.clear();
+	lightingDataDescriptorSetLayout.reset();
+	lightBuffers.clear();
+	tileLightBuffer.reset();
 
     gBufferDescriptorSetLayout.reset();
     gBufferDescriptorSet.reset();
 
     toneMappingPassGraphicsPipeline.reset();
+    ldrPresentGraphicsPipeline.reset();
+    vkDestroyRenderPass(backend->device, fusedOverlayRenderPass, nullptr);
 
     sampler.reset();
     depthImageDescriptorSet.reset();
@@ -121,17 +199,40 @@ void TriangleRenderer::createGraphicsPipeline()
     graphicsPipeline->addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, "shaders/test.frag.spv");
     graphicsPipeline->addPushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(vpp::MainPushConstants));
     graphicsPipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
-    graphicsPipeline->addDescriptorSetLayout(vpp::Model::getTextureDescriptorSetLayout());
+    graphicsPipeline->addDescriptorSetLayout(vpp::Model::getBindlessHeap()->layout);
     graphicsPipeline->addDescriptorSetLayout(vpp::Model::getColorDescriptorSetLayout());
     graphicsPipeline->createPipeline();
 }
 
+static bool isSrgbFormat(VkFormat format)
+{
+    return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+}
+
 void TriangleRenderer::createToneMappingPassPipeline()
 {
+    // LDR_INPUT, ENCODE_SRGB
+    std::array<VkBool32, 2> hdrConstants = { VK_FALSE, isSrgbFormat(backend->swapChainImageFormat) ? VK_FALSE : VK_TRUE };
+    std::array<VkBool32, 2> ldrConstants = { VK_TRUE, hdrConstants[1] };
+
+    std::array<VkSpecializationMapEntry, 2> mapEntries{};
+    mapEntries[0] = { 0, 0, sizeof(VkBool32) };
+    mapEntries[1] = { 1, sizeof(VkBool32), sizeof(VkBool32) };
+
+    VkSpecializationInfo hdrSpecializationInfo{};
+    hdrSpecializationInfo.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+    hdrSpecializationInfo.pMapEntries = mapEntries.data();
+    hdrSpecializationInfo.dataSize = sizeof(hdrConstants);
+    hdrSpecializationInfo.pData = hdrConstants.data();
+
+    VkSpecializationInfo ldrSpecializationInfo = hdrSpecializationInfo;
+    ldrSpecializationInfo.pData = ldrConstants.data();
+
     toneMappingPassGraphicsPipeline = std::make_shared<vpp::GraphicsPipeline>(backend, "TriangleRenderer::Tone Mapping Pipeline", backend->swapChainRenderPass, VK_FALSE, VK_FALSE, 1);
     toneMappingPassGraphicsPipeline->addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, "shaders/toneMappingPass.vert.spv");
-    toneMappingPassGraphicsPipeline->addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, "shaders/toneMappingPass.frag.spv");
-    toneMappingPassGraphicsPipeline->addDescriptorSetLayout(lightingImageDescriptorSetLayout);
+    toneMappingPassGraphicsPipeline->addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, "shaders/toneMappingPass.frag.spv", &hdrSpecializationInfo);
+    toneMappingPassGraphicsPipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
+    toneMappingPassGraphicsPipeline->addDescriptorSetLayout(toneMappingInputDescriptorSetLayout);
 
     toneMappingPassGraphicsPipeline->vertexInputInfo.vertexAttributeDescriptionCount = 0;
     toneMappingPassGraphicsPipeline->vertexInputInfo.vertexBindingDescriptionCount = 0;
@@ -141,27 +242,168 @@ void TriangleRenderer::createToneMappingPassPipeline()
     toneMappingPassGraphicsPipeline->rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
     toneMappingPassGraphicsPipeline->createPipeline();
+
+    if (ldrImage)
+    {
+        ldrPresentGraphicsPipeline = std::make_shared<vpp::GraphicsPipeline>(backend, "TriangleRenderer::LDR Present Pipeline", backend->swapChainRenderPass, VK_FALSE, VK_FALSE, 1);
+        ldrPresentGraphicsPipeline->addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, "shaders/toneMappingPass.vert.spv");
+        ldrPresentGraphicsPipeline->addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, "shaders/toneMappingPass.frag.spv", &ldrSpecializationInfo);
+        ldrPresentGraphicsPipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
+        ldrPresentGraphicsPipeline->addDescriptorSetLayout(toneMappingInputDescriptorSetLayout);
+
+        ldrPresentGraphicsPipeline->vertexInputInfo.vertexAttributeDescriptionCount = 0;
+        ldrPresentGraphicsPipeline->vertexInputInfo.vertexBindingDescriptionCount = 0;
+        ldrPresentGraphicsPipeline->vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+        ldrPresentGraphicsPipeline->vertexInputInfo.pVertexBindingDescriptions = nullptr;
+        ldrPresentGraphicsPipeline->rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
+        ldrPresentGraphicsPipeline->rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+        ldrPresentGraphicsPipeline->createPipeline();
+    }
+}
+
+// Same attachments as the swapchain render pass, but keeps what the fused lighting pass wrote
+void TriangleRenderer::createFusedOverlayRenderPass()
+{
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.format = backend->swapChainImageFormat;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_GENERAL;
+    colorAttachment.finalLayout = backend->swapChainFinalLayout;
+
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = VK_FORMAT_D32_SFLOAT;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentRef{};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+
+    std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+
+    if (vkCreateRenderPass(backend->device, &renderPassInfo, nullptr, &fusedOverlayRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create fused overlay render pass!");
+    }
 }
 
 void TriangleRenderer::createLightingPassPipeline()
 {
-    lightingPassComputePipeline = std::make_shared<vpp::ComputePipeline>(backend, "TriangleRenderer::Lighting pass Pipeline", "shaders/lightingPass.comp.spv");
-    lightingPassComputePipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
-    lightingPassComputePipeline->addDescriptorSetLayout(gBufferDescriptorSetLayout);
-    lightingPassComputePipeline->addDescriptorSetLayout(lightingImageDescriptorSetLayout);
-    lightingPassComputePipeline->addDescriptorSetLayout(depthImageDescriptorSetLayout);
-    lightingPassComputePipeline->addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vpp::MainPushConstants));
-    lightingPassComputePipeline->createPipeline();
+    lightingPassComputePipeline = createLightingPassVariant("TriangleRenderer::Lighting pass Pipeline", "shaders/lightingPass.comp.spv", false);
+    fusedLightingPassComputePipeline = createLightingPassVariant("TriangleRenderer::Fused Lighting pass Pipeline", "shaders/lightingPass.comp.spv", true);
+
+    if (backend->shaderFloat16Supported)
+    {
+        lightingPassFp16ComputePipeline = createLightingPassVariant("TriangleRenderer::Lighting pass fp16 Pipeline", "shaders/lightingPassFp16.comp.spv", false);
+        fusedLightingPassFp16ComputePipeline = createLightingPassVariant("TriangleRenderer::Fused Lighting pass fp16 Pipeline", "shaders/lightingPassFp16.comp.spv", true);
+        useFp16Lighting = true;
+    }
+}
+
+std::shared_ptr<vpp::ComputePipeline> TriangleRenderer::createLightingPassVariant(std::string name, std::string path, bool fused)
+{
+    // FUSED_TONE_MAPPING
+    VkBool32 fusedConstant = fused ? VK_TRUE : VK_FALSE;
+    VkSpecializationMapEntry mapEntry = { 0, 0, sizeof(VkBool32) };
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &mapEntry;
+    specializationInfo.dataSize = sizeof(VkBool32);
+    specializationInfo.pData = &fusedConstant;
+
+    std::shared_ptr<vpp::ComputePipeline> pipeline = std::make_shared<vpp::ComputePipeline>(backend, name, path);
+    pipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
+    pipeline->addDescriptorSetLayout(gBufferDescriptorSetLayout);
+    pipeline->addDescriptorSetLayout(lightingImageDescriptorSetLayout);
+    pipeline->addDescriptorSetLayout(depthImageDescriptorSetLayout);
+    pipeline->addDescriptorSetLayout(lightingDataDescriptorSetLayout);
+    pipeline->addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vpp::MainPushConstants));
+    pipeline->pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+    pipeline->createPipeline();
+
+    return pipeline;
+}
+
+std::shared_ptr<vpp::ComputePipeline> TriangleRenderer::getLightingPassPipeline()
+{
+    if (useFp16Lighting && lightingPassFp16ComputePipeline)
+    {
+        return fusedToneMapping ? fusedLightingPassFp16ComputePipeline : lightingPassFp16ComputePipeline;
+    }
+
+    return fusedToneMapping ? fusedLightingPassComputePipeline : lightingPassComputePipeline;
+}
+
+void TriangleRenderer::createLightCullingPipeline()
+{
+    lightCullingComputePipeline = std::make_shared<vpp::ComputePipeline>(backend, "TriangleRenderer::Light culling Pipeline", "shaders/lightCulling.comp.spv");
+    lightCullingComputePipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
+    lightCullingComputePipeline->addDescriptorSetLayout(depthImageDescriptorSetLayout);
+    lightCullingComputePipeline->addDescriptorSetLayout(lightingDataDescriptorSetLayout);
+    lightCullingComputePipeline->createPipeline();
+
+    // DEPTH_BOUNDS, off for the subpass deferred path where culling runs before the depth is written
+    VkBool32 depthBounds = VK_FALSE;
+    VkSpecializationMapEntry mapEntry = { 0, 0, sizeof(VkBool32) };
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &mapEntry;
+    specializationInfo.dataSize = sizeof(VkBool32);
+    specializationInfo.pData = &depthBounds;
+
+    depthlessLightCullingComputePipeline = std::make_shared<vpp::ComputePipeline>(backend, "TriangleRenderer::Depthless Light culling Pipeline", "shaders/lightCulling.comp.spv");
+    depthlessLightCullingComputePipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
+    depthlessLightCullingComputePipeline->addDescriptorSetLayout(depthImageDescriptorSetLayout);
+    depthlessLightCullingComputePipeline->addDescriptorSetLayout(lightingDataDescriptorSetLayout);
+    depthlessLightCullingComputePipeline->pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+    depthlessLightCullingComputePipeline->createPipeline();
 }
 
 void TriangleRenderer::createGeometryPassPipeline()
 {
-    geometryPassGraphicsPipeline = std::make_shared<vpp::GraphicsPipeline>(backend, "TriangleRenderer::Geometry pass Pipeline", geometryPassRenderPass, VK_TRUE, VK_TRUE, 4);
+    geometryPassGraphicsPipeline = std::make_shared<vpp::GraphicsPipeline>(backend, "TriangleRenderer::Geometry pass Pipeline", geometryPassRenderPass, VK_TRUE, VK_TRUE, 5);
     geometryPassGraphicsPipeline->addShaderStage(VK_SHADER_STAGE_VERTEX_BIT, "shaders/geometryPass.vert.spv");
     geometryPassGraphicsPipeline->addShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, "shaders/geometryPass.frag.spv");
     geometryPassGraphicsPipeline->addPushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(vpp::MainPushConstants));
     geometryPassGraphicsPipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
-    geometryPassGraphicsPipeline->addDescriptorSetLayout(vpp::Model::getTextureDescriptorSetLayout());
+    geometryPassGraphicsPipeline->addDescriptorSetLayout(vpp::Model::getBindlessHeap()->layout);
     geometryPassGraphicsPipeline->addDescriptorSetLayout(vpp::Model::getColorDescriptorSetLayout());
     geometryPassGraphicsPipeline->createPipeline();
 }
@@ -176,8 +418,9 @@ void TriangleRenderer::createGeometryPassRenderPass()
     normalAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     normalAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     normalAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    normalAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    normalAttachment.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
+    // The render graph transitions the attachments around the pass, so it needs no dependencies of its own
+    normalAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    normalAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     VkAttachmentDescription depthAttachment{};
     depthAttachment.format = VK_FORMAT_D32_SFLOAT;
@@ -186,8 +429,8 @@ void TriangleRenderer::createGeometryPassRenderPass()
     depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkAttachmentDescription albedoAttachment = normalAttachment;
     albedoAttachment.format = albedoImage->format;
@@ -198,6 +441,9 @@ void TriangleRenderer::createGeometryPassRenderPass()
     VkAttachmentDescription roughnessAttachment = normalAttachment;
     roughnessAttachment.format = roughnessImage->format;
 
+    VkAttachmentDescription velocityAttachment = normalAttachment;
+    velocityAttachment.format = velocityImage->format;
+
     // Attachment references
     VkAttachmentReference depthAttachmentRef{};
     depthAttachmentRef.attachment = 0;
@@ -216,7 +462,10 @@ void TriangleRenderer::createGeometryPassRenderPass()
 	VkAttachmentReference roughnessAttachmentRef = normalAttachmentRef;
 	roughnessAttachmentRef.attachment = 4;
 
-    std::vector<VkAttachmentReference> colorAttachmentRefs = { normalAttachmentRef, albedoAttachmentRef, metallicAttachmentRef, roughnessAttachmentRef };
+	VkAttachmentReference velocityAttachmentRef = normalAttachmentRef;
+	velocityAttachmentRef.attachment = 5;
+
+    std::vector<VkAttachmentReference> colorAttachmentRefs = { normalAttachmentRef, albedoAttachmentRef, metallicAttachmentRef, roughnessAttachmentRef, velocityAttachmentRef };
 
     // Subpass
     VkSubpassDescription subpass{};
@@ -225,26 +474,7 @@ void TriangleRenderer::createGeometryPassRenderPass()
     subpass.pColorAttachments = colorAttachmentRefs.data();
     subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-    // Subpass dependencies
-    std::array<VkSubpassDependency, 2> dependencies;
-
-	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependencies[0].dstSubpass = 0;
-	dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependencies[0].dependencyFlags = 0;
-
-	dependencies[1].srcSubpass = 0;
-	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-    dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-    dependencies[1].dependencyFlags = 0;
-
-    std::vector<VkAttachmentDescription> attachments = { depthAttachment, normalAttachment, albedoAttachment, metallicAttachment, roughnessAttachment };
+    std::vector<VkAttachmentDescription> attachments = { depthAttachment, normalAttachment, albedoAttachment, metallicAttachment, roughnessAttachment, velocityAttachment };
 
     VkRenderPassCreateInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -252,8 +482,6 @@ void TriangleRenderer::createGeometryPassRenderPass()
 	renderPassInfo.pAttachments = attachments.data();
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = dependencies.size();
-    renderPassInfo.pDependencies = dependencies.data();
 
     if (vkCreateRenderPass(backend->device, &renderPassInfo, nullptr, &geometryPassRenderPass) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
@@ -262,12 +490,22 @@ void TriangleRenderer::createGeometryPassRenderPass()
 
 void TriangleRenderer::createGeometryPassFrameBuffer()
 {
+    if (geometryPassFrameBuffer != VK_NULL_HANDLE)
+    {
+        VkDevice device = backend->device;
+        VkFramebuffer oldFrameBuffer = geometryPassFrameBuffer;
+        renderTargets->retire([device, oldFrameBuffer]() {
+            vkDestroyFramebuffer(device, oldFrameBuffer, nullptr);
+        });
+    }
+
     std::vector<VkImageView> attachments = {
         backend->depthImageView->imageView,
         normalImageView->imageView,
         albedoImageView->imageView,
         metallicImageView->imageView,
-        roughnessImageView->imageView
+        roughnessImageView->imageView,
+        velocityImageView->imageView
     };
 
     VkFramebufferCreateInfo framebufferInfo{};
@@ -286,112 +524,494 @@ void TriangleRenderer::createGeometryPassFrameBuffer()
 
 void TriangleRenderer::createGeometryPassImages()
 {
-    positionImage = std::make_shared<vpp::Image>(backend, backend->swapChainExtent.width, backend->swapChainExtent.height, 1, 1, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Geometry pass::Position Image");
+    uint32_t width = backend->swapChainExtent.width;
+    uint32_t height = backend->swapChainExtent.height;
+
+    // On a resize the whole graph is rebuilt, the old one keeps its transient memory until the frames using it finish
+    if (renderGraph)
+    {
+        renderTargets->retire(renderGraph, positionImage, positionImageView, normalImageView, albedoImageView, metallicImageView, roughnessImageView, velocityImageView, lightingImageView, ldrImageView);
+    }
+
+    positionImage = std::make_shared<vpp::Image>(backend, width, height, 1, 1, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Geometry pass::Position Image");
     positionImageView = std::make_shared<vpp::ImageView>(backend, positionImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Position Image View");
 
-    normalImage = std::make_shared<vpp::Image>(backend, backend->swapChainExtent.width, backend->swapChainExtent.height, 1, 1, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Geometry pass::Normal Image");
-	normalImageView = std::make_shared<vpp::ImageView>(backend, normalImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Normal Image View");
+    renderGraph = std::make_shared<vpp::RenderGraph>(backend);
+
+    VkImageUsageFlags gBufferUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    normalResource = renderGraph->createImage("Geometry pass::Normal Image", width, height, 1, VK_FORMAT_R32G32B32A32_SFLOAT, gBufferUsage);
+    albedoResource = renderGraph->createImage("Geometry pass::Albedo Image", width, height, 1, VK_FORMAT_R8G8B8A8_UNORM, gBufferUsage);
+    metallicResource = renderGraph->createImage("Geometry pass::Metallic Image", width, height, 1, VK_FORMAT_R8G8_UNORM, gBufferUsage);
+    roughnessResource = renderGraph->createImage("Geometry pass::Roughness Image", width, height, 1, VK_FORMAT_R8_UNORM, gBufferUsage);
+    velocityResource = renderGraph->createImage("Geometry pass::Velocity Image", width, height, 1, VK_FORMAT_R16G16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+    // Lighting output only needs an unsigned HDR range, so prefer the 32 bit packed float format
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(backend->physicalDevice, VK_FORMAT_B10G11R11_UFLOAT_PACK32, &formatProperties);
+    VkFormatFeatureFlags hdrFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    VkFormat hdrFormat = (formatProperties.optimalTilingFeatures & hdrFeatures) == hdrFeatures ? VK_FORMAT_B10G11R11_UFLOAT_PACK32 : VK_FORMAT_R16G16B16A16_SFLOAT;
+
+    lightingResource = renderGraph->createImage("Lighting pass::HDR Image", width, height, 1, hdrFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+    // The async compute queue can't write the swapchain, so fused tone mapping goes through the LDR image there
+    if (!backend->swapChainStorageSupported || vpp::AsyncCompute::isSupported(backend))
+    {
+        ldrResource = renderGraph->createImage("Lighting pass::LDR Image", width, height, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+        ldrImage = renderGraph->getImage(ldrResource);
+    }
+
+    resolveResource = renderGraph->createImage("Temporal anti-aliasing::Output Image", width, height, 1, hdrFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+    VkExtent2D bloomExtent = Bloom::getBaseExtent(width, height);
+    bloomResource = renderGraph->createImage("Bloom::Image", bloomExtent.width, bloomExtent.height, Bloom::getMipCount(bloomExtent), hdrFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+    // Images that outlive the frame. The ones created later are set once they exist.
+    depthResource = renderGraph->importImage("Depth Image", backend->depthImage->image, 1, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+    shadowAtlasResource = renderGraph->importImage("Shadow pass::Atlas Image", shadowMap->atlasImage->image, 1, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    aoRawResource = renderGraph->importImage("Ambient occlusion::Raw Image", VK_NULL_HANDLE, 1, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+    aoOutputResource = renderGraph->importImage("Ambient occlusion::Output Image", VK_NULL_HANDLE, 1, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        historyResources[i] = renderGraph->importImage("Temporal anti-aliasing::History Image " + std::to_string(i), VK_NULL_HANDLE, 1, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+    }
+    swapChainResource = renderGraph->importImage("Swapchain Image", VK_NULL_HANDLE, 1, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+    tileLightResource = renderGraph->importBuffer("Tile light buffer", tileLightBuffer);
+    histogramResource = renderGraph->importBuffer("Luminance histogram buffer", luminanceHistogramBuffer);
+    exposureResource = renderGraph->importBuffer("Exposure buffer", exposureBuffer);
 
-	albedoImage = std::make_shared<vpp::Image>(backend, backend->swapChainExtent.width, backend->swapChainExtent.height, 1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Geometry pass::Albedo Image");
-	albedoImageView = std::make_shared<vpp::ImageView>(backend, albedoImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Albedo Image View");
+    // The lifetimes for aliasing come from a declaration of every path, so switching modes never overlaps two images in one block
+    declareRenderGraph(0, 0, true);
+    renderGraph->allocate();
 
-	metallicImage = std::make_shared<vpp::Image>(backend, backend->swapChainExtent.width, backend->swapChainExtent.height, 1, 1, VK_FORMAT_R8G8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Geometry pass::Metallic Image");
-	metallicImageView = std::make_shared<vpp::ImageView>(backend, metallicImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Metallic Image View");
+    normalImage = renderGraph->getImage(normalResource);
+    normalImageView = std::make_shared<vpp::ImageView>(backend, normalImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Normal Image View");
 
-	roughnessImage = std::make_shared<vpp::Image>(backend, backend->swapChainExtent.width, backend->swapChainExtent.height, 1, 1, VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Geometry pass::Roughness Image");
-	roughnessImageView = std::make_shared<vpp::ImageView>(backend, roughnessImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Roughness Image View");
+    albedoImage = renderGraph->getImage(albedoResource);
+    albedoImageView = std::make_shared<vpp::ImageView>(backend, albedoImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Albedo Image View");
 
-    lightingImage = std::make_shared<vpp::Image>(backend, backend->swapChainExtent.width, backend->swapChainExtent.height, 1, 1, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Geometry pass::Temp Out Image");
+    metallicImage = renderGraph->getImage(metallicResource);
+    metallicImageView = std::make_shared<vpp::ImageView>(backend, metallicImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Metallic Image View");
+
+    roughnessImage = renderGraph->getImage(roughnessResource);
+    roughnessImageView = std::make_shared<vpp::ImageView>(backend, roughnessImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Roughness Image View");
+
+    velocityImage = renderGraph->getImage(velocityResource);
+    velocityImageView = std::make_shared<vpp::ImageView>(backend, velocityImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Velocity Image View");
+
+    lightingImage = renderGraph->getImage(lightingResource);
     lightingImageView = std::make_shared<vpp::ImageView>(backend, lightingImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "Lighting Image View");
-    lightingImage->transitionLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+
+    if (ldrImage)
+    {
+        ldrImageView = std::make_shared<vpp::ImageView>(backend, ldrImage, 0, 1, VK_IMAGE_ASPECT_COLOR_BIT, "LDR Image View");
+    }
+
+    if (temporalAntiAliasing)
+    {
+        temporalAntiAliasing->resize(*renderTargets, lightingImageView, backend->depthImageView, velocityImageView, renderGraph->getImage(resolveResource));
+        bloom->resize(*renderTargets, temporalAntiAliasing->outputImageView, renderGraph->getImage(bloomResource));
+    }
+    else
+    {
+        temporalAntiAliasing = std::make_shared<TemporalAntiAliasing>(backend, lightingImageView, backend->depthImageView, velocityImageView, renderGraph->getImage(resolveResource));
+        bloom = std::make_shared<Bloom>(backend, temporalAntiAliasing->outputImageView, renderGraph->getImage(bloomResource));
+    }
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        renderGraph->setImage(historyResources[i], temporalAntiAliasing->historyImages[i]->image, 1, VK_IMAGE_LAYOUT_UNDEFINED);
+    }
 }
 
-void TriangleRenderer::renderObjects()
+// The same passes in the same order every frame, the current mode only enables and disables them.
+// With allPaths every access any mode can make is declared, which is what the transient lifetimes come from.
+void TriangleRenderer::declareRenderGraph(uint32_t currentFrame, uint32_t imageIndex, bool allPaths)
 {
-    vpp::MainPushConstants pushConstants;
+    const VkPipelineStageFlags2 compute = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    const VkPipelineStageFlags2 fragment = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    const VkPipelineStageFlags2 depthTests = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+    const VkPipelineStageFlags2 colorOutput = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    const VkPipelineStageFlags2 transfer = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    const VkAccessFlags2 shaderRead = VK_ACCESS_2_SHADER_READ_BIT;
+    const VkAccessFlags2 shaderWrite = VK_ACCESS_2_SHADER_WRITE_BIT;
+    const VkAccessFlags2 depthAttachment = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    const VkImageLayout depthReadOnly = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    bool fused = !allPaths && fusedToneMapping;
+    bool intoSwapChain = !allPaths && fusedIntoSwapChain();
+    bool subpass = !allPaths && subpassDeferred->enabled;
+    bool loadsSwapChain = intoSwapChain || subpass;
+
+    renderGraph->reset();
+
+    vpp::RenderGraphPass pass = renderGraph->addPass("Geometry pass", GEOMETRY_BATCH, [this, currentFrame](VkCommandBuffer commandBuffer) {
+        vpp::GpuProfileScope profileScope(*gpuProfiler, commandBuffer, "Geometry pass");
+        beginGeometryPass(commandBuffer, currentFrame);
+        renderObjects(commandBuffer);
+        vkCmdEndRenderPass(commandBuffer);
+    }, allPaths || !subpass);
+    renderGraph->write(pass, depthResource, depthTests, depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    for (vpp::RenderGraphResource resource : { normalResource, albedoResource, metallicResource, roughnessResource, velocityResource })
+    {
+        renderGraph->write(pass, resource, colorOutput, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    }
+
+    // After the geometry, so the depth-only compute passes below can run next to the cascades
+    pass = renderGraph->addPass("Shadows", SHADOW_BATCH, [this](VkCommandBuffer commandBuffer) {
+        vpp::GpuProfileScope profileScope(*gpuProfiler, commandBuffer, "Shadows");
+        shadowMap->record(commandBuffer, shadowCasters);
+    }, allPaths || shadowMap->hasDirtyCascades());
+    renderGraph->write(pass, shadowAtlasResource, depthTests, depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+    pass = renderGraph->addPass("Clear luminance histogram", CULLING_BATCH, [this](VkCommandBuffer commandBuffer) {
+        clearLuminanceHistogram(commandBuffer);
+    });
+    renderGraph->write(pass, histogramResource, transfer, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+    // The depthless variant for the subpass path still has the depth image bound
+    pass = renderGraph->addPass("Light culling", CULLING_BATCH, [this, currentFrame](VkCommandBuffer commandBuffer) {
+        recordLightCulling(commandBuffer, currentFrame);
+    });
+    renderGraph->read(pass, depthResource, compute, shaderRead, depthReadOnly);
+    renderGraph->write(pass, tileLightResource, compute, shaderWrite);
+
+    // Geometry, lighting and tone mapping as subpasses, the G-buffer and depth never leave the render pass
+    pass = renderGraph->addPass("Subpass deferred", PRESENT_BATCH, [this, currentFrame, imageIndex](VkCommandBuffer commandBuffer) {
+        vpp::GpuProfileScope profileScope(*gpuProfiler, commandBuffer, "Subpass deferred");
+        subpassDeferred->record(commandBuffer, imageIndex, perFrameDescriptorSet->descriptorSet, perFrameOffsets, depthImageDescriptorSet->descriptorSet,
+            lightingDataDescriptorSets[currentFrame]->descriptorSet, { viewportOffset, shadowDataOffset }, [this](VkCommandBuffer commandBuffer) { renderObjects(commandBuffer); });
+    }, allPaths || subpass);
+    renderGraph->read(pass, shadowAtlasResource, fragment, shaderRead, depthReadOnly);
+    renderGraph->read(pass, aoOutputResource, fragment, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+    renderGraph->read(pass, tileLightResource, fragment, shaderRead);
+    renderGraph->read(pass, exposureResource, fragment, shaderRead);
+    renderGraph->read(pass, histogramResource, fragment, shaderRead);
+    renderGraph->write(pass, histogramResource, fragment, shaderWrite);
+    renderGraph->write(pass, swapChainResource, colorOutput, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+    pass = renderGraph->addPass("Ambient occlusion", CULLING_BATCH, [this, currentFrame](VkCommandBuffer commandBuffer) {
+        vpp::GpuProfileScope profileScope(*gpuProfiler, commandBuffer, "Ambient occlusion");
+        ambientOcclusion->record(commandBuffer, perFrameDescriptorSet->descriptorSet, perFrameOffsets, getRenderExtent());
+    }, allPaths || ambientOcclusion->enabled);
+    renderGraph->read(pass, depthResource, compute, shaderRead, depthReadOnly);
+    renderGraph->read(pass, normalResource, compute, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+    renderGraph->read(pass, aoRawResource, compute, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+    renderGraph->write(pass, aoRawResource, compute, shaderWrite, VK_IMAGE_LAYOUT_GENERAL);
+    renderGraph->write(pass, aoOutputResource, compute, shaderWrite, VK_IMAGE_LAYOUT_GENERAL);
+
+    // Fused, the lighting pass tone maps into the LDR image or the swapchain and accumulates the histogram
+    pass = renderGraph->addPass("Lighting", LIGHTING_BATCH, [this, currentFrame, imageIndex](VkCommandBuffer commandBuffer) {
+        recordLightingPass(commandBuffer, currentFrame, imageIndex);
+    }, allPaths || !subpass);
+    for (vpp::RenderGraphResource resource : { normalResource, albedoResource, metallicResource, roughnessResource, aoOutputResource })
+    {
+        renderGraph->read(pass, resource, compute, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+    }
+    renderGraph->read(pass, depthResource, compute, shaderRead, depthReadOnly);
+    renderGraph->read(pass, shadowAtlasResource, compute, shaderRead, depthReadOnly);
+    renderGraph->read(pass, tileLightResource, compute, shaderRead);
+    if (allPaths || !fused)
+    {
+        renderGraph->write(pass, lightingResource, compute, shaderWrite, VK_IMAGE_LAYOUT_GENERAL);
+    }
+    if (allPaths || fused)
+    {
+        renderGraph->read(pass, histogramResource, compute, shaderRead);
+        renderGraph->write(pass, histogramResource, compute, shaderWrite);
+        renderGraph->read(pass, exposureResource, compute, shaderRead);
+    }
+    if (ldrImage && (allPaths || (fused && !intoSwapChain)))
+    {
+        renderGraph->write(pass, ldrResource, compute, shaderWrite, VK_IMAGE_LAYOUT_GENERAL);
+    }
+    if (allPaths || intoSwapChain)
+    {
+        renderGraph->write(pass, swapChainResource, compute, shaderWrite, VK_IMAGE_LAYOUT_GENERAL);
+    }
 
-    for (auto& model : models)
+    // Nothing reads the resolve in fused mode, so it is culled there along with bloom
+    pass = renderGraph->addPass("Temporal resolve", LIGHTING_BATCH, [this](VkCommandBuffer commandBuffer) {
+        recordTemporalResolve(commandBuffer);
+    });
+    renderGraph->read(pass, lightingResource, compute, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+    renderGraph->read(pass, velocityResource, compute, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+    renderGraph->read(pass, depthResource, compute, shaderRead, depthReadOnly);
+    for (vpp::RenderGraphResource resource : historyResources)
     {
-        pushConstants.textureType = uint32_t(model->textureType);
-        pushConstants.modelTransform = model->getModelMatrix();
+        renderGraph->read(pass, resource, compute, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+        renderGraph->write(pass, resource, compute, shaderWrite, VK_IMAGE_LAYOUT_GENERAL);
+    }
+    renderGraph->write(pass, resolveResource, compute, shaderWrite, VK_IMAGE_LAYOUT_GENERAL);
+
+    pass = renderGraph->addPass("Luminance histogram", LIGHTING_BATCH, [this, currentFrame](VkCommandBuffer commandBuffer) {
+        recordLuminanceHistogram(commandBuffer, currentFrame);
+    }, allPaths || (!fused && !subpass));
+    renderGraph->read(pass, resolveResource, compute, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+    renderGraph->read(pass, histogramResource, compute, shaderRead);
+    renderGraph->write(pass, histogramResource, compute, shaderWrite);
+
+    pass = renderGraph->addPass("Auto exposure", LIGHTING_BATCH, [this, currentFrame](VkCommandBuffer commandBuffer) {
+        recordAutoExposure(commandBuffer, currentFrame);
+    });
+    renderGraph->read(pass, histogramResource, compute, shaderRead);
+    renderGraph->write(pass, histogramResource, compute, shaderWrite);
+    renderGraph->read(pass, exposureResource, compute, shaderRead);
+    renderGraph->write(pass, exposureResource, compute, shaderWrite);
+
+    pass = renderGraph->addPass("Luminance readback", LIGHTING_BATCH, [this, currentFrame](VkCommandBuffer commandBuffer) {
+        recordLuminanceReadback(commandBuffer, currentFrame);
+    });
+    renderGraph->read(pass, histogramResource, transfer, VK_ACCESS_2_TRANSFER_READ_BIT);
+    renderGraph->read(pass, exposureResource, transfer, VK_ACCESS_2_TRANSFER_READ_BIT);
+    renderGraph->keep(pass);
+
+    pass = renderGraph->addPass("Bloom", LIGHTING_BATCH, [this](VkCommandBuffer commandBuffer) {
+        recordBloom(commandBuffer);
+    }, allPaths || (bloom->enabled && !fused));
+    renderGraph->read(pass, resolveResource, compute, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+    renderGraph->read(pass, bloomResource, compute, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+    renderGraph->write(pass, bloomResource, compute, shaderWrite, VK_IMAGE_LAYOUT_GENERAL);
+
+    // Tone mapping and ImGui in the swapchain render pass, which clears depth again for the overlay
+    pass = renderGraph->addPass("Present", PRESENT_BATCH, [this, currentFrame, imageIndex](VkCommandBuffer commandBuffer) {
+        beginRenderPass(currentFrame, imageIndex);
+
+        // Fused into a storage swapchain or in the subpass path, the final image is already there
+        if (!presentLoadsSwapChain())
+        {
+            std::shared_ptr<vpp::GraphicsPipeline> presentPipeline = fusedToneMapping ? ldrPresentGraphicsPipeline : toneMappingPassGraphicsPipeline;
+            std::shared_ptr<vpp::SuperDescriptorSet> inputDescriptorSet = fusedToneMapping ? ldrInputDescriptorSet : hdrInputDescriptorSet;
+
+            vpp::GpuProfileScope profileScope(*gpuProfiler, commandBuffer, "Tone mapping");
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, presentPipeline->pipeline);
+            setDynamicState(commandBuffer, backend->swapChainExtent);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, presentPipeline->pipelineLayout, 0, 1, &perFrameDescriptorSet->descriptorSet, static_cast<uint32_t>(perFrameOffsets.size()), perFrameOffsets.data());
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, presentPipeline->pipelineLayout, 1, 1, &inputDescriptorSet->descriptorSet, 0, nullptr);
+            vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        }
 
-        if (model->hasTree)
+        uint32_t scope = gpuProfiler->beginScope(commandBuffer, "ImGui");
+        ImGui::Render();
+        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+        gpuProfiler->endScope(commandBuffer, scope);
+
+        vkCmdEndRenderPass(commandBuffer);
+    });
+    renderGraph->write(pass, depthResource, depthTests, depthAttachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    if (allPaths || !loadsSwapChain)
+    {
+        if (allPaths || !fused)
         {
-            for (auto& node : model->nodes)
-            {
-                pushConstants.submeshTransform = node.transform;
-                pushConstants.materialIndex = model->meshes[node.meshIndex].materialIndex;
-                pushConstants.colorIndex = model->meshes[node.meshIndex].colorIndex;
-                vkCmdPushConstants(backend->commandBuffers[currentFrame], graphicsPipeline->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(vpp::MainPushConstants), &pushConstants);
-                vkCmdDrawIndexed(backend->commandBuffers[currentFrame], model->meshes[node.meshIndex].indexCount, 1, model->meshes[node.meshIndex].startIndex, 0, 0);
-            }
+            renderGraph->read(pass, resolveResource, fragment, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
         }
-        else
+        if (ldrImage && (allPaths || fused))
+        {
+            renderGraph->read(pass, ldrResource, fragment, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+        }
+        if (allPaths || (bloom->enabled && !fused))
         {
-            pushConstants.submeshTransform = glm::mat4(1.0f);
+            renderGraph->read(pass, bloomResource, fragment, shaderRead, VK_IMAGE_LAYOUT_GENERAL);
+        }
+        renderGraph->read(pass, exposureResource, fragment, shaderRead);
+    }
+    if (allPaths || loadsSwapChain)
+    {
+        // The overlay loads what the lighting or composition pass wrote
+        renderGraph->read(pass, swapChainResource, colorOutput, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+        renderGraph->write(pass, swapChainResource, colorOutput, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+    }
+    renderGraph->keep(pass);
+}
 
-            for (auto& mesh : model->meshes)
-            {
-                pushConstants.materialIndex = mesh.materialIndex;
-                pushConstants.colorIndex = mesh.colorIndex;
-                vkCmdPushConstants(backend->commandBuffers[currentFrame], graphicsPipeline->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(vpp::MainPushConstants), &pushConstants);
-                vkCmdDrawIndexed(backend->commandBuffers[currentFrame], mesh.indexCount, 1, mesh.startIndex, 0, 0);
-            }
+void TriangleRenderer::renderObjects(VkCommandBuffer commandBuffer)
+{
+    const std::vector<glm::mat4>& transforms = scene->getTransforms();
+    const std::vector<vpp::MeshRef>& meshes = scene->getMeshes();
+    const std::vector<vpp::MaterialRef>& materials = scene->getMaterials();
+    std::shared_ptr<vpp::GeometryArena> geometryArena = vpp::Model::getGeometryArena();
+
+    // Entity transforms already include the node's, the submesh transform stays identity
+    vpp::MainPushConstants pushConstants;
+    pushConstants.submeshTransform = glm::mat4(1.0f);
+
+    for (uint32_t index : drawList)
+    {
+        const vpp::MaterialRef& material = materials[index];
+        const vpp::MaterialSlots& slots = vpp::Model::getMaterialSlots(material.materialIndex);
+        pushConstants.modelTransform = transforms[index];
+        pushConstants.albedoIndex = slots.albedo;
+        pushConstants.ormIndex = slots.orm;
+        pushConstants.colorIndex = material.colorIndex;
+        pushConstants.textureType = uint32_t(material.textureType);
+        vkCmdPushConstants(commandBuffer, graphicsPipeline->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(vpp::MainPushConstants), &pushConstants);
+        const vpp::MeshRef& mesh = meshes[index];
+        vpp::GeometryRange range = geometryArena->getRange(mesh.geometry);
+        vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, range.firstIndex + mesh.startIndex, static_cast<int32_t>(range.firstVertex + mesh.startVertex), 0);
+    }
+}
+
+void TriangleRenderer::recordLightingPass(VkCommandBuffer commandBuffer, uint32_t currentFrame, uint32_t imageIndex)
+{
+    std::shared_ptr<vpp::ComputePipeline> pipeline = getLightingPassPipeline();
+
+    std::shared_ptr<vpp::SuperDescriptorSet> outputDescriptorSet = lightingImageDescriptorSet;
+
+    if (fusedIntoSwapChain())
+    {
+        outputDescriptorSet = swapChainImageDescriptorSets[imageIndex];
+    }
+    else if (fusedToneMapping)
+    {
+        outputDescriptorSet = ldrImageDescriptorSet;
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipelineLayout, 0, 1, &perFrameDescriptorSet->descriptorSet, static_cast<uint32_t>(perFrameOffsets.size()), perFrameOffsets.data());
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipelineLayout, 1, 1, &gBufferDescriptorSet->descriptorSet, 0, nullptr);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipelineLayout, 2, 1, &outputDescriptorSet->descriptorSet, 0, nullptr);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipelineLayout, 3, 1, &depthImageDescriptorSet->descriptorSet, 1, &viewportOffset);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipelineLayout, 4, 1, &lightingDataDescriptorSets[currentFrame]->descriptorSet, 1, &shadowDataOffset);
+
+    VkExtent2D renderExtent = getRenderExtent();
+    uint32_t groupCountX = (renderExtent.width + vpp::LIGHT_TILE_SIZE - 1) / vpp::LIGHT_TILE_SIZE;
+    uint32_t groupCountY = (renderExtent.height + vpp::LIGHT_TILE_SIZE - 1) / vpp::LIGHT_TILE_SIZE;
+
+    // The benchmark repeats the dispatch so the timestamps measure the lighting pass on its own
+    uint32_t dispatchCount = lightingBenchmark ? static_cast<uint32_t>(lightingBenchmarkIterations) : 1;
+    lightingDispatchCounts[currentFrame] = dispatchCount;
+
+    vpp::GpuProfileScope profileScope(*gpuProfiler, commandBuffer, "Lighting");
+
+    for (uint32_t i = 0; i < dispatchCount; i++)
+    {
+        if (i > 0)
+        {
+            VkMemoryBarrier memoryBarrier{};
+            memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
         }
+
+        vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
     }
 }
 
+void TriangleRenderer::recordTemporalResolve(VkCommandBuffer commandBuffer)
+{
+    vpp::GpuProfileScope profileScope(*gpuProfiler, commandBuffer, "Temporal resolve");
+    temporalAntiAliasing->record(commandBuffer, getRenderExtent(), camera.jitter);
+}
+
+VkExtent2D TriangleRenderer::getRenderExtent()
+{
+    VkExtent2D extent;
+    extent.width = std::max(static_cast<uint32_t>(backend->swapChainExtent.width * renderScale), 1u);
+    extent.height = std::max(static_cast<uint32_t>(backend->swapChainExtent.height * renderScale), 1u);
+    return extent;
+}
+
+void TriangleRenderer::recordBloom(VkCommandBuffer commandBuffer)
+{
+    uint32_t scope = gpuProfiler->beginScope(commandBuffer, "Bloom downsample");
+    bloom->recordDownsample(commandBuffer);
+    gpuProfiler->endScope(commandBuffer, scope);
+
+    scope = gpuProfiler->beginScope(commandBuffer, "Bloom upsample");
+    bloom->recordUpsample(commandBuffer);
+    gpuProfiler->endScope(commandBuffer, scope);
+}
+
+void TriangleRenderer::recordLightCulling(VkCommandBuffer commandBuffer, uint32_t currentFrame)
+{
+    std::shared_ptr<vpp::ComputePipeline> pipeline = subpassDeferred->enabled ? depthlessLightCullingComputePipeline : lightCullingComputePipeline;
+
+    vpp::GpuProfileScope profileScope(*gpuProfiler, commandBuffer, "Light culling");
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipelineLayout, 0, 1, &perFrameDescriptorSet->descriptorSet, static_cast<uint32_t>(perFrameOffsets.size()), perFrameOffsets.data());
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipelineLayout, 1, 1, &depthImageDescriptorSet->descriptorSet, 1, &viewportOffset);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipelineLayout, 2, 1, &lightingDataDescriptorSets[currentFrame]->descriptorSet, 1, &shadowDataOffset);
+
+    // Tiles keep the full resolution stride, only the rendered ones are culled
+    VkExtent2D renderExtent = getRenderExtent();
+    uint32_t renderTileCountX = (renderExtent.width + vpp::LIGHT_TILE_SIZE - 1) / vpp::LIGHT_TILE_SIZE;
+    uint32_t renderTileCountY = (renderExtent.height + vpp::LIGHT_TILE_SIZE - 1) / vpp::LIGHT_TILE_SIZE;
+    vkCmdDispatch(commandBuffer, renderTileCountX, renderTileCountY, 1);
+}
+
+// The subpass deferred path renders everything in one graphics render pass, with nothing left to overlap
+bool TriangleRenderer::useAsyncCompute()
+{
+    return asyncComputeEnabled && asyncCompute != nullptr && !subpassDeferred->enabled;
+}
+
+// The fused lighting pass writes straight into a storage swapchain, unless it runs on the compute queue
+bool TriangleRenderer::fusedIntoSwapChain()
+{
+    return fusedToneMapping && backend->swapChainStorageSupported && !useAsyncCompute();
+}
+
+// The swapchain already holds the tone mapped image, the present pass only draws ImGui over it
+bool TriangleRenderer::presentLoadsSwapChain()
+{
+    return fusedIntoSwapChain() || subpassDeferred->enabled;
+}
+
 void TriangleRenderer::recordCommandBuffer(uint32_t currentFrame, uint32_t imageIndex)
 {
+    VPP_PROFILE_FUNCTION();
+
     beginCommandBuffer();
 
-    {
-        // Geometry pass
-        beginGeometryPass(currentFrame, imageIndex);
-        renderObjects();
-        vkCmdEndRenderPass(backend->commandBuffers[currentFrame]);
+    // Without async compute every batch is recorded into the frame's command buffer
+    bool async = useAsyncCompute();
+    VkCommandBuffer frameCommandBuffer = commandBuffer;
+    VkCommandBuffer geometryCommandBuffer = async ? asyncCompute->begin(vpp::GRAPHICS_QUEUE, currentFrame, 0) : frameCommandBuffer;
+    VkCommandBuffer shadowCommandBuffer = async ? asyncCompute->begin(vpp::GRAPHICS_QUEUE, currentFrame, 1) : frameCommandBuffer;
+    VkCommandBuffer cullingCommandBuffer = async ? asyncCompute->begin(vpp::COMPUTE_QUEUE, currentFrame, 0) : frameCommandBuffer;
+    VkCommandBuffer lightingCommandBuffer = async ? asyncCompute->begin(vpp::COMPUTE_QUEUE, currentFrame, 1) : frameCommandBuffer;
 
-        VkImageMemoryBarrier imageMemoryBarrier{};
-        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-        imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        imageMemoryBarrier.image = lightingImage->image;
-        imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-        imageMemoryBarrier.subresourceRange.levelCount = 1;
-        imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarrier.subresourceRange.layerCount = 1;
-        imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        vkCmdPipelineBarrier(backend->commandBuffers[currentFrame], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+    gpuProfiler->beginFrame(geometryCommandBuffer, currentFrame, static_cast<float>(deltaTime * 1000.0));
 
-        // Lighting pass
-        vkCmdBindPipeline(backend->commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_COMPUTE, lightingPassComputePipeline->pipeline);
+    // Geometry uploads and compaction moves land before the first draw of the frame
+    vpp::Model::getGeometryArena()->record(geometryCommandBuffer, frameContexts->getCurrentFrameNumber());
 
-		vkCmdBindDescriptorSets(backend->commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_COMPUTE, lightingPassComputePipeline->pipelineLayout, 0, 1, &perFrameDescriptorSets[currentFrame]->descriptorSet, 0, nullptr);
-		vkCmdBindDescriptorSets(backend->commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_COMPUTE, lightingPassComputePipeline->pipelineLayout, 1, 1, &gBufferDescriptorSet->descriptorSet, 0, nullptr);
-		vkCmdBindDescriptorSets(backend->commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_COMPUTE, lightingPassComputePipeline->pipelineLayout, 2, 1, &lightingImageDescriptorSet->descriptorSet, 0, nullptr);
-        vkCmdBindDescriptorSets(backend->commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_COMPUTE, lightingPassComputePipeline->pipelineLayout, 3, 1, &depthImageDescriptorSet->descriptorSet, 0, nullptr);
+    renderGraph->setImage(swapChainResource, backend->swapChainImages[imageIndex], 1, VK_IMAGE_LAYOUT_UNDEFINED);
+    declareRenderGraph(currentFrame, imageIndex);
 
-		vkCmdDispatch(backend->commandBuffers[currentFrame], backend->swapChainExtent.width / 16, backend->swapChainExtent.height / 16, 1);
-    }
+    vpp::QueueType computeQueue = async ? vpp::COMPUTE_QUEUE : vpp::GRAPHICS_QUEUE;
+    std::vector<vpp::RenderGraphBatch> batches(RENDER_BATCH_COUNT);
+    batches[GEOMETRY_BATCH] = { geometryCommandBuffer, vpp::GRAPHICS_QUEUE };
+    batches[SHADOW_BATCH] = { shadowCommandBuffer, vpp::GRAPHICS_QUEUE };
+    batches[CULLING_BATCH] = { cullingCommandBuffer, computeQueue };
+    batches[LIGHTING_BATCH] = { lightingCommandBuffer, computeQueue };
+    batches[PRESENT_BATCH] = { frameCommandBuffer, vpp::GRAPHICS_QUEUE };
+    renderGraph->execute(batches);
 
-    beginRenderPass(currentFrame, imageIndex);
+    if (async)
+    {
+        // The previous frame's compute work must be done with the persistent images and the aliased transient memory
+        vpp::SemaphoreWait previousCompute = asyncCompute->waitFor(vpp::COMPUTE_QUEUE, asyncCompute->getSubmittedValue(vpp::COMPUTE_QUEUE), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        uint64_t geometryDone = asyncCompute->submit(vpp::GRAPHICS_QUEUE, geometryCommandBuffer, { previousCompute });
+        uint64_t shadowsDone = asyncCompute->submit(vpp::GRAPHICS_QUEUE, shadowCommandBuffer, { previousCompute });
 
-    vkCmdBindPipeline(backend->commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, toneMappingPassGraphicsPipeline->pipeline);
-    setDynamicState();
-    vkCmdBindDescriptorSets(backend->commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, toneMappingPassGraphicsPipeline->pipelineLayout, 0, 1, &lightingImageDescriptorSet->descriptorSet, 0, nullptr);
-    vkCmdDraw(backend->commandBuffers[currentFrame], 3, 1, 0, 0);
+        // Culling and AO only read depth, so they overlap the shadow rasterization
+        asyncCompute->submit(vpp::COMPUTE_QUEUE, cullingCommandBuffer, { asyncCompute->waitFor(vpp::GRAPHICS_QUEUE, geometryDone, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT) });
+        uint64_t computeDone = asyncCompute->submit(vpp::COMPUTE_QUEUE, lightingCommandBuffer, { asyncCompute->waitFor(vpp::GRAPHICS_QUEUE, shadowsDone, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) });
 
-    // Imgui
-    ImGui::Render();
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), backend->commandBuffers[currentFrame]);
+        // The overlay clears the depth the compute passes were reading, so the depth tests wait too
+        frameContexts->addWait(asyncCompute->waitFor(vpp::COMPUTE_QUEUE, computeDone, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT));
+    }
+    else if (asyncCompute && asyncCompute->getSubmittedValue(vpp::COMPUTE_QUEUE) > 0)
+    {
+        // Switched off at runtime, the compute queue may still be working on earlier frames
+        frameContexts->addWait(asyncCompute->waitFor(vpp::COMPUTE_QUEUE, asyncCompute->getSubmittedValue(vpp::COMPUTE_QUEUE), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT));
+    }
 
-    vkCmdEndRenderPass(backend->commandBuffers[currentFrame]);
+    gpuProfiler->endFrame(frameCommandBuffer);
 
-    if (vkEndCommandBuffer(backend->commandBuffers[currentFrame]) != VK_SUCCESS) {
+    if (vkEndCommandBuffer(frameCommandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
 }
@@ -400,7 +1020,7 @@ void TriangleRenderer::beginRenderPass(uint32_t currentFrame, uint32_t imageInde
 {
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = backend->swapChainRenderPass;
+    renderPassInfo.renderPass = presentLoadsSwapChain() ? fusedOverlayRenderPass : backend->swapChainRenderPass;
     renderPassInfo.framebuffer = backend->swapChainFramebuffers[imageIndex];
     renderPassInfo.renderArea.offset = { 0, 0 };
     renderPassInfo.renderArea.extent = backend->swapChainExtent;
@@ -415,14 +1035,14 @@ void TriangleRenderer::beginRenderPass(uint32_t currentFrame, uint32_t imageInde
     vkCmdBeginRenderPass(backend->commandBuffers[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 }
 
-void TriangleRenderer::beginGeometryPass(uint32_t currentFrame, uint32_t imageIndex)
+void TriangleRenderer::beginGeometryPass(VkCommandBuffer commandBuffer, uint32_t currentFrame)
 {
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass = geometryPassRenderPass;
     renderPassInfo.framebuffer = geometryPassFrameBuffer;
     renderPassInfo.renderArea.offset = { 0, 0 };
-    renderPassInfo.renderArea.extent = backend->swapChainExtent;
+    renderPassInfo.renderArea.extent = getRenderExtent();
 
     std::vector<VkClearValue> clearValues(6);
     clearValues[0].depthStencil = { 1.0f, 0 };
@@ -435,53 +1055,49 @@ void TriangleRenderer::beginGeometryPass(uint32_t currentFrame, uint32_t imageIn
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues = clearValues.data();
 
-    vkCmdBeginRenderPass(backend->commandBuffers[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    vkCmdBindPipeline(backend->commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPassGraphicsPipeline->pipeline);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, geometryPassGraphicsPipeline->pipeline);
 
-    setDynamicState();
+    setDynamicState(commandBuffer, renderPassInfo.renderArea.extent);
 
     VkDeviceSize offsets[] = { 0 };
 
-    vkCmdBindVertexBuffers(backend->commandBuffers[currentFrame], 0, 1, &(vpp::Model::getVertexBuffer()->buffer), offsets);
-    vkCmdBindIndexBuffer(backend->commandBuffers[currentFrame], vpp::Model::getIndexBuffer()->buffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &(vpp::Model::getVertexBuffer()->buffer), offsets);
+    vkCmdBindIndexBuffer(commandBuffer, vpp::Model::getIndexBuffer()->buffer, 0, VK_INDEX_TYPE_UINT32);
 
-    vkCmdBindDescriptorSets(backend->commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->pipelineLayout, 0, 1, &perFrameDescriptorSets[currentFrame]->descriptorSet, 0, nullptr);
-    vkCmdBindDescriptorSets(backend->commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->pipelineLayout, 1, 1, &vpp::Model::getTextureDescriptorSet()->descriptorSet, 0, nullptr);
-    vkCmdBindDescriptorSets(backend->commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->pipelineLayout, 2, 1, &vpp::Model::getColorDescriptorSet()->descriptorSet, 0, nullptr);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->pipelineLayout, 0, 1, &perFrameDescriptorSet->descriptorSet, static_cast<uint32_t>(perFrameOffsets.size()), perFrameOffsets.data());
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->pipelineLayout, 1, 1, &vpp::Model::getBindlessHeap()->descriptorSet, 0, nullptr);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->pipelineLayout, 2, 1, &vpp::Model::getColorDescriptorSet()->descriptorSet, 0, nullptr);
 }
 
-void TriangleRenderer::setDynamicState()
+void TriangleRenderer::setDynamicState(VkCommandBuffer commandBuffer, VkExtent2D extent)
 {
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = static_cast<float>(backend->swapChainExtent.width);
-    viewport.height = static_cast<float>(backend->swapChainExtent.height);
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(backend->commandBuffers[currentFrame], 0, 1, &viewport);
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
     VkRect2D scissor{};
     scissor.offset = { 0, 0 };
-    scissor.extent = backend->swapChainExtent;
-    vkCmdSetScissor(backend->commandBuffers[currentFrame], 0, 1, &scissor);
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
 
 void TriangleRenderer::main_loop_extended(uint32_t currentFrame, uint32_t imageIndex)
 {
+    // Texture slots freed by streaming are reused once the frames that sampled them are done, geometry ranges likewise
+    vpp::Model::getBindlessHeap()->collect(frameContexts->getCompletedFrameNumber());
+    vpp::Model::getGeometryArena()->collect(frameContexts->getCompletedFrameNumber());
 
-    camera.deltaTime = deltaTime;
-    camera.move();
-
-    if (sky.get() != nullptr)
-    {
-        sky->position = camera.position;
-	}
+    // Sampled every frame, not only while the UI shows it, so the heap peaks hold under long runs
+    backend->memoryTracker->queryHeaps();
 
-    ImGui_ImplVulkan_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
+    newImGuiFrame();
     
     // Imgui window here
     ImGui::Text("Controls\n");
@@ -490,23 +1106,434 @@ void TriangleRenderer::main_loop_extended(uint32_t currentFrame, uint32_t imageI
 
     ImGui::SliderFloat("Ambient Factor", &controls.ambientFactor, 0.0f, 1.0f);
 
+    ImGui::Checkbox("Ambient Occlusion", &ambientOcclusion->enabled);
+    if (ambientOcclusion->enabled)
+    {
+        ImGui::SliderFloat("AO Strength", &aoStrength, 0.0f, 1.0f);
+        ImGui::SliderFloat("AO Radius", &ambientOcclusion->radius, 10.0f, 500.0f);
+        ImGui::SliderInt("AO Slices", &ambientOcclusion->sliceCount, 1, 4);
+        ImGui::SliderInt("AO Steps", &ambientOcclusion->stepCount, 2, 8);
+    }
+    controls.aoStrength = ambientOcclusion->enabled ? aoStrength : 0.0f;
+
+    ImGui::Checkbox("Bloom", &bloom->enabled);
+    if (bloom->enabled)
+    {
+        ImGui::SliderFloat("Bloom Intensity", &controls.bloomIntensity, 0.0f, 0.5f);
+        ImGui::SliderFloat("Bloom Threshold", &bloom->threshold, 0.0f, 10.0f);
+    }
+
+    ImGui::Checkbox("Temporal Anti-Aliasing", &temporalAntiAliasing->enabled);
+    if (temporalAntiAliasing->enabled)
+    {
+        ImGui::SliderFloat("TAA Blend Factor", &temporalAntiAliasing->blendFactor, 0.02f, 0.5f);
+    }
+    ImGui::SliderFloat("Sharpness (upscale/TAA)", &controls.sharpness, 0.0f, 1.0f);
+
+    ImGui::Checkbox("Dynamic Resolution", &dynamicResolution.enabled);
+    if (dynamicResolution.enabled)
+    {
+        ImGui::SliderFloat("Target GPU Frame Time (ms)", &dynamicResolution.targetFrameTime, 4.0f, 33.0f);
+        ImGui::SliderFloat("Minimum Render Scale", &dynamicResolution.minScale, 0.25f, 1.0f);
+    }
+    else
+    {
+        ImGui::SliderFloat("Render Scale", &renderScale, 0.5f, 1.0f);
+        dynamicResolution.scale = renderScale;
+    }
+    VkExtent2D renderExtent = getRenderExtent();
+    ImGui::Text("Render resolution: %ux%u", renderExtent.width, renderExtent.height);
+
+    ImGui::SliderFloat3("Sun Direction", &sunDirection.x, -1.0f, 1.0f);
+    if (glm::length(sunDirection) < 0.01f)
+    {
+        sunDirection = glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    ImGui::Checkbox("Shadows", &shadowMap->enabled);
+    if (shadowMap->enabled)
+    {
+        ImGui::SliderFloat("Shadow Distance", &shadowMap->shadowDistance, 1000.0f, 20000.0f);
+        ImGui::SliderInt("PCF Radius", &shadowMap->pcfRadius, 0, 3);
+        ImGui::SliderFloat("Normal Offset", &shadowMap->normalOffset, 0.0f, 4.0f);
+        ImGui::Checkbox("Cache Far Cascades", &shadowMap->cacheFarCascades);
+        ImGui::Text("Cascades rendered: %u, casters drawn: %u", shadowMap->renderedCascadeCount, shadowMap->drawnCasterCount);
+    }
+
+    ImGui::SliderInt("Light Count", &activeLightCount, 0, vpp::MAX_LIGHTS);
+
+    ImGui::Checkbox("Animate Lights", &animateLights);
+
+    ImGui::Combo("Tone Mapping", reinterpret_cast<int*>(&controls.toneMappingOperator), "ACES\0Reinhard\0AgX\0");
+
+    ImGui::SliderFloat("Exposure (EV)", &controls.exposure, -6.0f, 6.0f);
+
+    // A subpass can only read its own pixel, which rules out everything that filters over neighbors
+    if (ambientOcclusion->enabled || bloom->enabled || temporalAntiAliasing->enabled || renderScale < 1.0f || dynamicResolution.enabled)
+    {
+        subpassDeferred->enabled = false;
+        ImGui::Text("Subpass deferred is unavailable with AO, bloom, TAA or a reduced render scale");
+    }
+    else
+    {
+        ImGui::Checkbox("Subpass Deferred", &subpassDeferred->enabled);
+    }
+    if (subpassDeferred->enabled)
+    {
+        fusedToneMapping = false;
+        ImGui::Text("G-buffer attachments: %.1f MB committed%s, no sharpening", subpassDeferred->getAttachmentMemory() / (1024.0 * 1024.0), subpassDeferred->lazilyAllocated ? " (lazily allocated)" : "");
+    }
+
+    // Bloom and the temporal resolve need the HDR image, which the fused pass never writes
+    if (bloom->enabled || temporalAntiAliasing->enabled || renderScale < 1.0f || dynamicResolution.enabled)
+    {
+        fusedToneMapping = false;
+        ImGui::Text("Fused tone mapping is unavailable with bloom, TAA or a reduced render scale");
+    }
+    else if (!subpassDeferred->enabled)
+    {
+        ImGui::Checkbox(backend->swapChainStorageSupported && !useAsyncCompute() ? "Fused Tone Mapping (swapchain)" : "Fused Tone Mapping (LDR image)", &fusedToneMapping);
+    }
+
+    readLuminanceHistogram(currentFrame);
+
+    ImGui::Checkbox("Auto Exposure", &autoExposure);
+    controls.autoExposure = autoExposure ? 1 : 0;
+    if (autoExposure)
+    {
+        ImGui::SliderFloat("Adaptation Rate", &controls.adaptationRate, 0.1f, 10.0f);
+        ImGui::Text("Adapted luminance: %.4f (%.2f EV)", exposureData.adaptedLuminance, exposureData.exposure);
+    }
+
+    // Bin 0 holds black pixels and would flatten the rest of the plot
+    ImGui::PlotHistogram("Log Luminance", luminanceHistogram.data() + 1, vpp::HISTOGRAM_BIN_COUNT - 1, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 80.0f));
+
+    imageAvailableWaitStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    if (fusedIntoSwapChain())
+    {
+        imageAvailableWaitStages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    }
+
+    if (lightingPassFp16ComputePipeline)
+    {
+        ImGui::Checkbox("FP16 Lighting", &useFp16Lighting);
+    }
+
+    gpuProfiler->readResults(currentFrame);
+    lightingPassTime = gpuProfiler->getTime("Lighting") / lightingDispatchCounts[currentFrame];
+    gpuFrameTime = gpuProfiler->getTime("Frame");
+
+    // The measurement is a few frames old, the controller's smoothing absorbs that
+    renderScale = dynamicResolution.update(gpuFrameTime);
+
+    if (benchmark.settings.enabled)
+    {
+        benchmark.recordFrame(gpuFrameTime, gpuProfiler->getLatestTimes());
+
+        if (benchmark.isFinished())
+        {
+            benchmark.writeReport();
+            if (!benchmark.settings.baselinePath.empty() && benchmark.compareWithBaseline() > 0)
+            {
+                exitCode = EXIT_FAILURE;
+            }
+            quitRequested = true;
+        }
+    }
+
+    if (asyncCompute)
+    {
+        ImGui::Checkbox("Async Compute", &asyncComputeEnabled);
+    }
+    else
+    {
+        ImGui::Text("Async compute: no second queue on this device");
+    }
+
+    const vpp::RenderGraphStats& graphStats = renderGraph->stats;
+    ImGui::Text("Render graph: %u passes, %u culled, %u barriers in %u batches", graphStats.passCount, graphStats.culledPassCount, graphStats.barrierCount, graphStats.barrierBatchCount);
+    ImGui::Text("Transient memory: %.1f MB (%.1f MB unaliased)", graphStats.transientMemory / (1024.0 * 1024.0), graphStats.unaliasedTransientMemory / (1024.0 * 1024.0));
+
+    std::shared_ptr<vpp::BindlessHeap> bindlessHeap = vpp::Model::getBindlessHeap();
+    ImGui::Text("Bindless heap: %u / %u textures, %u / %u buffers", bindlessHeap->getTextureCount(), bindlessHeap->getTextureCapacity(), bindlessHeap->getBufferCount(), bindlessHeap->getBufferCapacity());
+    std::shared_ptr<vpp::GeometryArena> geometryArena = vpp::Model::getGeometryArena();
+    ImGui::Text("Geometry arena: %u / %u vertices, %u / %u indices, %zu free blocks, %.1f MB compacted", geometryArena->getVertexCount(), geometryArena->getVertexCapacity(),
+        geometryArena->getIndexCount(), geometryArena->getIndexCapacity(), geometryArena->getFreeBlockCount(), geometryArena->getMovedBytes() / (1024.0 * 1024.0));
+    ImGui::Checkbox("Geometry Compaction", &geometryArena->compaction);
+    ImGui::Text("ORM textures: %.1f MB, %.1f MB saved over separate RGBA8 metallic and roughness", vpp::Model::getOrmTextureSize() / (1024.0 * 1024.0),
+        (double(vpp::Model::getUnpackedOrmTextureSize()) - double(vpp::Model::getOrmTextureSize())) / (1024.0 * 1024.0));
+    ImGui::Text("Frame constants: %.1f KB peak of %.0f KB (%s)", uniformAllocator->getPeakUsedSize() / 1024.0, uniformAllocator->getRegionSize() / 1024.0, uniformAllocator->isDeviceLocal() ? "VRAM" : "host memory");
+    ImGui::Text("Scene: %zu entities, %zu drawn", scene->size(), drawList.size());
+    ImGui::Text("Render targets: %ux%u, %u resizes, last %.1f ms, %zu retired", renderTargets->getExtent().width, renderTargets->getExtent().height, renderTargets->getResizeCount(), renderTargets->getLastResizeTime(), renderTargets->getRetiredCount());
+
+    ImGui::Checkbox("Lighting Benchmark", &lightingBenchmark);
+    if (lightingBenchmark)
+    {
+        ImGui::SliderInt("Benchmark Iterations", &lightingBenchmarkIterations, 1, 64);
+    }
+    ImGui::Text("GPU frame: %.3f ms (smoothed %.3f ms)", gpuFrameTime, dynamicResolution.smoothedFrameTime);
+    ImGui::Text("Input to present: %.1f ms (smoothed %.1f ms, estimated)", framePacer->getLatency(), framePacer->getSmoothedLatency());
+    ImGui::Text("Input to submit %.1f ms, to GPU done %.1f ms, present delay %.1f ms", framePacer->getInputToSubmit(), framePacer->getInputToGpu(), framePacer->getPresentDelay());
+
+    vpp::FramePacingSettings pacing = framePacer->settings;
+    ImGui::Checkbox("Low Latency", &pacing.lowLatency);
+    if (ImGui::BeginCombo("Present Mode", vpp::presentModeName(pacing.presentMode)))
+    {
+        for (VkPresentModeKHR mode : availablePresentModes)
+        {
+            if (ImGui::Selectable(vpp::presentModeName(mode), mode == pacing.presentMode))
+            {
+                pacing.presentMode = mode;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    int swapChainImageCount = static_cast<int>(pacing.swapChainImageCount);
+    if (ImGui::SliderInt("Swapchain Images", &swapChainImageCount, 0, 8, swapChainImageCount == 0 ? "Default" : "%d"))
+    {
+        pacing.swapChainImageCount = static_cast<uint32_t>(swapChainImageCount);
+    }
+    ImGui::Text("Swapchain: %u images, %s", backend->imageCount, vpp::presentModeName(presentMode));
+    setFramePacing(pacing);
+
+    // Fewer frames in flight lowers latency, more lets the CPU run further ahead of the GPU
+    int framesInFlight = static_cast<int>(frameContexts->getFramesInFlight());
+    if (ImGui::SliderInt("Frames In Flight", &framesInFlight, 1, static_cast<int>(MAX_FRAMES_IN_FLIGHT)))
+    {
+        frameContexts->setFramesInFlight(static_cast<uint32_t>(framesInFlight));
+    }
+    ImGui::Text("Frame %llu, GPU finished frame %llu", static_cast<unsigned long long>(frameContexts->getCurrentFrameNumber()), static_cast<unsigned long long>(frameContexts->getCompletedFrameNumber()));
+    ImGui::Text("Lighting pass: %.3f ms per dispatch", lightingPassTime);
+    gpuProfiler->drawImGui();
+    backend->memoryTracker->drawImGui();
+#ifdef VPP_CPU_PROFILER
+    if (ImGui::Button("Export CPU Trace"))
+    {
+        VPP_PROFILE_EXPORT("cpu_trace.json");
+    }
+#endif
+
+    // The camera moves as late as possible, so the frame is built from the freshest view
+    camera.deltaTime = deltaTime;
+    if (benchmark.settings.enabled)
+    {
+        benchmark.update(camera);
+    }
+    else
+    {
+        camera.move();
+        cameraPathRecorder.update(camera, deltaTime);
+    }
+
+    glm::mat4 skyOffset = glm::translate(glm::mat4(1.0f), camera.position);
+    for (size_t i = 0; i < skyEntities.size(); i++)
+    {
+        scene->setTransform(skyEntities[i], skyOffset * skyTransforms[i]);
+    }
+
+    gatherShadowCasters();
+    shadowMap->update(camera, backend->swapChainExtent.width / (float)backend->swapChainExtent.height, sunDirection, shadowCasters);
+
     updateUniformBuffers(currentFrame);
     recordCommandBuffer(currentFrame, imageIndex);
 }
 
-void TriangleRenderer::createUniformBuffers()
+// Every entity that casts a shadow, the sky surrounds the camera and would shadow everything
+void TriangleRenderer::gatherShadowCasters()
+{
+    shadowCasters.clear();
+
+    const std::vector<uint32_t>& flags = scene->getFlags();
+    const std::vector<glm::mat4>& transforms = scene->getTransforms();
+    const std::vector<vpp::AABB>& bounds = scene->getWorldBounds();
+    const std::vector<vpp::MeshRef>& meshes = scene->getMeshes();
+    std::shared_ptr<vpp::GeometryArena> geometryArena = vpp::Model::getGeometryArena();
+
+    for (size_t i = 0; i < scene->size(); i++)
+    {
+        if (flags[i] & vpp::ENTITY_CASTS_SHADOW)
+        {
+            vpp::GeometryRange range = geometryArena->getRange(meshes[i].geometry);
+            shadowCasters.push_back({ transforms[i], bounds[i], meshes[i].indexCount, range.firstIndex + meshes[i].startIndex, static_cast<int32_t>(range.firstVertex + meshes[i].startVertex) });
+        }
+    }
+}
+
+// Skips the sky, which follows the camera
+vpp::AABB TriangleRenderer::getSceneBounds()
+{
+    return scene->getBounds();
+}
+
+void TriangleRenderer::createLights()
 {
-    VkDeviceSize viewProjectionUBOSize = sizeof(vpp::ViewProjectionMatrices);
+    // Scatter lights through the scene
+    vpp::AABB sceneBounds = getSceneBounds();
+
+    glm::vec3 extent = sceneBounds.max - sceneBounds.min;
+    float range = glm::length(extent) * 0.04f;
+
+    std::mt19937 generator(1337);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    lights.resize(vpp::MAX_LIGHTS);
+    lightBasePositions.resize(vpp::MAX_LIGHTS);
 
+    for (uint32_t i = 0; i < vpp::MAX_LIGHTS; i++)
+    {
+        glm::vec3 position = sceneBounds.min + extent * glm::vec3(unit(generator), unit(generator) * 0.5f, unit(generator));
+        glm::vec3 color = glm::normalize(glm::vec3(unit(generator), unit(generator), unit(generator)) + 0.2f);
+        bool isSpot = unit(generator) < 0.25f;
+
+        lightBasePositions[i] = position;
+        lights[i].positionRadius = glm::vec4(position, range);
+        lights[i].colorIntensity = glm::vec4(color, 4.0f);
+        lights[i].directionType = glm::vec4(0.0f, -1.0f, 0.0f, static_cast<float>(isSpot ? vpp::SPOT_LIGHT : vpp::POINT_LIGHT));
+        lights[i].spotAngles = glm::vec4(glm::cos(glm::radians(25.0f)), glm::cos(glm::radians(40.0f)), 0.0f, 0.0f);
+    }
+
+    VkDeviceSize lightBufferSize = sizeof(vpp::LightBufferHeader) + vpp::MAX_LIGHTS * sizeof(vpp::Light);
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        viewProjectionUniformBuffers.push_back(std::make_shared<vpp::Buffer>(backend, viewProjectionUBOSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, vpp::CONTINOUS_TRANSFER, nullptr, "View Projection Uniform Buffer"));
-        modelUniformBuffers.push_back(std::make_shared<vpp::Buffer>(backend, sizeof(glm::mat4), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, vpp::CONTINOUS_TRANSFER, nullptr, "Model Uniform buffer"));
-        cameraLightInfoBuffers.push_back(std::make_shared<vpp::Buffer>(backend, sizeof(vpp::CameraLightInfo), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, vpp::CONTINOUS_TRANSFER, nullptr, "Camera Light Info buffer"));
-        controlUniformBuffers.push_back(std::make_shared<vpp::Buffer>(backend, sizeof(vpp::Controls), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, vpp::CONTINOUS_TRANSFER, nullptr, "Control Uniform buffer"));
-        viewportUniformBuffers.push_back(std::make_shared<vpp::Buffer>(backend, sizeof(ViewportDims), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, vpp::CONTINOUS_TRANSFER, nullptr, "Viewport Uniform buffer"));
+        lightBuffers.push_back(std::make_shared<vpp::Buffer>(backend, lightBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vpp::CONTINOUS_TRANSFER, nullptr, "Light buffer"));
+    }
+
+    createTileLightBuffer();
+}
+
+// Sized by the tile grid over the swapchain
+void TriangleRenderer::createTileLightBuffer()
+{
+    if (tileLightBuffer)
+    {
+        renderTargets->retire(tileLightBuffer);
+    }
+
+    tileCountX = (backend->swapChainExtent.width + vpp::LIGHT_TILE_SIZE - 1) / vpp::LIGHT_TILE_SIZE;
+    tileCountY = (backend->swapChainExtent.height + vpp::LIGHT_TILE_SIZE - 1) / vpp::LIGHT_TILE_SIZE;
+
+    VkDeviceSize tileLightBufferSize = tileCountX * tileCountY * (vpp::MAX_LIGHTS_PER_TILE + 1) * sizeof(uint32_t);
+    tileLightBuffer = std::make_shared<vpp::Buffer>(backend, tileLightBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vpp::GPU_ONLY, nullptr, "Tile light index buffer");
+}
+
+void TriangleRenderer::updateLights(uint32_t currentFrame)
+{
+    if (animateLights)
+    {
+        for (int i = 0; i < activeLightCount; i++)
+        {
+            float phase = static_cast<float>(currentFrameTime) * 0.7f + i * 0.37f;
+            lights[i].positionRadius.y = lightBasePositions[i].y + glm::sin(phase) * lights[i].positionRadius.w * 0.5f;
+        }
+    }
+
+    vpp::LightBufferHeader header{};
+    header.lightCount = static_cast<uint32_t>(activeLightCount);
+    header.tileCountX = tileCountX;
+    header.tileCountY = tileCountY;
+
+    char* mappedPtr = static_cast<char*>(lightBuffers[currentFrame]->mappedPtr);
+    memcpy(mappedPtr, &header, sizeof(header));
+    memcpy(mappedPtr + sizeof(header), lights.data(), activeLightCount * sizeof(vpp::Light));
+}
+
+void TriangleRenderer::createAutoExposureBuffers()
+{
+    VkDeviceSize histogramSize = vpp::HISTOGRAM_BIN_COUNT * sizeof(uint32_t);
+    luminanceHistogramBuffer = std::make_shared<vpp::Buffer>(backend, histogramSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, vpp::GPU_ONLY, nullptr, "Luminance histogram buffer");
+
+    // A non positive luminance makes the first adaptation snap to the measured value
+    vpp::ExposureData initialExposure{ 0.0f, 0.0f };
+    exposureBuffer = std::make_shared<vpp::Buffer>(backend, sizeof(vpp::ExposureData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, vpp::ONE_TIME_TRANSFER, &initialExposure, "Exposure buffer");
+
+    // Histogram followed by the exposure data, read on the CPU once the frame has finished on the GPU
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        luminanceReadbackBuffers.push_back(std::make_shared<vpp::Buffer>(backend, histogramSize + sizeof(vpp::ExposureData), VK_BUFFER_USAGE_TRANSFER_DST_BIT, vpp::CONTINOUS_TRANSFER, nullptr, "Luminance readback buffer " + std::to_string(i)));
+        memset(luminanceReadbackBuffers[i]->mappedPtr, 0, histogramSize + sizeof(vpp::ExposureData));
     }
 }
 
+void TriangleRenderer::createAutoExposurePipelines()
+{
+    luminanceHistogramComputePipeline = std::make_shared<vpp::ComputePipeline>(backend, "TriangleRenderer::Luminance histogram Pipeline", "shaders/luminanceHistogram.comp.spv");
+    luminanceHistogramComputePipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
+    luminanceHistogramComputePipeline->addDescriptorSetLayout(luminanceDescriptorSetLayout);
+    luminanceHistogramComputePipeline->addDescriptorSetLayout(toneMappingInputDescriptorSetLayout);
+    luminanceHistogramComputePipeline->createPipeline();
+
+    luminanceAverageComputePipeline = std::make_shared<vpp::ComputePipeline>(backend, "TriangleRenderer::Luminance average Pipeline", "shaders/luminanceAverage.comp.spv");
+    luminanceAverageComputePipeline->addDescriptorSetLayout(perFrameDescriptorSetLayout);
+    luminanceAverageComputePipeline->addDescriptorSetLayout(luminanceDescriptorSetLayout);
+    luminanceAverageComputePipeline->addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LuminanceAveragePushConstants));
+    luminanceAverageComputePipeline->createPipeline();
+}
+
+void TriangleRenderer::clearLuminanceHistogram(VkCommandBuffer commandBuffer)
+{
+    vkCmdFillBuffer(commandBuffer, luminanceHistogramBuffer->buffer, 0, VK_WHOLE_SIZE, 0);
+}
+
+// The fused lighting pass accumulates the histogram itself, this one is only declared without it
+void TriangleRenderer::recordLuminanceHistogram(VkCommandBuffer commandBuffer, uint32_t currentFrame)
+{
+    vpp::GpuProfileScope profileScope(*gpuProfiler, commandBuffer, "Luminance histogram");
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, luminanceHistogramComputePipeline->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, luminanceHistogramComputePipeline->pipelineLayout, 0, 1, &perFrameDescriptorSet->descriptorSet, static_cast<uint32_t>(perFrameOffsets.size()), perFrameOffsets.data());
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, luminanceHistogramComputePipeline->pipelineLayout, 1, 1, &luminanceDescriptorSet->descriptorSet, 0, nullptr);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, luminanceHistogramComputePipeline->pipelineLayout, 2, 1, &hdrInputDescriptorSet->descriptorSet, 0, nullptr);
+
+    uint32_t groupCountX = (backend->swapChainExtent.width + 15) / 16;
+    uint32_t groupCountY = (backend->swapChainExtent.height + 15) / 16;
+    vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+}
+
+void TriangleRenderer::recordAutoExposure(VkCommandBuffer commandBuffer, uint32_t currentFrame)
+{
+    vpp::GpuProfileScope profileScope(*gpuProfiler, commandBuffer, "Auto exposure");
+
+    LuminanceAveragePushConstants pushConstants{};
+    pushConstants.pixelCount = backend->swapChainExtent.width * backend->swapChainExtent.height;
+    pushConstants.deltaTime = static_cast<float>(deltaTime);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, luminanceAverageComputePipeline->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, luminanceAverageComputePipeline->pipelineLayout, 0, 1, &perFrameDescriptorSet->descriptorSet, static_cast<uint32_t>(perFrameOffsets.size()), perFrameOffsets.data());
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, luminanceAverageComputePipeline->pipelineLayout, 1, 1, &luminanceDescriptorSet->descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, luminanceAverageComputePipeline->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+}
+
+// Both buffers are copied out for the ImGui panel, the readback buffers belong to the frame and aren't in the graph
+void TriangleRenderer::recordLuminanceReadback(VkCommandBuffer commandBuffer, uint32_t currentFrame)
+{
+    VkDeviceSize histogramSize = vpp::HISTOGRAM_BIN_COUNT * sizeof(uint32_t);
+
+    VkBufferCopy histogramCopy{ 0, 0, histogramSize };
+    vkCmdCopyBuffer(commandBuffer, luminanceHistogramBuffer->buffer, luminanceReadbackBuffers[currentFrame]->buffer, 1, &histogramCopy);
+
+    VkBufferCopy exposureCopy{ 0, histogramSize, sizeof(vpp::ExposureData) };
+    vkCmdCopyBuffer(commandBuffer, exposureBuffer->buffer, luminanceReadbackBuffers[currentFrame]->buffer, 1, &exposureCopy);
+
+    VkMemoryBarrier memoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+// Called after the frame context's previous frame has finished, so this shows the histogram from a few frames ago without stalling
+void TriangleRenderer::readLuminanceHistogram(uint32_t currentFrame)
+{
+    const uint32_t* bins = static_cast<const uint32_t*>(luminanceReadbackBuffers[currentFrame]->mappedPtr);
+
+    for (uint32_t i = 0; i < vpp::HISTOGRAM_BIN_COUNT; i++)
+    {
+        luminanceHistogram[i] = static_cast<float>(bins[i]);
+    }
+
+    memcpy(&exposureData, bins + vpp::HISTOGRAM_BIN_COUNT, sizeof(vpp::ExposureData));
+}
+
 void TriangleRenderer::initialize()
 {
     
@@ -514,46 +1541,69 @@ void TriangleRenderer::initialize()
 
 void TriangleRenderer::updateUniformBuffers(uint32_t currentImage)
 {
-    vpp::ViewProjectionMatrices ubo = camera.getMVPMatrices(backend->swapChainExtent.width, backend->swapChainExtent.height);
-    memcpy(viewProjectionUniformBuffers[currentImage]->mappedPtr, &ubo, sizeof(ubo));
+    VPP_PROFILE_FUNCTION();
+
+    VkExtent2D renderExtent = getRenderExtent();
+    camera.jitter = temporalAntiAliasing->nextJitter();
+
+    vpp::ViewProjectionMatrices ubo = camera.getMVPMatrices(static_cast<float>(renderExtent.width), static_cast<float>(renderExtent.height));
+    ubo.previousViewProj = previousViewProjValid ? previousViewProj : ubo.unjitteredViewProj;
+    previousViewProj = ubo.unjitteredViewProj;
+    previousViewProjValid = true;
+
+    // The jitter moves the frustum by less than a pixel, the unjittered one culls just as well
+    drawList.clear();
+    scene->cull(ubo.unjitteredViewProj, drawList);
+    scene->sortFrontToBack(drawList, camera.position);
 
     glm::mat4 modelMatrix = glm::mat4(1.0f);
-    modelMatrix = glm::mat4(1.0f);
-    memcpy(modelUniformBuffers[currentImage]->mappedPtr, &modelMatrix, sizeof(modelMatrix));
 
     vpp::CameraLightInfo cameraLightInfo;
     cameraLightInfo.cameraPos = glm::vec4(camera.position, 1.0f);
-    cameraLightInfo.lightDir = glm::vec4(-1.0f, 1.0f, -1.0f, 0.0f);
-    memcpy(cameraLightInfoBuffers[currentImage]->mappedPtr, &cameraLightInfo, sizeof(cameraLightInfo));
+    cameraLightInfo.lightDir = glm::vec4(sunDirection, 0.0f);
+
+    vpp::Controls frameControls = controls;
+    if (!bloom->enabled)
+    {
+        frameControls.bloomIntensity = 0.0f;
+    }
 
-    memcpy(controlUniformBuffers[currentImage]->mappedPtr, &controls, sizeof(controls));
+    // Sharpening belongs to the upscale, a native frame without TAA keeps the baseline image
+    bool upscaled = renderExtent.width < backend->swapChainExtent.width || renderExtent.height < backend->swapChainExtent.height;
+    if (!upscaled && !temporalAntiAliasing->enabled)
+    {
+        frameControls.sharpness = 0.0f;
+    }
+
+    perFrameOffsets = { uniformAllocator->push(ubo), uniformAllocator->push(modelMatrix), uniformAllocator->push(cameraLightInfo), uniformAllocator->push(frameControls) };
 
     ViewportDims viewportDims;
-    viewportDims.width = backend->swapChainExtent.width;
-    viewportDims.height = backend->swapChainExtent.height;
-    memcpy(viewportUniformBuffers[currentImage]->mappedPtr, &viewportDims, sizeof(ViewportDims));
+    viewportDims.width = renderExtent.width;
+    viewportDims.height = renderExtent.height;
+    viewportOffset = uniformAllocator->push(viewportDims);
+
+    shadowDataOffset = uniformAllocator->push(shadowMap->getShadowData());
+
+    updateLights(currentImage);
 }
 
 void TriangleRenderer::createDescriptorSets()
 {
     // Per frame descriptor set
     perFrameDescriptorSetLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "Model view projection descriptor set layout");
-    perFrameDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1);
-    perFrameDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1);
-    perFrameDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1);
-    perFrameDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1);
+    perFrameDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1);
+    perFrameDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1);
+    perFrameDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1);
+    perFrameDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1);
     perFrameDescriptorSetLayout->createLayout();
 
-    perFrameDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
-    {
-        perFrameDescriptorSets[i] = std::make_shared<vpp::SuperDescriptorSet>(backend, perFrameDescriptorSetLayout, "Model View Projection descriptor set " + std::to_string(i));
-        perFrameDescriptorSets[i]->addBuffersToBinding({ viewProjectionUniformBuffers[i] });
-        perFrameDescriptorSets[i]->addBuffersToBinding({ modelUniformBuffers[i] });
-        perFrameDescriptorSets[i]->addBuffersToBinding({ cameraLightInfoBuffers[i] });
-        perFrameDescriptorSets[i]->addBuffersToBinding({ controlUniformBuffers[i]});
-        perFrameDescriptorSets[i]->createDescriptorSet();
-	}
+    // One set for every frame, the frame's allocations are picked with dynamic offsets
+    perFrameDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, perFrameDescriptorSetLayout, "Model View Projection descriptor set");
+    perFrameDescriptorSet->addBuffersToBinding({ uniformAllocator->buffer }, sizeof(vpp::ViewProjectionMatrices));
+    perFrameDescriptorSet->addBuffersToBinding({ uniformAllocator->buffer }, sizeof(glm::mat4));
+    perFrameDescriptorSet->addBuffersToBinding({ uniformAllocator->buffer }, sizeof(vpp::CameraLightInfo));
+    perFrameDescriptorSet->addBuffersToBinding({ uniformAllocator->buffer }, sizeof(vpp::Controls));
+    perFrameDescriptorSet->createDescriptorSet();
 
     // G buffer descriptor set
     gBufferDescriptorSetLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "G Buffer descriptor set layout");
@@ -563,34 +1613,158 @@ void TriangleRenderer::createDescriptorSets()
     gBufferDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1); // roughness
     gBufferDescriptorSetLayout->createLayout();
 
-    gBufferDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, gBufferDescriptorSetLayout, "G Buffer descriptor set");
-	gBufferDescriptorSet->addImagesToBinding({ normalImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
-	gBufferDescriptorSet->addImagesToBinding({ albedoImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
-	gBufferDescriptorSet->addImagesToBinding({ metallicImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
-	gBufferDescriptorSet->addImagesToBinding({ roughnessImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
-	gBufferDescriptorSet->createDescriptorSet();
-
     // Lighting image descriptor set
 
     lightingImageDescriptorSetLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "Lighting image descriptor set layout");
     lightingImageDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1);   
     lightingImageDescriptorSetLayout->createLayout();
 
-	lightingImageDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, lightingImageDescriptorSetLayout, "Lighting image descriptor set");
-    lightingImageDescriptorSet->addImagesToBinding({ lightingImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
-	lightingImageDescriptorSet->createDescriptorSet();
-
     // Depth image descriptor set
     depthImageDescriptorSetLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "Depth image descriptor set layout");
     depthImageDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1); // depth
-    depthImageDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1); // viewPort dims
+    depthImageDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1); // viewPort dims
     depthImageDescriptorSetLayout->createLayout();
 
+    // Lighting data descriptor set, also read by the lighting subpass of the subpass deferred path
+    VkShaderStageFlags lightingStages = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    lightingDataDescriptorSetLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "Lighting data descriptor set layout");
+    lightingDataDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, lightingStages, 1); // lights
+    lightingDataDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, lightingStages, 1); // tile light lists
+    lightingDataDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, lightingStages, 1); // exposure
+    lightingDataDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, lightingStages, 1); // luminance histogram
+    lightingDataDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, lightingStages, 1); // shadow cascades
+    lightingDataDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, lightingStages, 1); // shadow atlas
+    lightingDataDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, lightingStages, 1); // ambient occlusion
+    lightingDataDescriptorSetLayout->createLayout();
+
+    // Tone mapping input descriptor sets
+    toneMappingInputDescriptorSetLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "Tone mapping input descriptor set layout");
+    toneMappingInputDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, 1); // tone mapping input
+    toneMappingInputDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1); // exposure
+    toneMappingInputDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1); // bloom
+    toneMappingInputDescriptorSetLayout->createLayout();
+
+    // Luminance descriptor set
+    luminanceDescriptorSetLayout = std::make_shared<vpp::SuperDescriptorSetLayout>(backend, "Luminance descriptor set layout");
+    luminanceDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1); // histogram
+    luminanceDescriptorSetLayout->addBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1); // exposure
+    luminanceDescriptorSetLayout->createLayout();
+
+    luminanceDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, luminanceDescriptorSetLayout, "Luminance descriptor set");
+    luminanceDescriptorSet->addBuffersToBinding({ luminanceHistogramBuffer });
+    luminanceDescriptorSet->addBuffersToBinding({ exposureBuffer });
+    luminanceDescriptorSet->createDescriptorSet();
+
+    createRenderTargetDescriptorSets();
+    createSwapChainImageDescriptorSets();
+}
+
+// Every set that points at an image sized by the swapchain, rebuilt on a resize while the layouts stay
+void TriangleRenderer::createRenderTargetDescriptorSets()
+{
+    if (ambientOcclusion)
+    {
+        renderTargets->retire(gBufferDescriptorSet, lightingImageDescriptorSet, depthImageDescriptorSet, hdrInputDescriptorSet, ldrImageDescriptorSet, ldrInputDescriptorSet);
+        for (auto& descriptorSet : lightingDataDescriptorSets)
+        {
+            renderTargets->retire(descriptorSet);
+        }
+
+        ambientOcclusion->resize(*renderTargets, backend->depthImageView, normalImageView, backend->swapChainExtent.width, backend->swapChainExtent.height);
+    }
+    else
+    {
+        ambientOcclusion = std::make_shared<AmbientOcclusion>(backend, perFrameDescriptorSetLayout, backend->depthImageView, normalImageView, backend->swapChainExtent.width, backend->swapChainExtent.height);
+    }
+    renderGraph->setImage(aoRawResource, ambientOcclusion->rawImage->image, 1, VK_IMAGE_LAYOUT_UNDEFINED);
+    renderGraph->setImage(aoOutputResource, ambientOcclusion->outputImage->image, 1, VK_IMAGE_LAYOUT_UNDEFINED);
+
+    gBufferDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, gBufferDescriptorSetLayout, "G Buffer descriptor set");
+	gBufferDescriptorSet->addImagesToBinding({ normalImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+	gBufferDescriptorSet->addImagesToBinding({ albedoImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+	gBufferDescriptorSet->addImagesToBinding({ metallicImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+	gBufferDescriptorSet->addImagesToBinding({ roughnessImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+	gBufferDescriptorSet->createDescriptorSet();
+
+	lightingImageDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, lightingImageDescriptorSetLayout, "Lighting image descriptor set");
+    lightingImageDescriptorSet->addImagesToBinding({ lightingImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+	lightingImageDescriptorSet->createDescriptorSet();
+
     depthImageDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, depthImageDescriptorSetLayout, "Depth image descriptor set");
-	depthImageDescriptorSet->addImagesToBinding({ backend->depthImageView }, { sampler }, { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL });
-    depthImageDescriptorSet->addBuffersToBinding({ viewportUniformBuffers[currentFrame] });
+    depthImageDescriptorSet->addImagesToBinding({ backend->depthImageView }, { sampler }, { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL });
+    depthImageDescriptorSet->addBuffersToBinding({ uniformAllocator->buffer }, sizeof(ViewportDims));
     depthImageDescriptorSet->createDescriptorSet();
 
+    lightingDataDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        lightingDataDescriptorSets[i] = std::make_shared<vpp::SuperDescriptorSet>(backend, lightingDataDescriptorSetLayout, "Lighting data descriptor set " + std::to_string(i));
+        lightingDataDescriptorSets[i]->addBuffersToBinding({ lightBuffers[i] });
+        lightingDataDescriptorSets[i]->addBuffersToBinding({ tileLightBuffer });
+        lightingDataDescriptorSets[i]->addBuffersToBinding({ exposureBuffer });
+        lightingDataDescriptorSets[i]->addBuffersToBinding({ luminanceHistogramBuffer });
+        lightingDataDescriptorSets[i]->addBuffersToBinding({ uniformAllocator->buffer }, sizeof(vpp::ShadowData));
+        lightingDataDescriptorSets[i]->addImagesToBinding({ shadowMap->atlasImageView }, { shadowMap->comparisonSampler }, { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL });
+        lightingDataDescriptorSets[i]->addImagesToBinding({ ambientOcclusion->outputImageView }, { ambientOcclusion->sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        lightingDataDescriptorSets[i]->createDescriptorSet();
+    }
+
+    hdrInputDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, toneMappingInputDescriptorSetLayout, "HDR input descriptor set");
+    hdrInputDescriptorSet->addImagesToBinding({ temporalAntiAliasing->outputImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+    hdrInputDescriptorSet->addBuffersToBinding({ exposureBuffer });
+    hdrInputDescriptorSet->addImagesToBinding({ bloom->outputImageView }, { bloom->sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+    hdrInputDescriptorSet->createDescriptorSet();
+
+    if (ldrImage)
+    {
+        ldrImageDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, lightingImageDescriptorSetLayout, "LDR image descriptor set");
+        ldrImageDescriptorSet->addImagesToBinding({ ldrImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        ldrImageDescriptorSet->createDescriptorSet();
+
+        ldrInputDescriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, toneMappingInputDescriptorSetLayout, "LDR input descriptor set");
+        ldrInputDescriptorSet->addImagesToBinding({ ldrImageView }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        ldrInputDescriptorSet->addBuffersToBinding({ exposureBuffer });
+        ldrInputDescriptorSet->addImagesToBinding({ bloom->outputImageView }, { bloom->sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        ldrInputDescriptorSet->createDescriptorSet();
+    }
+}
+
+void TriangleRenderer::createSwapChainImageDescriptorSets()
+{
+    for (auto& descriptorSet : swapChainImageDescriptorSets)
+    {
+        renderTargets->retire(descriptorSet);
+    }
+    swapChainImageDescriptorSets.clear();
+
+    if (!backend->swapChainStorageSupported)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < backend->swapChainImageViews.size(); i++)
+    {
+        std::shared_ptr<vpp::SuperDescriptorSet> descriptorSet = std::make_shared<vpp::SuperDescriptorSet>(backend, lightingImageDescriptorSetLayout, "Swapchain image descriptor set " + std::to_string(i));
+        descriptorSet->addImagesToBinding({ backend->swapChainImageViews[i] }, { sampler }, { VK_IMAGE_LAYOUT_GENERAL });
+        descriptorSet->createDescriptorSet();
+        swapChainImageDescriptorSets.push_back(descriptorSet);
+    }
+}
+
+// The extent dependent targets were already rebuilt by resizeRenderTargets if the size changed
+void TriangleRenderer::recreateSwapChain_extended()
+{
+    createSwapChainImageDescriptorSets();
+    subpassDeferred->recreateTargets(*renderTargets);
+}
+
+// Pipelines, layouts and the models stay, the images sized by the swapchain and everything that points at them are replaced
+void TriangleRenderer::resizeRenderTargets()
+{
+    createTileLightBuffer();
+    createGeometryPassImages();
+    createGeometryPassFrameBuffer();
+    createRenderTargetDescriptorSets();
 }
 
 void TriangleRenderer::key_callback_extended(GLFWwindow* window, int key, int scancode, int action, int mods, double deltaTime)
@@ -654,10 +1828,29 @@ void TriangleRenderer::key_callback_extended(GLFWwindow* window, int key, int sc
 		camera.movingDown = false;
 	}
 
+    if (key == GLFW_KEY_F11 && action == GLFW_PRESS)
+    {
+        toggleFullscreen();
+    }
+
     if (key == GLFW_KEY_F && action == GLFW_PRESS)
     {
         std::cout << "Camera position: " << camera.position.x << ", " << camera.position.y << ", " << camera.position.z << std::endl;
 	}
+
+    // Camera path for the benchmark, saved when recording stops
+    if (key == GLFW_KEY_P && action == GLFW_PRESS)
+    {
+        if (cameraPathRecorder.recording)
+        {
+            cameraPathRecorder.stop("camera_path.json");
+            std::cout << "Camera path saved to camera_path.json" << std::endl;
+        }
+        else
+        {
+            cameraPathRecorder.start();
+        }
+    }
 }
 
 void TriangleRenderer::mouse_callback_extended(GLFWwindow* window, int button, int action, int mods, double deltaTime)
@@ -0,0 +1,42 @@
+#include "UniformAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+vpp::UniformAllocator::UniformAllocator(std::shared_ptr<Backend> backend, std::shared_ptr<FrameContexts> frameContexts, VkDeviceSize regionSize) :
+    backend(backend), frameContexts(frameContexts)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(backend->physicalDevice, &properties);
+    alignment = std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+
+    this->regionSize = (regionSize + alignment - 1) / alignment * alignment;
+    regionFrames.resize(frameContexts->getMaxFramesInFlight(), 0);
+
+    buffer = std::make_shared<Buffer>(backend, this->regionSize * regionFrames.size(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        vpp::MAPPED_DEVICE_LOCAL, nullptr, "Uniform allocator buffer");
+}
+
+void vpp::UniformAllocator::beginFrame(uint32_t frameContextIndex, uint64_t frameNumber)
+{
+    // Normally retired already, the frame context waited for its previous frame
+    frameContexts->waitForFrame(regionFrames[frameContextIndex]);
+
+    regionFrames[frameContextIndex] = frameNumber;
+    regionStart = frameContextIndex * regionSize;
+    head = regionStart;
+}
+
+vpp::UniformAllocation vpp::UniformAllocator::allocate(VkDeviceSize size)
+{
+    VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+    if (offset + size > regionStart + regionSize)
+    {
+        throw std::runtime_error("Uniform allocator region is full.");
+    }
+
+    head = offset + size;
+    peakUsedSize = std::max(peakUsedSize, head - regionStart);
+
+    return { static_cast<char*>(buffer->mappedPtr) + offset, static_cast<uint32_t>(offset) };
+}
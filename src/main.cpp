@@ -1,18 +1,91 @@
 #include "TriangleRenderer.h"
 
-int main() 
+#include <cstring>
+
+// --headless [--frames N] [--width W] [--height H] [--dump-interval N] [--dump-dir DIR]
+// --benchmark [--camera-path FILE] [--warmup N] [--benchmark-frames N] [--report FILE] [--baseline FILE] [--threshold PERCENT]
+// --no-async-compute
+// [--present-mode fifo|fifo-relaxed|mailbox|immediate] [--swapchain-images N] [--low-latency]
+static VkPresentModeKHR parsePresentMode(const std::string& name)
+{
+    if (name == "fifo") return VK_PRESENT_MODE_FIFO_KHR;
+    if (name == "fifo-relaxed") return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    if (name == "mailbox") return VK_PRESENT_MODE_MAILBOX_KHR;
+    if (name == "immediate") return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    throw std::runtime_error("unknown present mode " + name);
+}
+
+static void parseArguments(int argc, char** argv, vpp::HeadlessSettings& headless, BenchmarkSettings& benchmark, bool& asyncCompute, vpp::FramePacingSettings& pacing)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(argv[i], "--headless") == 0)
+            headless.enabled = true;
+        else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+            headless.frameCount = std::stoull(argv[++i]);
+        else if (strcmp(argv[i], "--width") == 0 && hasValue)
+            headless.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (strcmp(argv[i], "--height") == 0 && hasValue)
+            headless.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (strcmp(argv[i], "--dump-interval") == 0 && hasValue)
+            headless.dumpInterval = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (strcmp(argv[i], "--dump-dir") == 0 && hasValue)
+            headless.dumpDirectory = argv[++i];
+        else if (strcmp(argv[i], "--benchmark") == 0)
+            benchmark.enabled = true;
+        else if (strcmp(argv[i], "--camera-path") == 0 && hasValue)
+            benchmark.cameraPath = argv[++i];
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue)
+            benchmark.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (strcmp(argv[i], "--benchmark-frames") == 0 && hasValue)
+            benchmark.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (strcmp(argv[i], "--report") == 0 && hasValue)
+            benchmark.reportPath = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+            benchmark.baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && hasValue)
+            benchmark.regressionThreshold = std::stof(argv[++i]) / 100.0f;
+        else if (strcmp(argv[i], "--no-async-compute") == 0)
+            asyncCompute = false;
+        else if (strcmp(argv[i], "--present-mode") == 0 && hasValue)
+            pacing.presentMode = parsePresentMode(argv[++i]);
+        else if (strcmp(argv[i], "--swapchain-images") == 0 && hasValue)
+            pacing.swapChainImageCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (strcmp(argv[i], "--low-latency") == 0)
+            pacing.lowLatency = true;
+        else
+            throw std::runtime_error(std::string("unknown argument ") + argv[i]);
+    }
+
+    // The benchmark decides when to stop, and it runs at the same fixed step headless or not
+    if (benchmark.enabled && headless.enabled)
+    {
+        headless.frameCount = UINT64_MAX;
+        headless.fixedDeltaTime = benchmark.fixedStep;
+    }
+}
+
+int main(int argc, char** argv) 
 {
     std::vector<VkValidationFeatureEnableEXT> validation_features = { VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_EXT, VK_VALIDATION_FEATURE_ENABLE_SYNCHRONIZATION_VALIDATION_EXT };
-    TriangleRenderer app("Vulkan Template", VK_API_VERSION_1_3, std::move(validation_features));
 
     try {
+        vpp::HeadlessSettings headless;
+        BenchmarkSettings benchmark;
+        bool asyncCompute = true;
+        vpp::FramePacingSettings pacing;
+        parseArguments(argc, argv, headless, benchmark, asyncCompute, pacing);
+
+        TriangleRenderer app("Vulkan Template", VK_API_VERSION_1_3, std::move(validation_features), headless, benchmark);
+        app.setAsyncCompute(asyncCompute);
+        app.setFramePacing(pacing);
         app.run();
+        return app.exitCode;
     }
     catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
     }
-
-    return EXIT_SUCCESS;
-
-}
\ No newline at end of file
+}
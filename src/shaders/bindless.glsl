@@ -0,0 +1,10 @@
+// Set 1 of every pipeline that draws models, see vpp::BindlessHeap. Slots come from push constants and
+// are uniform across a draw. Storage buffer blocks of any layout can be declared as arrays on binding 0.
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+#define BINDLESS_SET 1
+#define BINDLESS_BUFFER_BINDING 0
+#define BINDLESS_TEXTURE_BINDING 1
+
+layout(set = BINDLESS_SET, binding = BINDLESS_TEXTURE_BINDING) uniform sampler2D bindlessTextures[];
@@ -0,0 +1,57 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_debug_printf : enable
+
+#include "toneMapping.glsl"
+
+// Last subpass of the single render pass deferred path, tone maps the lighting subpass's output
+// into the swapchain and accumulates the luminance histogram that luminanceHistogram.comp builds otherwise.
+
+// The swapchain has a UNORM format, so encoding is done here instead of by the hardware
+layout(constant_id = 0) const bool ENCODE_SRGB = false;
+
+layout(set = 0, binding = 3) uniform Controls {
+	float sunlightIntensity;
+    float ambientFactor;
+    float exposure;
+    uint toneMappingOperator;
+    float minLogLuminance;
+    float logLuminanceRange;
+    float adaptationRate;
+    uint autoExposure;
+    float bloomIntensity;
+    float aoStrength;
+    float sharpness;
+} controls;
+
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput hdrInput;
+
+layout(set = 1, binding = 1) readonly buffer Exposure {
+    float adaptedLuminance;
+    float exposure;
+} exposureData;
+
+layout(set = 1, binding = 2) buffer LuminanceHistogram {
+    uint bins[];
+} luminanceHistogram;
+
+#define LUMINANCE_BIN_ONLY
+#include "luminanceHistogram.glsl"
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	vec3 color = subpassLoad(hdrInput).rgb;
+
+	// No workgroup to merge in, every pixel adds to the bin directly
+	atomicAdd(luminanceHistogram.bins[luminanceBin(color)], 1);
+
+	float exposure = controls.exposure + (controls.autoExposure != 0 ? exposureData.exposure : 0.0);
+	color = toneMap(color, exposure, controls.toneMappingOperator);
+	color = ENCODE_SRGB ? linearToSrgb(color) : color;
+
+	outColor = vec4(color, 1.0);
+}
@@ -7,6 +7,8 @@
 layout(location = 0) in vec3 WorldPos;
 layout(location = 1) in vec3 Normal;
 layout(location = 2) in vec2 TexCoord;
+layout(location = 3) in vec4 CurrentClip;
+layout(location = 4) in vec4 PreviousClip;
 
 #define TEXTURE_TYPE_TEXTURE 0
 #define TEXTURE_TYPE_COLOR 1
@@ -15,14 +17,13 @@ layout(location = 2) in vec2 TexCoord;
 layout( push_constant ) uniform constants{
 	mat4 submeshTransform;
 	mat4 modelMatrix;
-	uint materialIndex;
+	uint albedoIndex;
+	uint ormIndex;
 	uint colorIndex;
 	uint textureType;
 } pushConstants;
 
-layout(set = 1, binding = 0) uniform sampler2D albedoSampler[];
-layout(set = 1, binding = 1) uniform sampler2D metallicSampler[];
-layout(set = 1, binding = 2) uniform sampler2D roughnessSampler[];
+#include "bindless.glsl"
 
 layout(set = 2, binding = 0) buffer Colors{
 	vec4 color[];
@@ -40,18 +41,24 @@ layout(location = 0) out vec4 outNormal;
 layout(location = 1) out vec4 outAlbedo;
 layout(location = 2) out vec4 outMetallic;
 layout(location = 3) out vec4 outRoughness;
+layout(location = 4) out vec2 outVelocity;
 
 void main() {
 
     vec4 albedo;
     float metallic, roughness;
+    float occlusion = 1.0;
 
     
     if(pushConstants.textureType == TEXTURE_TYPE_TEXTURE)
     {
-        albedo = vec4(texture(albedoSampler[pushConstants.materialIndex], TexCoord).rgb, 1.0);
-        metallic = texture(metallicSampler[pushConstants.materialIndex], TexCoord).r;
-        roughness = texture(roughnessSampler[pushConstants.materialIndex], TexCoord).r;
+        albedo = vec4(texture(bindlessTextures[pushConstants.albedoIndex], TexCoord).rgb, 1.0);
+
+        // Packed occlusion, roughness, metallic, the view swizzles in defaults for missing maps
+        vec3 orm = texture(bindlessTextures[pushConstants.ormIndex], TexCoord).rgb;
+        occlusion = orm.r;
+        roughness = orm.g;
+        metallic = orm.b;
 	    outMetallic = vec4(metallic, 0.0, 0.0, 1.0);
     }
     else if(pushConstants.textureType == TEXTURE_TYPE_COLOR)
@@ -63,14 +70,17 @@ void main() {
     }
 	else if(pushConstants.textureType == TEXTURE_TYPE_EMBEDDED)
     {
-		albedo = vec4(texture(albedoSampler[pushConstants.materialIndex], TexCoord).rgb, 1.0);
+		albedo = vec4(texture(bindlessTextures[pushConstants.albedoIndex], TexCoord).rgb, 1.0);
         metallic = 0.0;
         roughness = 0.0;
 	    outMetallic = vec4(metallic, 1.0, 0.0, 1.0);
 	}
 
 	outNormal = vec4(Normal, 1.0);
-	outAlbedo = albedo;
+	outAlbedo = vec4(albedo.rgb, occlusion);	// material occlusion rides in the albedo alpha
 	outRoughness = vec4(roughness, 0.0, 0.0, 1.0);
 
+	// UV space motion since the previous frame
+	outVelocity = (CurrentClip.xy / CurrentClip.w - PreviousClip.xy / PreviousClip.w) * 0.5;
+
 }
\ No newline at end of file
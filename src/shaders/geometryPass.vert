@@ -7,6 +7,11 @@
 layout(set = 0, binding = 0) uniform ViewProjection {
     mat4 view;
     mat4 proj;
+    mat4 inverseViewProj;
+    mat4 inverseProj;
+    mat4 unjitteredViewProj;
+    mat4 previousViewProj;
+    vec4 jitter;
 } viewProjectionUBO;
 
 layout(set = 0, binding = 1) uniform model {
@@ -16,7 +21,8 @@ layout(set = 0, binding = 1) uniform model {
 layout( push_constant ) uniform constants{
 	mat4 submeshTransform;
 	mat4 modelMatrix;
-	uint materialIndex;
+	uint albedoIndex;
+	uint ormIndex;
 	uint colorIndex;
 	uint textureType;
 } pushConstants;
@@ -28,6 +34,8 @@ layout(location = 2) in vec2 inTexCoord;
 layout(location = 0) out vec3 fragPosition;
 layout(location = 1) out vec3 fragNormal;
 layout(location = 2) out vec2 fragTexCoord;
+layout(location = 3) out vec4 fragCurrentClip;
+layout(location = 4) out vec4 fragPreviousClip;
 
 
 void main() {
@@ -36,4 +44,8 @@ void main() {
 	fragPosition = worldPos.xyz;
 	fragNormal = (pushConstants.modelMatrix * pushConstants.submeshTransform * vec4(inNormal, 0.0)).xyz;
     fragTexCoord = inTexCoord;
+
+    // Geometry is static, so motion only comes from the camera
+    fragCurrentClip = viewProjectionUBO.unjitteredViewProj * worldPos;
+    fragPreviousClip = viewProjectionUBO.previousViewProj * worldPos;
 }
\ No newline at end of file
@@ -0,0 +1,417 @@
+// Shared body of lightingPass.comp and lightingPassFp16.comp. Defining LIGHTING_FP16
+// runs the shading math in float16 while keeping position reconstruction and the
+// GGX distribution/geometry terms in float32, where fp16 would lose range.
+// Defining LIGHTING_SUBPASS turns it into the fragment shader of the single render pass
+// deferred path, which reads the G-buffer and depth as input attachments.
+
+#ifndef LIGHTING_SUBPASS
+layout (local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+#endif
+
+// When set, the pass tone maps and sRGB encodes straight into an LDR or swapchain image
+layout (constant_id = 0) const bool FUSED_TONE_MAPPING = false;
+
+layout(set = 0, binding = 0) uniform ViewProjection {
+    mat4 view;
+    mat4 proj;
+    mat4 inverseViewProj;
+    mat4 inverseProj;
+} viewProjectionUBO;
+
+layout(set = 0, binding = 2) uniform CameraLightInfo {
+    vec4 camPos;
+    vec4 lightDir;
+} cameraLightInfo;
+
+layout(set = 0, binding = 3) uniform Controls {
+	float sunlightIntensity;
+    float ambientFactor;
+    float exposure;
+    uint toneMappingOperator;
+    float minLogLuminance;
+    float logLuminanceRange;
+    float adaptationRate;
+    uint autoExposure;
+    float bloomIntensity;
+    float aoStrength;
+    float sharpness;
+} controls;
+
+#ifdef LIGHTING_SUBPASS
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput normalInput;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput albedoInput;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput metallicInput;
+layout(input_attachment_index = 3, set = 1, binding = 3) uniform subpassInput roughnessInput;
+layout(input_attachment_index = 4, set = 1, binding = 4) uniform subpassInput depthInput;
+
+layout(location = 0) out vec4 outColor;
+
+#define loadNormal(fragCoord) subpassLoad(normalInput)
+#define loadAlbedo(fragCoord) subpassLoad(albedoInput)
+#define loadMetallic(fragCoord) subpassLoad(metallicInput)
+#define loadRoughness(fragCoord) subpassLoad(roughnessInput)
+#define loadDepth(fragCoord) subpassLoad(depthInput).r
+#else
+layout(set = 1, binding = 0, rgba32f) uniform image2D normalImage;
+layout(set = 1, binding = 1, rgba8) uniform image2D albedoImage;
+layout(set = 1, binding = 2, rg8) uniform image2D metallicImage;
+layout(set = 1, binding = 3, r8) uniform image2D roughnessImage;
+
+// Compact HDR target (B10G11R11 or RGBA16F), or an 8 bit image when fused
+layout(set = 2, binding = 0) uniform writeonly image2D outImage;
+
+layout(set = 3, binding = 0) uniform sampler2D depthSampler;
+
+#define loadNormal(fragCoord) imageLoad(normalImage, fragCoord)
+#define loadAlbedo(fragCoord) imageLoad(albedoImage, fragCoord)
+#define loadMetallic(fragCoord) imageLoad(metallicImage, fragCoord)
+#define loadRoughness(fragCoord) imageLoad(roughnessImage, fragCoord)
+#define loadDepth(fragCoord) texelFetch(depthSampler, fragCoord, 0).r
+#endif
+
+layout(set = 3, binding = 1) uniform ViewportInfo {
+    uint width;
+    uint height;
+} viewportInfo;
+
+
+#define TILE_SIZE 16
+#define MAX_LIGHTS_PER_TILE 255
+
+#define LIGHT_TYPE_POINT 0
+#define LIGHT_TYPE_SPOT 1
+
+struct Light {
+    vec4 positionRadius;
+    vec4 colorIntensity;
+    vec4 directionType;
+    vec4 spotAngles;
+};
+
+layout(set = 4, binding = 0) readonly buffer Lights {
+    uint lightCount;
+    uint tileCountX;
+    uint tileCountY;
+    uint padding;
+    Light lights[];
+} lightBuffer;
+
+layout(set = 4, binding = 1) readonly buffer TileLights {
+    uint data[];
+} tileLights;
+
+// Written by luminanceAverage.comp in the previous frame
+layout(set = 4, binding = 2) readonly buffer Exposure {
+    float adaptedLuminance;
+    float exposure;
+} exposureData;
+
+// Only accumulated when fused, otherwise luminanceHistogram.comp reads the HDR image
+layout(set = 4, binding = 3) buffer LuminanceHistogram {
+    uint bins[];
+} luminanceHistogram;
+
+#define SHADOW_CASCADE_COUNT 4
+#define SHADOW_ATLAS_TILES 2
+
+layout(set = 4, binding = 4) uniform ShadowData {
+    mat4 cascadeViewProj[SHADOW_CASCADE_COUNT];
+    vec4 cascadeSplits;
+    vec4 cascadeTexelSizes;
+    float normalOffset;
+    uint pcfRadius;
+    uint enabled;
+    float atlasTexelSize;
+} shadowData;
+
+layout(set = 4, binding = 5) uniform sampler2DShadow shadowAtlas;
+
+// Denoised half resolution GTAO, r: visibility, g: linear view depth
+layout(set = 4, binding = 6) uniform sampler2D aoImage;
+
+layout( push_constant ) uniform constants{
+	mat4 submeshTransform;
+	mat4 modelMatrix;
+	uint albedoIndex;
+	uint ormIndex;
+	uint colorIndex;
+	uint textureType;
+} pushConstants;
+
+
+#define TEXTURE_TYPE_TEXTURE 0
+#define TEXTURE_TYPE_COLOR 1
+#define TEXTURE_TYPE_EMBEDDED 2
+
+#define PI 3.1415926535897932384626433832795
+
+#include "toneMapping.glsl"
+#ifndef LIGHTING_SUBPASS
+#include "luminanceHistogram.glsl"
+#endif
+
+// Largest finite float16 is 65504
+#define LFLOAT_MAX 60000.0
+
+#ifdef LIGHTING_FP16
+#define lfloat float16_t
+#define lvec3 f16vec3
+#else
+#define lfloat float
+#define lvec3 vec3
+#endif
+
+lvec3 fresnelSchlick(lfloat cosTheta, lvec3 F0)
+{
+    return F0 + (lvec3(1.0) - F0) * pow(clamp(lfloat(1.0) - cosTheta, lfloat(0.0), lfloat(1.0)), lfloat(5.0));
+}
+
+float DistributionGGX(float NdotH, float roughness)
+{
+    float a      = roughness*roughness;
+    float a2     = a*a;
+    float NdotH2 = NdotH*NdotH;
+
+    float num   = a2;
+    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+    denom = PI * denom * denom;
+
+    return num / denom;
+}
+
+float GeometrySchlickGGX(float NdotV, float roughness)
+{
+    float r = (roughness + 1.0);
+    float k = (r*r) / 8.0;
+
+    float num   = NdotV;
+    float denom = NdotV * (1.0 - k) + k;
+
+    return num / denom;
+}
+
+float GeometrySmith(float NdotV, float NdotL, float roughness)
+{
+    float ggx2  = GeometrySchlickGGX(NdotV, roughness);
+    float ggx1  = GeometrySchlickGGX(NdotL, roughness);
+
+    return ggx1 * ggx2;
+}
+
+lvec3 cookTorrance(vec3 N, vec3 V, vec3 L, lvec3 albedo, lfloat metallic, float roughness, lvec3 F0)
+{
+    vec3 H = normalize(V + L);
+    float NdotV = max(dot(N, V), 0.0);
+    float NdotL = max(dot(N, L), 0.0);
+    float NdotH = max(dot(N, H), 0.0);
+
+    float NDF = DistributionGGX(NdotH, roughness);
+    float G   = GeometrySmith(NdotV, NdotL, roughness);
+    float specularScale = min(NDF * G / (4.0 * NdotV * NdotL + 0.0001), LFLOAT_MAX);
+
+    lvec3 F  = fresnelSchlick(lfloat(max(dot(H, V), 0.0)), F0);
+    lvec3 kD = (lvec3(1.0) - F) * (lfloat(1.0) - metallic);
+
+    lvec3 diffuse  = kD * albedo * lfloat(1.0 / PI);
+    lvec3 specular = F * lfloat(specularScale);
+
+    return (diffuse + specular) * lfloat(NdotL);
+}
+
+// Windowed falloff relative to the light range, so it does not depend on scene units
+lfloat rangeAttenuation(float distance, float range)
+{
+    lfloat x = lfloat(min(distance / range, 1.0));
+    lfloat x2 = x * x;
+    lfloat window = lfloat(1.0) - x2 * x2;
+    return window * window / (lfloat(1.0) + lfloat(25.0) * x2);
+}
+
+lvec3 localLightRadiance(Light light, vec3 worldPos, out vec3 L)
+{
+    vec3 toLight = light.positionRadius.xyz - worldPos;
+    float distance = length(toLight);
+    L = toLight / max(distance, 0.0001);
+
+    lfloat attenuation = rangeAttenuation(distance, light.positionRadius.w);
+
+    if (uint(light.directionType.w) == LIGHT_TYPE_SPOT)
+    {
+        float cosAngle = dot(-L, normalize(light.directionType.xyz));
+        attenuation *= lfloat(smoothstep(light.spotAngles.y, light.spotAngles.x, cosAngle));
+    }
+
+    return lvec3(light.colorIntensity.rgb * light.colorIntensity.a) * attenuation;
+}
+
+float sunShadow(vec3 worldPos, vec3 N, vec3 L)
+{
+    if (shadowData.enabled == 0)
+    {
+        return 1.0;
+    }
+
+    float viewDepth = -(viewProjectionUBO.view * vec4(worldPos, 1.0)).z;
+    if (viewDepth > shadowData.cascadeSplits[SHADOW_CASCADE_COUNT - 1])
+    {
+        return 1.0;
+    }
+
+    uint cascade = 0;
+    while (cascade < SHADOW_CASCADE_COUNT - 1 && viewDepth > shadowData.cascadeSplits[cascade])
+    {
+        cascade++;
+    }
+
+    // Normal offset in cascade texels, growing towards grazing angles
+    float NdotL = clamp(dot(N, L), 0.0, 1.0);
+    vec3 offsetPos = worldPos + N * (shadowData.normalOffset * shadowData.cascadeTexelSizes[cascade] * (1.0 - NdotL));
+    vec4 lightClip = shadowData.cascadeViewProj[cascade] * vec4(offsetPos, 1.0);
+    vec3 ndc = lightClip.xyz / lightClip.w;
+
+    vec2 tile = vec2(cascade % SHADOW_ATLAS_TILES, cascade / SHADOW_ATLAS_TILES);
+    vec2 uv = (ndc.xy * 0.5 + 0.5 + tile) / float(SHADOW_ATLAS_TILES);
+
+    // Keep the filter footprint inside this cascade's tile
+    float margin = (float(shadowData.pcfRadius) + 1.0) * shadowData.atlasTexelSize;
+    uv = clamp(uv, tile / float(SHADOW_ATLAS_TILES) + margin, (tile + 1.0) / float(SHADOW_ATLAS_TILES) - margin);
+
+    int radius = int(shadowData.pcfRadius);
+    float shadow = 0.0;
+    for (int y = -radius; y <= radius; ++y)
+    {
+        for (int x = -radius; x <= radius; ++x)
+        {
+            shadow += texture(shadowAtlas, vec3(uv + vec2(x, y) * shadowData.atlasTexelSize, ndc.z));
+        }
+    }
+
+    float tapCount = float((2 * radius + 1) * (2 * radius + 1));
+    return shadow / tapCount;
+}
+
+// Bilinear upsample of the half resolution AO, with taps across depth edges rejected
+float ambientOcclusion(ivec2 fragCoord, float viewDepth)
+{
+    if (controls.aoStrength == 0.0)
+    {
+        return 1.0;
+    }
+
+    ivec2 halfSize = (ivec2(viewportInfo.width, viewportInfo.height) + 1) / 2;
+    vec2 halfPosition = (vec2(fragCoord) + 0.5) * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(halfPosition));
+    vec2 f = halfPosition - vec2(base);
+
+    float visibility = 0.0;
+    float weightSum = 0.0;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec2 s = texelFetch(aoImage, clamp(base + offset, ivec2(0), halfSize - 1), 0).rg;
+
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float weight = bilinear.x * bilinear.y * exp(-abs(s.g - viewDepth) / (0.05 * viewDepth)) + 0.0001;
+        visibility += s.r * weight;
+        weightSum += weight;
+    }
+
+    return mix(1.0, visibility / weightSum, controls.aoStrength);
+}
+
+vec3 shadePixel(ivec2 fragCoord, ivec2 viewport)
+{
+    vec3 Normal = loadNormal(fragCoord).xyz;
+    vec4 albedoOcclusion = loadAlbedo(fragCoord);
+    lvec3 albedo = lvec3(albedoOcclusion.xyz);
+    vec2 metallic = loadMetallic(fragCoord).xy;
+    float roughness = loadRoughness(fragCoord).x;
+
+    vec2 screenSpaceCoord = (vec2(fragCoord) + 0.5) / vec2(viewport);
+    float depth = loadDepth(fragCoord);
+    vec4 worldSpaceCoord = viewProjectionUBO.inverseViewProj * vec4(2.0 * screenSpaceCoord - 1.0, depth, 1.0);
+    worldSpaceCoord = worldSpaceCoord / worldSpaceCoord.w;
+
+	if(metallic.g < 0.5)
+    {
+        vec3 N = normalize(Normal);
+        vec3 V = normalize(cameraLightInfo.camPos.xyz - worldSpaceCoord.xyz);
+
+        lfloat metalness = lfloat(metallic.r);
+        lvec3 F0 = mix(lvec3(0.04), albedo, metalness);
+
+        // Sun
+        vec3 L = normalize(cameraLightInfo.lightDir.xyz);
+        lvec3 radiance = lvec3(controls.sunlightIntensity * sunShadow(worldSpaceCoord.xyz, N, L));
+        lvec3 Lo = cookTorrance(N, V, L, albedo, metalness, roughness, F0) * radiance;
+
+        // Local lights binned into this pixel's tile by lightCulling.comp
+        uvec2 tile = uvec2(fragCoord) / TILE_SIZE;
+        uint tileBase = (tile.y * lightBuffer.tileCountX + tile.x) * (MAX_LIGHTS_PER_TILE + 1);
+        uint tileLightCount = tileLights.data[tileBase];
+
+        for (uint i = 0; i < tileLightCount; ++i)
+        {
+            Light light = lightBuffer.lights[tileLights.data[tileBase + 1 + i]];
+            lvec3 lightRadiance = localLightRadiance(light, worldSpaceCoord.xyz, L);
+            Lo += cookTorrance(N, V, L, albedo, metalness, roughness, F0) * lightRadiance;
+        }
+
+        //vec3 ambient = vec3(0.03) * albedo * ao;
+        float viewDepth = -(viewProjectionUBO.view * worldSpaceCoord).z;
+        lvec3 ambient = lfloat(controls.ambientFactor * albedoOcclusion.w * ambientOcclusion(fragCoord, viewDepth)) * albedo;
+        return vec3(ambient + Lo);
+    }
+
+    return vec3(albedo);
+}
+
+#ifdef LIGHTING_SUBPASS
+
+void main()
+{
+    ivec2 viewport = ivec2(viewportInfo.width, viewportInfo.height);
+    outColor = vec4(shadePixel(ivec2(gl_FragCoord.xy), viewport), 1.0);
+}
+
+#else
+
+void storeColor(ivec2 fragCoord, vec3 color)
+{
+    if (FUSED_TONE_MAPPING)
+    {
+        float exposure = controls.exposure + (controls.autoExposure != 0 ? exposureData.exposure : 0.0);
+        color = linearToSrgb(toneMap(color, exposure, controls.toneMappingOperator));
+    }
+
+    imageStore(outImage, fragCoord, vec4(color, 1.0));
+}
+
+void main() {
+
+    ivec2 fragCoord = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 viewport = ivec2(viewportInfo.width, viewportInfo.height);
+
+    // The dispatch is rounded up to whole workgroups
+    bool inside = all(lessThan(fragCoord, viewport));
+    vec3 color = vec3(0.0);
+
+    if (FUSED_TONE_MAPPING)
+    {
+        beginLuminanceHistogram();
+    }
+
+    if (inside)
+    {
+        color = shadePixel(fragCoord, viewport);
+        storeColor(fragCoord, color);
+    }
+
+    if (FUSED_TONE_MAPPING)
+    {
+        accumulateLuminance(color, inside);
+    }
+}
+
+#endif
@@ -0,0 +1,70 @@
+// Log-luminance histogram accumulation shared by luminanceHistogram.comp and the fused lighting pass.
+// The includer declares the LuminanceHistogram buffer as luminanceHistogram and a Controls block as controls.
+// Bin 0 holds (near) black pixels, bins 1..255 cover [minLogLuminance, minLogLuminance + logLuminanceRange].
+// Fragment shaders have no shared memory and define LUMINANCE_BIN_ONLY to get just luminanceBin.
+
+#define HISTOGRAM_BIN_COUNT 256
+
+uint luminanceBin(vec3 color)
+{
+    float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+
+    if (luminance < 0.0001)
+    {
+        return 0;
+    }
+
+    float logLuminance = clamp((log2(luminance) - controls.minLogLuminance) / controls.logLuminanceRange, 0.0, 1.0);
+    return uint(logLuminance * 254.0 + 1.0);
+}
+
+#ifndef LUMINANCE_BIN_ONLY
+
+shared uint histogramShared[HISTOGRAM_BIN_COUNT];
+
+void beginLuminanceHistogram()
+{
+    for (uint i = gl_LocalInvocationIndex; i < HISTOGRAM_BIN_COUNT; i += gl_WorkGroupSize.x * gl_WorkGroupSize.y)
+    {
+        histogramShared[i] = 0;
+    }
+}
+
+// Must be reached by the whole workgroup, the first barrier also orders the clear above
+void accumulateLuminance(vec3 color, bool valid)
+{
+    barrier();
+
+    // Lanes that hit the same bin are merged with a ballot so each bin gets one shared atomic per subgroup
+    uint bin = luminanceBin(color);
+    bool done = !valid;
+
+    while (!done)
+    {
+        uint firstBin = subgroupBroadcastFirst(bin);
+
+        if (bin == firstBin)
+        {
+            uint count = subgroupBallotBitCount(subgroupBallot(true));
+
+            if (subgroupElect())
+            {
+                atomicAdd(histogramShared[bin], count);
+            }
+
+            done = true;
+        }
+    }
+
+    barrier();
+
+    for (uint i = gl_LocalInvocationIndex; i < HISTOGRAM_BIN_COUNT; i += gl_WorkGroupSize.x * gl_WorkGroupSize.y)
+    {
+        if (histogramShared[i] > 0)
+        {
+            atomicAdd(luminanceHistogram.bins[i], histogramShared[i]);
+        }
+    }
+}
+
+#endif
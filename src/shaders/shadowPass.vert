@@ -0,0 +1,15 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_debug_printf : enable
+
+layout( push_constant ) uniform constants{
+	mat4 lightModelViewProj;
+} pushConstants;
+
+layout(location = 0) in vec3 inPosition;
+
+void main() {
+    gl_Position = pushConstants.lightModelViewProj * vec4(inPosition, 1.0);
+}
@@ -15,7 +15,8 @@ layout(location = 2) in vec2 TexCoord;
 layout( push_constant ) uniform constants{
 	mat4 submeshTransform;
 	mat4 modelMatrix;
-	uint materialIndex;
+	uint albedoIndex;
+	uint ormIndex;
 	uint colorIndex;
 	uint textureType;
 } pushConstants;
@@ -30,9 +31,7 @@ layout(set = 0, binding = 3) uniform Controls {
     float ambientFactor;
 } controls;
 
-layout(set = 1, binding = 0) uniform sampler2D albedoSampler[];
-layout(set = 1, binding = 1) uniform sampler2D metallicSampler[];
-layout(set = 1, binding = 2) uniform sampler2D roughnessSampler[];
+#include "bindless.glsl"
 
 layout(set = 2, binding = 0) buffer Colors{
 	vec4 color[];
@@ -98,9 +97,10 @@ void main() {
 
         if(pushConstants.textureType == TEXTURE_TYPE_TEXTURE)
         {
-            albedo = texture(albedoSampler[pushConstants.materialIndex], TexCoord).rgb;
-            metallic = texture(metallicSampler[pushConstants.materialIndex], TexCoord).r;
-            roughness = texture(roughnessSampler[pushConstants.materialIndex], TexCoord).r;
+            albedo = texture(bindlessTextures[pushConstants.albedoIndex], TexCoord).rgb;
+            vec3 orm = texture(bindlessTextures[pushConstants.ormIndex], TexCoord).rgb;
+            roughness = orm.g;
+            metallic = orm.b;
         }
         else if(pushConstants.textureType == TEXTURE_TYPE_COLOR)
         {
@@ -156,7 +156,7 @@ void main() {
 
 	}
 	else if(pushConstants.textureType == TEXTURE_TYPE_EMBEDDED){
-		vec3 color = texture(albedoSampler[pushConstants.materialIndex], TexCoord).xyz;
+		vec3 color = texture(bindlessTextures[pushConstants.albedoIndex], TexCoord).xyz;
         outColor = vec4(color, 1.0);
 	}
 
@@ -16,7 +16,8 @@ layout(set = 0, binding = 1) uniform model {
 layout( push_constant ) uniform constants{
 	mat4 submeshTransform;
 	mat4 modelMatrix;
-	uint materialIndex;
+	uint albedoIndex;
+	uint ormIndex;
 	uint colorIndex;
 	uint textureType;
 } pushConstants;
@@ -0,0 +1,92 @@
+// Tone mapping operators shared by toneMappingPass.frag and the fused lighting pass.
+// Operators take exposed linear HDR color and return linear display color in [0, 1].
+
+#define TONE_MAPPING_ACES 0
+#define TONE_MAPPING_REINHARD 1
+#define TONE_MAPPING_AGX 2
+
+// Stephen Hill's fit of the ACES RRT + ODT
+vec3 toneMapACES(vec3 color)
+{
+    const mat3 inputMatrix = mat3(
+        0.59719, 0.07600, 0.02840,
+        0.35458, 0.90834, 0.13383,
+        0.04823, 0.01566, 0.83777);
+
+    const mat3 outputMatrix = mat3(
+         1.60475, -0.10208, -0.00327,
+        -0.53108,  1.10813, -0.07276,
+        -0.07367, -0.00605,  1.07602);
+
+    vec3 v = inputMatrix * color;
+    vec3 a = v * (v + 0.0245786) - 0.000090537;
+    vec3 b = v * (0.983729 * v + 0.4329510) + 0.238081;
+
+    return clamp(outputMatrix * (a / b), 0.0, 1.0);
+}
+
+// Luminance based, so bright saturated colors keep their hue
+vec3 toneMapReinhard(vec3 color)
+{
+    float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    return clamp(color / (1.0 + luminance), 0.0, 1.0);
+}
+
+// Minimal AgX with the default sigmoid approximation
+vec3 toneMapAgX(vec3 color)
+{
+    const mat3 inset = mat3(
+        0.842479062253094, 0.0423282422610123, 0.0423756549057051,
+        0.0784335999999992, 0.878468636469772, 0.0784336,
+        0.0792237451477643, 0.0791661274605434, 0.879142973793104);
+
+    const mat3 outset = mat3(
+         1.19687900512017, -0.0528968517574562, -0.0529716355144438,
+        -0.0980208811401368, 1.15190312990417, -0.0980434501171241,
+        -0.0990297440797205, -0.0989611768448433, 1.15107367264116);
+
+    const float minEv = -12.47393;
+    const float maxEv = 4.026069;
+
+    vec3 v = inset * color;
+    v = clamp(log2(max(v, vec3(1e-10))), minEv, maxEv);
+    v = (v - minEv) / (maxEv - minEv);
+
+    vec3 v2 = v * v;
+    vec3 v4 = v2 * v2;
+    v = 15.5 * v4 * v2 - 40.14 * v4 * v + 31.96 * v4 - 6.868 * v2 * v + 0.4298 * v2 + 0.1191 * v - 0.00232;
+
+    // The sigmoid output is display encoded, bring it back to linear
+    v = outset * v;
+    return pow(clamp(v, 0.0, 1.0), vec3(2.2));
+}
+
+vec3 toneMap(vec3 color, float exposure, uint toneMappingOperator)
+{
+    color *= exp2(exposure);
+
+    if (toneMappingOperator == TONE_MAPPING_REINHARD)
+    {
+        return toneMapReinhard(color);
+    }
+    else if (toneMappingOperator == TONE_MAPPING_AGX)
+    {
+        return toneMapAgX(color);
+    }
+
+    return toneMapACES(color);
+}
+
+vec3 linearToSrgb(vec3 color)
+{
+    vec3 low = color * 12.92;
+    vec3 high = 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055;
+    return mix(high, low, lessThanEqual(color, vec3(0.0031308)));
+}
+
+vec3 srgbToLinear(vec3 color)
+{
+    vec3 low = color / 12.92;
+    vec3 high = pow((color + 0.055) / 1.055, vec3(2.4));
+    return mix(high, low, lessThanEqual(color, vec3(0.04045)));
+}
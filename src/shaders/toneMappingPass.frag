@@ -4,14 +4,97 @@
 #extension GL_EXT_nonuniform_qualifier : require
 #extension GL_EXT_debug_printf : enable
 
-layout(set = 0, binding = 0, rgba16f) uniform image2D image;
+#include "toneMapping.glsl"
+
+// Input was already tone mapped and sRGB encoded by the fused lighting pass
+layout(constant_id = 0) const bool LDR_INPUT = false;
+// The swapchain has a UNORM format, so encoding is done here instead of by the hardware
+layout(constant_id = 1) const bool ENCODE_SRGB = false;
+
+layout(set = 0, binding = 3) uniform Controls {
+	float sunlightIntensity;
+    float ambientFactor;
+    float exposure;
+    uint toneMappingOperator;
+    float minLogLuminance;
+    float logLuminanceRange;
+    float adaptationRate;
+    uint autoExposure;
+    float bloomIntensity;
+    float aoStrength;
+    float sharpness;
+} controls;
+
+layout(set = 1, binding = 0) uniform sampler2D image;
+
+layout(set = 1, binding = 1) readonly buffer Exposure {
+    float adaptedLuminance;
+    float exposure;
+} exposureData;
+
+// Mip 0 of the bloom chain, at half resolution
+layout(set = 1, binding = 2) uniform sampler2D bloomImage;
 
 layout(location = 0) out vec4 outColor;
 
+// Contrast adaptive sharpening over the 4 neighbors, in the spirit of FSR's RCAS. The lobe is
+// limited so the result stays inside the neighborhood, which keeps it from ringing. Runs on
+// HDR values compressed into [0, 1), then expanded back.
+vec3 sharpen(ivec2 texCoord, vec3 center)
+{
+	ivec2 maxCoord = textureSize(image, 0) - 1;
+	vec3 b = texelFetch(image, clamp(texCoord + ivec2( 0, -1), ivec2(0), maxCoord), 0).rgb;
+	vec3 d = texelFetch(image, clamp(texCoord + ivec2(-1,  0), ivec2(0), maxCoord), 0).rgb;
+	vec3 f = texelFetch(image, clamp(texCoord + ivec2( 1,  0), ivec2(0), maxCoord), 0).rgb;
+	vec3 h = texelFetch(image, clamp(texCoord + ivec2( 0,  1), ivec2(0), maxCoord), 0).rgb;
+
+	b /= 1.0 + b;
+	d /= 1.0 + d;
+	f /= 1.0 + f;
+	h /= 1.0 + h;
+	vec3 e = center / (1.0 + center);
+
+	vec3 minRing = min(min(b, d), min(f, h));
+	vec3 maxRing = max(max(b, d), max(f, h));
+
+	vec3 hitMin = minRing / (4.0 * maxRing + 0.0001);
+	vec3 hitMax = (1.0 - maxRing) / (4.0 * minRing - 4.0 - 0.0001);
+	vec3 lobeRgb = max(-hitMin, hitMax);
+	float lobe = max(-0.1875, min(max(lobeRgb.r, max(lobeRgb.g, lobeRgb.b)), 0.0)) * controls.sharpness;
+
+	vec3 result = (lobe * (b + d + f + h) + e) / (4.0 * lobe + 1.0);
+	result = clamp(result, 0.0, 0.999);
+	return result / (1.0 - result);
+}
+
 void main()
 {
 	ivec2 texCoord = ivec2(gl_FragCoord.xy);
-	vec3 color = imageLoad(image, texCoord).xyz;
-	outColor = vec4(color, 1.0);
+	vec3 color = texelFetch(image, texCoord, 0).rgb;
 
-}
\ No newline at end of file
+	if (LDR_INPUT)
+	{
+		color = ENCODE_SRGB ? color : srgbToLinear(color);
+	}
+	else
+	{
+		if (controls.sharpness > 0.0)
+		{
+			color = sharpen(texCoord, color);
+		}
+
+		// Energy conserving blend, bloom replaces a fraction of the image instead of adding light.
+		// Without bloom its image shares memory with other transients and can hold anything, even NaNs.
+		if (controls.bloomIntensity > 0.0)
+		{
+			vec2 uv = gl_FragCoord.xy / vec2(textureSize(image, 0));
+			color = mix(color, texture(bloomImage, uv).rgb, controls.bloomIntensity);
+		}
+
+		float exposure = controls.exposure + (controls.autoExposure != 0 ? exposureData.exposure : 0.0);
+		color = toneMap(color, exposure, controls.toneMappingOperator);
+		color = ENCODE_SRGB ? linearToSrgb(color) : color;
+	}
+
+	outColor = vec4(color, 1.0);
+}